@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "gameboy.h"
+
+// Shared by the benchmark suites. Every suite measures a loop for at least
+// min_seconds, repeats it and keeps the fastest run, then writes one JSON
+// record per measurement and a line of text for humans.
+
+typedef struct {
+    double min_seconds;     // Shortest measured run
+    int repeats;            // Best of this many
+    FILE* json;
+    FILE* text;             // Human-readable summary
+    bool in_suite;
+    bool first_record;
+    bool failed;            // A correctness check failed; gbbench exits with 1
+} Bench;
+
+double bench_now(void);     // Monotonic seconds
+
+// Calls run(context) until min_seconds have passed, repeats times over, and
+// returns the best rate in work units per second. run returns the work done.
+double bench_rate(Bench* bench, uint64_t (*run)(void* context), void* context);
+
+// JSON: bench_suite opens "name": [ ... ], bench_record adds one object
+// whose members are given printf-style (without the braces)
+void bench_suite(Bench* bench, const char* name);
+void bench_record(Bench* bench, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+// Synthetic programs (roms.c). A ROM image is assembled in memory and
+// booted from a temporary file.
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    uint16_t pc;            // Next address to emit at
+} RomBuilder;
+
+int rom_begin(RomBuilder* rom, const char* title, uint8_t cart_type, uint8_t rom_banks, uint8_t ram_code);
+void rom_emit(RomBuilder* rom, int count, ...);             // Raw bytes
+void rom_emit16(RomBuilder* rom, uint8_t opcode, uint16_t value);
+GameBoy* rom_boot(RomBuilder* rom);                         // Frees the image; NULL on failure
+
+// Suites
+void bench_cpu(Bench* bench);
+void bench_memory(Bench* bench);
+void bench_frames(Bench* bench, char** roms, int rom_count);
+void bench_state(Bench* bench);
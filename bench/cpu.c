@@ -0,0 +1,129 @@
+#include "bench.h"
+
+// Instruction throughput over synthetic opcode mixes. Each program repeats
+// its mix in a straight line and jumps back; the interpreter is driven one
+// cpu_step at a time, the block cache through cpu_run. No events are
+// dispatched, so this is the CPU alone.
+
+#define MIX_REPEAT  16
+#define STEP_CHUNK  4096
+#define RUN_CHUNK   (1u << 16)      // Cycles per cpu_run call
+
+typedef struct {
+    const char* name;
+    void (*emit)(RomBuilder* rom);  // One copy of the mix
+} Mix;
+
+// Register ALU, 8- and 16-bit
+static void emit_alu(RomBuilder* rom)
+{
+    rom_emit(rom, 14, 0x80, 0x91, 0xA2, 0xB3, 0xAC, 0xBD,   // ADD B, SUB C, AND D, OR E, XOR H, CP L
+                      0x04, 0x0D, 0xCE, 0x11, 0x27, 0x2F,   // INC B, DEC C, ADC 0x11, DAA, CPL
+                      0x09, 0x13);                          // ADD HL,BC; INC DE
+}
+
+// Loads and stores to WRAM and HRAM through every addressing form
+static void emit_load(RomBuilder* rom)
+{
+    rom_emit(rom, 3, 0x21, 0x00, 0xC0);                     // LD HL,0xC000
+    rom_emit(rom, 8, 0x2A, 0x12, 0x46, 0x71,                // LD A,(HL+); LD (DE),A; LD B,(HL); LD (HL),C
+                     0xF0, 0x80, 0xE0, 0x81);               // LDH A,(0x80); LDH (0x81),A
+    rom_emit16(rom, 0xFA, 0xC100);                          // LD A,(0xC100)
+    rom_emit16(rom, 0xEA, 0xC101);                          // LD (0xC101),A
+    rom_emit(rom, 2, 0x78, 0x4F);                           // LD A,B; LD C,A
+}
+
+// Jumps, calls and returns (RST 0x08 holds a RET)
+static void emit_branch(RomBuilder* rom)
+{
+    rom_emit(rom, 2, 0x18, 0x00);                           // JR +0
+    rom_emit16(rom, 0xCD, 0x0008);                          // CALL 0x0008
+    rom_emit(rom, 2, 0x20, 0x00);                           // JR NZ,+0
+    rom_emit(rom, 1, 0xCF);                                 // RST 0x08
+    rom_emit16(rom, 0xC3, rom->pc + 3);                     // JP next
+    rom_emit(rom, 2, 0xC5, 0xC1);                           // PUSH BC; POP BC
+}
+
+// CB-prefixed bit operations, one on (HL)
+static void emit_cb(RomBuilder* rom)
+{
+    rom_emit(rom, 14, 0xCB, 0x47, 0xCB, 0xC8, 0xCB, 0x91,   // BIT 0,A; SET 1,B; RES 2,C
+                      0xCB, 0x12, 0xCB, 0x3B, 0xCB, 0x35,   // RL D; SRL E; SWAP L
+                      0xCB, 0x06);                          // RLC (HL)
+}
+
+// A 64-byte WRAM copy loop, the shape most game code has
+static void emit_copy(RomBuilder* rom)
+{
+    rom_emit(rom, 3, 0x21, 0x00, 0xC0);                     // LD HL,0xC000
+    rom_emit(rom, 3, 0x11, 0x00, 0xC2);                     // LD DE,0xC200
+    rom_emit(rom, 2, 0x06, 0x40);                           // LD B,64
+    rom_emit(rom, 6, 0x2A, 0x12, 0x13, 0x05, 0x20, 0xFA);   // LD A,(HL+); LD (DE),A; INC DE; DEC B; JR NZ
+}
+
+static const Mix mixes[] = {
+    { "alu", emit_alu },
+    { "load", emit_load },
+    { "branch", emit_branch },
+    { "cb", emit_cb },
+    { "copy", emit_copy },
+};
+
+static GameBoy* boot_mix(const Mix* mix)
+{
+    RomBuilder rom;
+    if (rom_begin(&rom, "BENCH CPU", 0x00, 2, 0) != 0) return NULL;
+    rom.data[0x0008] = 0xC9;                                // RET
+
+    rom_emit16(&rom, 0x31, 0xDFFE);                         // LD SP,0xDFFE
+    rom_emit16(&rom, 0x21, 0xC000);                         // LD HL,0xC000
+    rom_emit16(&rom, 0x11, 0xC100);                         // LD DE,0xC100
+    rom_emit(&rom, 1, 0xF3);                                // DI
+    uint16_t loop = rom.pc;
+    for (int i = 0; i < MIX_REPEAT; i++) mix->emit(&rom);
+    rom_emit16(&rom, 0xC3, loop);                           // JP loop
+
+    GameBoy* gb = rom_boot(&rom);
+    if (gb) gb_set_idle(gb, CPU_IDLE_OFF);
+    return gb;
+}
+
+static uint64_t run_step(void* context)
+{
+    CPU* cpu = ((GameBoy*)context)->cpu;
+    uint64_t start = cpu->instructions;
+    for (int i = 0; i < STEP_CHUNK; i++) cpu_step(cpu);
+    return cpu->instructions - start;
+}
+
+static uint64_t run_cached(void* context)
+{
+    CPU* cpu = ((GameBoy*)context)->cpu;
+    uint64_t start = cpu->instructions;
+    uint64_t deadline = cpu->cycles + RUN_CHUNK;
+    cpu_run(cpu, &deadline);
+    return cpu->instructions - start;
+}
+
+void bench_cpu(Bench* bench)
+{
+    bench_suite(bench, "cpu");
+    for (size_t i = 0; i < sizeof(mixes) / sizeof(mixes[0]); i++) {
+        GameBoy* gb = boot_mix(&mixes[i]);
+        if (!gb) continue;
+
+        double step = bench_rate(bench, run_step, gb);
+        bench_record(bench, "\"mix\": \"%s\", \"mode\": \"interpreter\", \"instructions_per_second\": %.0f",
+                     mixes[i].name, step);
+
+        double cached = 0;
+        if (cpu_set_mode(gb->cpu, CPU_MODE_CACHED) == 0) {
+            cached = bench_rate(bench, run_cached, gb);
+            bench_record(bench, "\"mix\": \"%s\", \"mode\": \"cached\", \"instructions_per_second\": %.0f",
+                         mixes[i].name, cached);
+        }
+        fprintf(bench->text, "  %-8s %8.1f MIPS interpreter  %8.1f MIPS cached\n",
+                mixes[i].name, step / 1e6, cached / 1e6);
+        gb_destroy(gb);
+    }
+}
@@ -0,0 +1,228 @@
+#include <string.h>
+#include "bench.h"
+
+// Whole-machine frames per second, headless, with the default idle
+// skipping. Six built-in programs cover the common shapes of game code;
+// ROM files given on the command line are run the same way. Each built-in
+// program is first checked to end in the same state with and without idle
+// skipping, in both CPU modes.
+
+#define FRAME_CHUNK 10
+#define CHECK_FRAMES 120
+
+typedef struct {
+    const char* name;
+    uint8_t cart_type;
+    void (*emit)(RomBuilder* rom);
+} Program;
+
+// LCD on, VBlank handler scrolls and rewrites a tile map row, main loop HALTs
+static void emit_halt(RomBuilder* rom)
+{
+    rom->data[0x40] = 0xC3;                                 // JP handler
+    rom->data[0x41] = 0x00;
+    rom->data[0x42] = 0x02;
+
+    rom_emit(rom, 4, 0x3E, 0x01, 0xE0, 0xFF);               // IE = VBlank
+    rom_emit(rom, 1, 0xFB);                                 // EI
+    rom_emit(rom, 3, 0x76, 0x18, 0xFD);                     // HALT; JR -3
+
+    rom->pc = 0x200;
+    rom_emit(rom, 5, 0xF0, 0x43, 0x3C, 0xE0, 0x43);         // SCX++
+    rom_emit16(rom, 0x21, 0x9800);                          // LD HL,0x9800
+    rom_emit(rom, 2, 0x06, 0x20);                           // LD B,32
+    rom_emit(rom, 4, 0x22, 0x05, 0x20, 0xFC);               // LD (HL+),A; DEC B; JR NZ
+    rom_emit(rom, 1, 0xD9);                                 // RETI
+}
+
+// Never idles: WRAM copies and arithmetic with the LCD on
+static void emit_busy(RomBuilder* rom)
+{
+    uint16_t loop = rom->pc;
+    rom_emit16(rom, 0x21, 0xC000);                          // LD HL,0xC000
+    rom_emit16(rom, 0x11, 0xC800);                          // LD DE,0xC800
+    rom_emit(rom, 2, 0x06, 0x00);                           // LD B,0 (256 bytes)
+    rom_emit(rom, 8, 0x2A, 0x81, 0x12, 0x13, 0x05,          // LD A,(HL+); ADD C; LD (DE),A; INC DE; DEC B
+                     0x4F, 0x20, 0xF8);                     // LD C,A; JR NZ
+    rom_emit16(rom, 0xC3, loop);
+}
+
+// Polls LY for VBlank, then updates VRAM; poll loops are skipped
+static void emit_poll(RomBuilder* rom)
+{
+    rom_emit(rom, 1, 0xF3);                                 // DI
+    uint16_t loop = rom->pc;
+    rom_emit(rom, 6, 0xF0, 0x44, 0xFE, 0x90, 0x20, 0xFA);   // wait LY == 144
+    rom_emit16(rom, 0x21, 0x8000);                          // LD HL,0x8000
+    rom_emit(rom, 2, 0x06, 0x80);                           // LD B,128
+    rom_emit(rom, 5, 0x78, 0x22, 0x05, 0x20, 0xFB);         // LD A,B; LD (HL+),A; DEC B; JR NZ
+    rom_emit(rom, 6, 0xF0, 0x44, 0xFE, 0x90, 0x28, 0xFA);   // wait LY != 144
+    rom_emit16(rom, 0xC3, loop);
+}
+
+// MBC1 bank switching with reads from every bank
+static void emit_banked(RomBuilder* rom)
+{
+    uint16_t loop = rom->pc;
+    rom_emit(rom, 2, 0x0E, 0x01);                           // LD C,1
+    uint16_t bank = rom->pc;
+    rom_emit(rom, 1, 0x79);                                 // LD A,C
+    rom_emit16(rom, 0xEA, 0x2000);                          // LD (0x2000),A
+    rom_emit16(rom, 0x21, 0x4000);                          // LD HL,0x4000
+    rom_emit(rom, 2, 0x06, 0x40);                           // LD B,64
+    rom_emit(rom, 4, 0x86, 0x23, 0x05, 0x20);               // ADD (HL); INC HL; DEC B; JR NZ
+    rom_emit(rom, 1, 0xFB);                                 //   -5
+    rom_emit(rom, 4, 0x0C, 0x79, 0xFE, 0x04);               // INC C; LD A,C; CP 4
+    rom_emit(rom, 2, 0x20, (uint8_t)(bank - (rom->pc + 2)));   // JR NZ bank
+    rom_emit16(rom, 0xC3, loop);
+}
+
+// Calls a WRAM routine that patches its own immediate every time, so
+// each call rebuilds its block and invalidates the page it is on
+static void emit_smc(RomBuilder* rom)
+{
+    static const uint8_t routine[] = {
+        0x3E, 0x00,                                         // LD A,n
+        0x3C,                                               // INC A
+        0xEA, 0x01, 0xC0,                                   // LD (0xC001),A
+        0xC9,                                               // RET
+    };
+    memcpy(&rom->data[0x300], routine, sizeof(routine));
+
+    rom_emit16(rom, 0x21, 0x0300);                          // LD HL,0x0300
+    rom_emit16(rom, 0x11, 0xC000);                          // LD DE,0xC000
+    rom_emit(rom, 2, 0x06, (uint8_t)sizeof(routine));       // LD B,n
+    rom_emit(rom, 6, 0x2A, 0x12, 0x13, 0x05, 0x20, 0xFA);   // LD A,(HL+); LD (DE),A; INC DE; DEC B; JR NZ
+    uint16_t loop = rom->pc;
+    rom_emit16(rom, 0xCD, 0xC000);                          // CALL 0xC000
+    rom_emit16(rom, 0xC3, loop);
+}
+
+// One poll subroutine waits on a RAM flag set by the timer interrupt, then
+// on DIV: the first wait may be skipped, the second must be stepped. The
+// LCD is off, so nothing else cuts the skips short.
+static void emit_pointer(RomBuilder* rom)
+{
+    static const uint8_t handler[] = {
+        0xF5,                                               // PUSH AF
+        0x3E, 0x01,                                         // LD A,1
+        0xEA, 0x00, 0xC0,                                   // LD (0xC000),A
+        0xF1,                                               // POP AF
+        0xD9,                                               // RETI
+    };
+    static const uint8_t wait[] = {
+        0x7E, 0xB8, 0x20, 0xFC,                             // LD A,(HL); CP B; JR NZ
+        0xC9,                                               // RET
+    };
+    rom->data[0x50] = 0xC3;                                 // JP handler
+    rom->data[0x51] = 0x00;
+    rom->data[0x52] = 0x02;
+    memcpy(&rom->data[0x200], handler, sizeof(handler));
+    memcpy(&rom->data[0x300], wait, sizeof(wait));
+
+    rom_emit(rom, 3, 0xAF, 0xE0, 0x40);                     // LCD off
+    rom_emit(rom, 4, 0x3E, 0x04, 0xE0, 0x07);               // TAC = 4096 Hz
+    rom_emit(rom, 4, 0x3E, 0x04, 0xE0, 0xFF);               // IE = timer
+    rom_emit(rom, 1, 0xFB);                                 // EI
+    uint16_t loop = rom->pc;
+    rom_emit(rom, 1, 0xAF);                                 // XOR A
+    rom_emit16(rom, 0xEA, 0xC000);                          // LD (0xC000),A
+    rom_emit16(rom, 0x21, 0xC000);                          // LD HL,0xC000
+    rom_emit(rom, 2, 0x06, 0x01);                           // LD B,1
+    rom_emit16(rom, 0xCD, 0x0300);                          // CALL wait
+    rom_emit16(rom, 0x21, 0xFF04);                          // LD HL,DIV
+    rom_emit(rom, 2, 0x06, 0x80);                           // LD B,0x80
+    rom_emit16(rom, 0xCD, 0x0300);                          // CALL wait
+    rom_emit(rom, 1, 0x14);                                 // INC D
+    rom_emit16(rom, 0xC3, loop);
+}
+
+static const Program programs[] = {
+    { "halt", 0x00, emit_halt },
+    { "busy", 0x00, emit_busy },
+    { "poll", 0x00, emit_poll },
+    { "banked", 0x01, emit_banked },
+    { "smc", 0x00, emit_smc },
+    { "pointer", 0x00, emit_pointer },
+};
+
+static uint64_t run_frames(void* context)
+{
+    for (int i = 0; i < FRAME_CHUNK; i++) gb_run_frame(context);
+    return FRAME_CHUNK;
+}
+
+static void bench_machine(Bench* bench, GameBoy* gb, const char* name)
+{
+    double interpreter = bench_rate(bench, run_frames, gb);
+    bench_record(bench, "\"rom\": \"%s\", \"mode\": \"interpreter\", \"frames_per_second\": %.1f", name, interpreter);
+
+    double cached = 0;
+    if (cpu_set_mode(gb->cpu, CPU_MODE_CACHED) == 0) {
+        cached = bench_rate(bench, run_frames, gb);
+        bench_record(bench, "\"rom\": \"%s\", \"mode\": \"cached\", \"frames_per_second\": %.1f", name, cached);
+    }
+    fprintf(bench->text, "  %-16s %9.1f fps interpreter  %9.1f fps cached\n", name, interpreter, cached);
+}
+
+static GameBoy* program_boot(const Program* program)
+{
+    RomBuilder rom;
+    if (rom_begin(&rom, "BENCH FRAMES", program->cart_type, 4, 0) != 0) return NULL;
+    program->emit(&rom);
+    return rom_boot(&rom);
+}
+
+// State hash after CHECK_FRAMES frames; 0 if the machine can't be set up
+static uint64_t program_hash(const Program* program, CPU_Mode mode, CPU_IdleMode idle)
+{
+    GameBoy* gb = program_boot(program);
+    if (!gb) return 0;
+    uint64_t hash = 0;
+    if (cpu_set_mode(gb->cpu, mode) == 0) {
+        gb_set_idle(gb, idle);
+        for (int i = 0; i < CHECK_FRAMES; i++) gb_run_frame(gb);
+        hash = gb_state_hash(gb);
+    }
+    gb_destroy(gb);
+    return hash;
+}
+
+// Idle skipping is exact, so it must not change where a program ends up
+static void check_program(Bench* bench, const Program* program)
+{
+    static const struct { CPU_Mode mode; const char* name; } modes[] = {
+        { CPU_MODE_INTERPRETER, "interpreter" },
+        { CPU_MODE_CACHED, "cached" },
+    };
+    uint64_t reference = program_hash(program, CPU_MODE_INTERPRETER, CPU_IDLE_OFF);
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        if (program_hash(program, modes[i].mode, CPU_IDLE_FULL) == reference) continue;
+        fprintf(bench->text, "  %-16s idle skipping changed the result (%s)\n", program->name, modes[i].name);
+        bench->failed = true;
+    }
+}
+
+void bench_frames(Bench* bench, char** roms, int rom_count)
+{
+    bench_suite(bench, "frames");
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+        check_program(bench, &programs[i]);
+        GameBoy* gb = program_boot(&programs[i]);
+        if (!gb) continue;
+        bench_machine(bench, gb, programs[i].name);
+        gb_destroy(gb);
+    }
+
+    for (int i = 0; i < rom_count; i++) {
+        int error;
+        GameBoy* gb = gb_create(roms[i], &error);
+        if (!gb) {
+            fprintf(bench->text, "  %s: %s\n", roms[i], gb_error_string(error));
+            continue;
+        }
+        const char* name = strrchr(roms[i], '/');
+        bench_machine(bench, gb, name ? name + 1 : roms[i]);
+        gb_destroy(gb);
+    }
+}
@@ -0,0 +1,102 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+
+// Microbenchmarks: make bench, or build/bench/gbbench [options] [rom...]
+
+static void usage(void)
+{
+    printf("Usage: gbbench [options] [rom...]\n"
+           "  -o <file>          JSON results (default: stdout)\n"
+           "  --suite <name>     only cpu, memory, frames or state\n"
+           "  --quick            short runs, no repeats (smoke test)\n"
+           "ROMs are run headless by the frames suite next to the built-in programs.\n");
+}
+
+double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double bench_rate(Bench* bench, uint64_t (*run)(void* context), void* context)
+{
+    double best = 0;
+    for (int i = 0; i < bench->repeats; i++) {
+        uint64_t work = 0;
+        double start = bench_now(), elapsed;
+        do {
+            work += run(context);
+            elapsed = bench_now() - start;
+        } while (elapsed < bench->min_seconds);
+        if (work / elapsed > best) best = work / elapsed;
+    }
+    return best;
+}
+
+void bench_suite(Bench* bench, const char* name)
+{
+    fprintf(bench->json, "%s,\n  \"%s\": [", bench->in_suite ? "\n  ]" : "", name);
+    bench->in_suite = true;
+    bench->first_record = true;
+    fprintf(bench->text, "%s\n", name);
+}
+
+void bench_record(Bench* bench, const char* format, ...)
+{
+    fprintf(bench->json, "%s\n    { ", bench->first_record ? "" : ",");
+    va_list args;
+    va_start(args, format);
+    vfprintf(bench->json, format, args);
+    va_end(args);
+    fprintf(bench->json, " }");
+    bench->first_record = false;
+}
+
+int main(int argc, char** argv)
+{
+    Bench bench = { .min_seconds = 0.1, .repeats = 3 };
+    const char* output = NULL;
+    const char* only = NULL;
+    char** roms = calloc(argc, sizeof(char*));
+    int rom_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--suite") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            bench.min_seconds = 0.02;
+            bench.repeats = 1;
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        } else {
+            roms[rom_count++] = argv[i];
+        }
+    }
+
+    // Text goes wherever the JSON doesn't
+    bench.json = output ? fopen(output, "w") : stdout;
+    bench.text = output ? stdout : stderr;
+    if (!bench.json) {
+        printf("Cannot write %s\n", output);
+        return 1;
+    }
+
+    fprintf(bench.json, "{\n  \"min_seconds\": %g,\n  \"repeats\": %d", bench.min_seconds, bench.repeats);
+    if (!only || strcmp(only, "cpu") == 0) bench_cpu(&bench);
+    if (!only || strcmp(only, "memory") == 0) bench_memory(&bench);
+    if (!only || strcmp(only, "frames") == 0) bench_frames(&bench, roms, rom_count);
+    if (!only || strcmp(only, "state") == 0) bench_state(&bench);
+    fprintf(bench.json, "%s\n}\n", bench.in_suite ? "\n  ]" : "");
+
+    if (output) fclose(bench.json);
+    free(roms);
+    return bench.failed ? 1 : 0;
+}
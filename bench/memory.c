@@ -0,0 +1,96 @@
+#include "bench.h"
+
+// Cost of one mmu_read/mmu_write per memory region, inlined fast path and
+// all, sweeping through the region byte by byte. The cart is MBC1 with RAM
+// so every region is live.
+
+#define ACCESS_CHUNK 4096
+
+typedef struct {
+    const char* name;
+    uint16_t base;
+    uint16_t span;
+    bool read, write;
+} Region;
+
+static const Region regions[] = {
+    { "rom0", 0x0000, 0x4000, true, false },
+    { "romx", 0x4000, 0x4000, true, false },
+    { "mbc",  0x2000, 0x0004, false, true },    // Bank select register (values 0-3)
+    { "vram", 0x8000, 0x2000, true, true },
+    { "eram", 0xA000, 0x2000, true, true },
+    { "wram", 0xC000, 0x2000, true, true },
+    { "echo", 0xE000, 0x1E00, true, true },
+    { "oam",  0xFE00, 0x00A0, true, true },
+    { "io",   0xFF42, 0x0002, true, true },     // SCY/SCX: no side effects
+    { "hram", 0xFF80, 0x007F, true, true },
+};
+
+typedef struct {
+    MMU* mmu;
+    const Region* region;
+    uint16_t offset;
+} Sweep;
+
+static volatile uint8_t sink;
+
+static uint64_t run_read(void* context)
+{
+    Sweep* sweep = context;
+    MMU* mmu = sweep->mmu;
+    uint16_t base = sweep->region->base, span = sweep->region->span, offset = sweep->offset;
+    uint8_t sum = 0;
+    for (int i = 0; i < ACCESS_CHUNK; i++) {
+        sum += mmu_read(mmu, base + offset);
+        if (++offset == span) offset = 0;
+    }
+    sink = sum;
+    sweep->offset = offset;
+    return ACCESS_CHUNK;
+}
+
+static uint64_t run_write(void* context)
+{
+    Sweep* sweep = context;
+    MMU* mmu = sweep->mmu;
+    uint16_t base = sweep->region->base, span = sweep->region->span, offset = sweep->offset;
+    for (int i = 0; i < ACCESS_CHUNK; i++) {
+        mmu_write(mmu, base + offset, (uint8_t)offset);
+        if (++offset == span) offset = 0;
+    }
+    sweep->offset = offset;
+    return ACCESS_CHUNK;
+}
+
+void bench_memory(Bench* bench)
+{
+    RomBuilder rom;
+    if (rom_begin(&rom, "BENCH MEMORY", 0x03, 4, 0x02) != 0) return;   // MBC1+RAM, 64KB, 8KB
+    rom_emit(&rom, 2, 0x18, 0xFE);                                      // JR -2 (never run)
+    GameBoy* gb = rom_boot(&rom);
+    if (!gb) return;
+
+    MMU* mmu = gb->mmu;
+    mmu_write(mmu, 0x0000, 0x0A);       // Enable cart RAM
+
+    bench_suite(bench, "memory");
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        const Region* region = &regions[i];
+        Sweep sweep = { mmu, region, 0 };
+        double read = 0, write = 0;
+
+        if (region->read) {
+            read = 1e9 / bench_rate(bench, run_read, &sweep);
+            bench_record(bench, "\"region\": \"%s\", \"op\": \"read\", \"ns\": %.3f", region->name, read);
+        }
+        if (region->write) {
+            write = 1e9 / bench_rate(bench, run_write, &sweep);
+            bench_record(bench, "\"region\": \"%s\", \"op\": \"write\", \"ns\": %.3f", region->name, write);
+        }
+        char text[2][16] = { "      -", "      -" };
+        if (region->read) snprintf(text[0], sizeof(text[0]), "%7.2f", read);
+        if (region->write) snprintf(text[1], sizeof(text[1]), "%7.2f", write);
+        fprintf(bench->text, "  %-8s %s ns read  %s ns write\n", region->name, text[0], text[1]);
+    }
+    gb_destroy(gb);
+}
@@ -0,0 +1,54 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench.h"
+
+int rom_begin(RomBuilder* rom, const char* title, uint8_t cart_type, uint8_t rom_banks, uint8_t ram_code)
+{
+    rom->size = (size_t)rom_banks * 0x4000;
+    rom->data = calloc(1, rom->size);       // Unused space is NOPs
+    if (!rom->data) return -1;
+
+    // Entry: NOP; JP 0x0150
+    memcpy(&rom->data[0x100], (const uint8_t[]){ 0x00, 0xC3, 0x50, 0x01 }, 4);
+    strncpy((char*)&rom->data[0x134], title, 15);
+    rom->data[0x147] = cart_type;
+    rom->data[0x148] = (uint8_t)(__builtin_ctz(rom_banks) - 1);
+    rom->data[0x149] = ram_code;
+
+    uint8_t checksum = 0;
+    for (int i = 0x134; i <= 0x14C; i++) checksum = checksum - rom->data[i] - 1;
+    rom->data[0x14D] = checksum;
+
+    rom->pc = 0x150;
+    return 0;
+}
+
+void rom_emit(RomBuilder* rom, int count, ...)
+{
+    va_list args;
+    va_start(args, count);
+    for (int i = 0; i < count; i++) rom->data[rom->pc++] = (uint8_t)va_arg(args, int);
+    va_end(args);
+}
+
+void rom_emit16(RomBuilder* rom, uint8_t opcode, uint16_t value)
+{
+    rom_emit(rom, 3, opcode, value & 0xFF, value >> 8);
+}
+
+GameBoy* rom_boot(RomBuilder* rom)
+{
+    char path[] = "/tmp/gbbench-XXXXXX";
+    int fd = mkstemp(path);
+    GameBoy* gb = NULL;
+    if (fd >= 0) {
+        if (write(fd, rom->data, rom->size) == (ssize_t)rom->size) gb = gb_create(path, NULL);
+        close(fd);
+        unlink(path);   // The ROM stays mapped
+    }
+    free(rom->data);
+    rom->data = NULL;
+    return gb;
+}
@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include "bench.h"
+
+// Snapshot latency: gb_state_save, gb_state_load and the two back to back,
+// on an MBC1 cart with 8KB of RAM after a few frames of running.
+
+typedef struct {
+    GameBoy* gb;
+    uint8_t* buffer;
+} Snapshot;
+
+static uint64_t run_save(void* context)
+{
+    Snapshot* snapshot = context;
+    gb_state_save(snapshot->gb, snapshot->buffer);
+    return 1;
+}
+
+static uint64_t run_load(void* context)
+{
+    Snapshot* snapshot = context;
+    gb_state_load(snapshot->gb, snapshot->buffer);
+    return 1;
+}
+
+static uint64_t run_round_trip(void* context)
+{
+    run_save(context);
+    return run_load(context);
+}
+
+void bench_state(Bench* bench)
+{
+    RomBuilder rom;
+    if (rom_begin(&rom, "BENCH STATE", 0x03, 4, 0x02) != 0) return;
+    rom_emit(&rom, 2, 0x3E, 0x0A);                          // LD A,0x0A
+    rom_emit16(&rom, 0xEA, 0x0000);                         // LD (0x0000),A: RAM on
+    uint16_t loop = rom.pc;
+    rom_emit16(&rom, 0x21, 0xA000);                         // LD HL,0xA000
+    rom_emit(&rom, 4, 0x34, 0x2C, 0x20, 0xFC);              // INC (HL); INC L; JR NZ
+    rom_emit16(&rom, 0xC3, loop);
+    GameBoy* gb = rom_boot(&rom);
+    if (!gb) return;
+    for (int i = 0; i < 10; i++) gb_run_frame(gb);
+
+    size_t size = gb_state_size(gb);
+    Snapshot snapshot = { gb, malloc(size) };
+    if (snapshot.buffer) {
+        gb_state_save(gb, snapshot.buffer);
+        double save = 1e9 / bench_rate(bench, run_save, &snapshot);
+        double load = 1e9 / bench_rate(bench, run_load, &snapshot);
+        double round_trip = 1e9 / bench_rate(bench, run_round_trip, &snapshot);
+
+        bench_suite(bench, "state");
+        bench_record(bench, "\"bytes\": %zu, \"save_ns\": %.0f, \"load_ns\": %.0f, \"round_trip_ns\": %.0f",
+                     size, save, load, round_trip);
+        fprintf(bench->text, "  %zu bytes: save %.0f ns  load %.0f ns  round trip %.0f ns\n",
+                size, save, load, round_trip);
+    }
+    free(snapshot.buffer);
+    gb_destroy(gb);
+}
@@ -0,0 +1,392 @@
+#include <stdlib.h>
+#include <string.h>
+#include "apu.h"
+
+#define APU_CLOCK_HZ 4194304    // Master clock (GB_CLOCK_HZ)
+
+// Register indices relative to 0xFF10; channel n's NRn0-NRn4 start at n * 5
+#define NR10 0x00
+#define NR50 0x14
+#define NR51 0x15
+#define NR52 0x16
+#define WAVE 0x20
+
+// Bits that always read back as 1 (write-only and unused bits)
+static const uint8_t read_mask[0x20] = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF,   // NR10-NR14
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF,   // NR20-NR24
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF,   // NR30-NR34
+    0xFF, 0xFF, 0x00, 0x00, 0xBF,   // NR40-NR44
+    0x00, 0x00, 0x70, 0xFF, 0xFF,   // NR50-NR52, unused
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+// Square duty patterns, bit n = step n
+static const uint8_t duty_pattern[4] = { 0x80, 0x81, 0xE1, 0x7E };
+
+// NR32 output level as a right shift of the 4-bit sample (0 = mute)
+static const uint8_t wave_shift[4] = { 4, 0, 1, 2 };
+
+// Noise divisor per NR43 bits 0-2, in master cycles
+static const uint8_t noise_divisor[8] = { 8, 16, 32, 48, 64, 80, 96, 112 };
+
+APU* apu_create(void) {
+    APU* apu = malloc(sizeof(APU));
+    if (apu) memset(apu, 0, sizeof(APU));
+    return apu;
+}
+
+void apu_init(APU* apu) {
+    // State after the boot ROM: channel 1 has just finished the chime
+    static const uint8_t boot_regs[0x17] = {
+        0x80, 0xBF, 0xF3, 0xFF, 0xBF,
+        0xFF, 0x3F, 0x00, 0xFF, 0xBF,
+        0x7F, 0xFF, 0x9F, 0xFF, 0xBF,
+        0xFF, 0xFF, 0x00, 0x00, 0xBF,
+        0x77, 0xF3, 0xF1,
+    };
+    static const uint8_t boot_wave[0x10] = {
+        0x84, 0x40, 0x43, 0xAA, 0x2D, 0x78, 0x92, 0x3C,
+        0x60, 0x59, 0x59, 0xB0, 0x34, 0xB8, 0x2E, 0xDA,
+    };
+    memcpy(apu->regs, boot_regs, sizeof(boot_regs));
+    memset(apu->regs + sizeof(boot_regs), 0xFF, WAVE - sizeof(boot_regs));
+    memcpy(apu->regs + WAVE, boot_wave, sizeof(boot_wave));
+
+    memset(apu->ch, 0, sizeof(apu->ch));
+    apu->ch[0].enabled = true;
+    apu->ch[0].dac = true;
+    apu->ch[0].duty = 2;
+    apu->ch[0].frequency = 0x7FF;
+    apu->ch[2].volume = wave_shift[0];
+    apu->ch[3].lfsr = 0x7FFF;
+
+    apu->power = true;
+    apu->time = 0;
+    apu->sequencer_next = APU_SEQUENCER_CYCLES;
+    apu->sequencer_step = 0;
+}
+
+void apu_free(APU* apu) {
+    if (!apu) return;
+    if (apu->ring) {
+        blip_free(&apu->blip[0]);
+        blip_free(&apu->blip[1]);
+        audio_ring_free(apu->ring);
+        free(apu->staging);
+    }
+    free(apu);
+}
+
+// Cycles between waveform steps at the current frequency
+static uint32_t channel_period(APU* apu, int i) {
+    if (i == 3) {
+        uint8_t nr43 = apu->regs[NR10 + 3 * 5 + 3];
+        return (uint32_t)noise_divisor[nr43 & 7] << (nr43 >> 4);
+    }
+    return (2048 - apu->ch[i].frequency) * (i == 2 ? 2 : 4);
+}
+
+// Current DAC input, 0-15
+static int channel_level(APU* apu, int i) {
+    APU_Channel* c = &apu->ch[i];
+    if (!c->enabled) return 0;
+    switch (i) {
+        case 0:
+        case 1:
+            return (duty_pattern[c->duty] >> c->phase) & 1 ? c->volume : 0;
+        case 2: {
+            uint8_t byte = apu->regs[WAVE + c->phase / 2];
+            uint8_t sample = c->phase & 1 ? byte & 0x0F : byte >> 4;
+            return sample >> c->volume;
+        }
+        default:
+            return c->lfsr & 1 ? 0 : c->volume;
+    }
+}
+
+// Mix the channel through NR51/NR50 and add any change at master cycle t
+static void channel_update(APU* apu, int i, uint64_t t) {
+    if (!apu->ring) return;
+    APU_Channel* c = &apu->ch[i];
+    int level = channel_level(apu, i);
+    uint8_t pan = apu->regs[NR51];
+    uint8_t volume = apu->regs[NR50];
+
+    for (int side = 0; side < 2; side++) {
+        int output = 0;
+        if ((pan >> (i + side * 4)) & 1) {
+            output = level * (((volume >> (side * 4)) & 7) + 1) * APU_GAIN;
+        }
+        if (output != c->output[side]) {
+            blip_add_delta(&apu->blip[side], (uint32_t)(t - apu->frame_start), output - c->output[side]);
+            c->output[side] = output;
+        }
+    }
+}
+
+static void apu_update_all(APU* apu, uint64_t t) {
+    for (int i = 0; i < 4; i++) channel_update(apu, i, t);
+}
+
+// Step the channel's waveform up to (not including) end
+static void channel_run(APU* apu, int i, uint64_t end) {
+    APU_Channel* c = &apu->ch[i];
+    if (c->next >= end) return;
+
+    uint32_t period = channel_period(apu, i);
+    uint8_t mask = i == 2 ? 31 : 7;
+    bool audible = apu->ring && c->enabled && (i == 2 ? c->volume < 4 : c->volume > 0);
+
+    if (!audible) {
+        // Nobody can hear it: jump straight past end (the LFSR holds still)
+        uint64_t steps = (end - c->next + period - 1) / period;
+        if (i != 3) c->phase = (c->phase + steps) & mask;
+        c->next += steps * period;
+        return;
+    }
+
+    do {
+        if (i == 3) {
+            uint16_t bit = (c->lfsr ^ (c->lfsr >> 1)) & 1;
+            c->lfsr = (c->lfsr >> 1) | (bit << 14);
+            if (apu->regs[NR10 + 3 * 5 + 3] & 0x08) c->lfsr = (c->lfsr & ~0x40) | (bit << 6);
+        } else {
+            c->phase = (c->phase + 1) & mask;
+        }
+        channel_update(apu, i, c->next);
+        c->next += period;
+    } while (c->next < end);
+}
+
+// Channel 1 frequency sweep: next frequency, disabling the channel on overflow
+static uint16_t sweep_calc(APU* apu) {
+    APU_Channel* c = &apu->ch[0];
+    uint8_t nr10 = apu->regs[NR10];
+    uint16_t delta = c->shadow >> (nr10 & 7);
+    uint16_t frequency = (nr10 & 0x08) ? c->shadow - delta : c->shadow + delta;
+    if (frequency > 2047) c->enabled = false;
+    return frequency;
+}
+
+static void sweep_clock(APU* apu) {
+    APU_Channel* c = &apu->ch[0];
+    uint8_t nr10 = apu->regs[NR10];
+    uint8_t period = (nr10 >> 4) & 7;
+
+    if (c->sweep_timer && --c->sweep_timer) return;
+    c->sweep_timer = period ? period : 8;
+    if (!c->sweep_enabled || !period) return;
+
+    uint16_t frequency = sweep_calc(apu);
+    if (frequency <= 2047 && (nr10 & 7)) {
+        c->shadow = frequency;
+        c->frequency = frequency;
+        apu->regs[NR10 + 3] = frequency & 0xFF;
+        apu->regs[NR10 + 4] = (apu->regs[NR10 + 4] & ~0x07) | (frequency >> 8);
+        sweep_calc(apu);
+    }
+}
+
+// 512 Hz: length at 256 Hz, sweep at 128 Hz, envelopes at 64 Hz
+static void sequencer_clock(APU* apu, uint64_t t) {
+    uint8_t step = apu->sequencer_step;
+    apu->sequencer_step = (step + 1) & 7;
+
+    if (!(step & 1)) {
+        for (int i = 0; i < 4; i++) {
+            APU_Channel* c = &apu->ch[i];
+            if (c->length_enabled && c->length && --c->length == 0) c->enabled = false;
+        }
+    }
+    if (step == 2 || step == 6) sweep_clock(apu);
+    if (step == 7) {
+        for (int i = 0; i < 4; i++) {
+            APU_Channel* c = &apu->ch[i];
+            if (i == 2 || !c->env_period || --c->env_timer) continue;
+            c->env_timer = c->env_period;
+            if (c->env_up && c->volume < 15) c->volume++;
+            else if (!c->env_up && c->volume > 0) c->volume--;
+        }
+    }
+    apu_update_all(apu, t);
+}
+
+// Read out everything up to apu->time and queue it for the audio device
+static void apu_flush(APU* apu) {
+    uint32_t clocks = (uint32_t)(apu->time - apu->frame_start);
+    blip_end_frame(&apu->blip[0], clocks);
+    blip_end_frame(&apu->blip[1], clocks);
+    apu->frame_start = apu->time;
+
+    uint32_t count = blip_samples_avail(&apu->blip[0]);
+    blip_read_samples(&apu->blip[1], apu->staging, count, 2);       // Left
+    blip_read_samples(&apu->blip[0], apu->staging + 1, count, 2);   // Right
+    audio_ring_write(apu->ring, apu->staging, count);
+}
+
+// Catch the channels up to now, one sequencer interval at a time
+static void apu_sync(APU* apu, uint64_t now) {
+    while (apu->time < now) {
+        uint64_t end = now < apu->sequencer_next ? now : apu->sequencer_next;
+        for (int i = 0; i < 4; i++) channel_run(apu, i, end);
+        apu->time = end;
+
+        if (end == apu->sequencer_next) {
+            sequencer_clock(apu, end);
+            apu->sequencer_next += APU_SEQUENCER_CYCLES;
+        }
+        if (apu->ring && apu->time - apu->frame_start >= APU_FLUSH_CYCLES) apu_flush(apu);
+    }
+}
+
+void apu_restart_output(APU* apu) {
+    if (!apu->ring) return;
+    blip_clear(&apu->blip[0]);
+    blip_clear(&apu->blip[1]);
+    apu->frame_start = apu->time;
+    for (int i = 0; i < 4; i++) {
+        apu->ch[i].output[0] = 0;
+        apu->ch[i].output[1] = 0;
+    }
+    apu_update_all(apu, apu->time);
+}
+
+int apu_open_output(APU* apu, uint32_t sample_rate, uint64_t now) {
+    if (apu->ring) return 0;
+    apu_sync(apu, now);
+
+    // A frame is at most APU_FLUSH_CYCLES plus one sequencer interval
+    uint32_t size = (uint32_t)((uint64_t)(APU_FLUSH_CYCLES + APU_SEQUENCER_CYCLES) * sample_rate / APU_CLOCK_HZ) + 2;
+    apu->staging = malloc(size * 2 * sizeof(int16_t));
+    apu->ring = audio_ring_create(APU_RING_FRAMES);
+    if (!apu->staging || !apu->ring ||
+        blip_init(&apu->blip[0], APU_CLOCK_HZ, sample_rate, size) != 0 ||
+        blip_init(&apu->blip[1], APU_CLOCK_HZ, sample_rate, size) != 0) {
+        blip_free(&apu->blip[0]);
+        blip_free(&apu->blip[1]);
+        audio_ring_free(apu->ring);
+        free(apu->staging);
+        apu->ring = NULL;
+        apu->staging = NULL;
+        return -1;
+    }
+
+    apu_restart_output(apu);
+    return 0;
+}
+
+static void channel_trigger(APU* apu, int i, uint64_t now) {
+    APU_Channel* c = &apu->ch[i];
+    uint8_t* nr = &apu->regs[NR10 + i * 5];
+
+    c->enabled = c->dac;
+    if (c->length == 0) c->length = i == 2 ? 256 : 64;
+    c->next = now + channel_period(apu, i);
+
+    if (i == 2) {
+        c->phase = 0;
+    } else {
+        c->volume = nr[2] >> 4;
+        c->env_up = nr[2] & 0x08;
+        c->env_period = nr[2] & 0x07;
+        c->env_timer = c->env_period;
+    }
+    if (i == 3) c->lfsr = 0x7FFF;
+    if (i == 0) {
+        c->shadow = c->frequency;
+        c->sweep_timer = (nr[0] >> 4) & 7 ? (nr[0] >> 4) & 7 : 8;
+        c->sweep_enabled = nr[0] & 0x77;
+        if (nr[0] & 7) sweep_calc(apu);
+    }
+}
+
+static void apu_power_off(APU* apu) {
+    memset(apu->regs, 0, NR52);
+    for (int i = 0; i < 4; i++) {
+        APU_Channel* c = &apu->ch[i];
+        APU_Channel off = { .next = c->next, .output = { c->output[0], c->output[1] } };
+        *c = off;
+    }
+    apu->ch[2].volume = wave_shift[0];
+    apu->power = false;
+}
+
+uint8_t apu_read(APU* apu, uint16_t address, uint64_t now) {
+    uint8_t r = address - 0xFF10;
+    if (r >= WAVE) return apu->regs[r];
+    if (r != NR52) return apu->regs[r] | read_mask[r];
+
+    // Length counters may have run out since the last write
+    apu_sync(apu, now);
+    uint8_t status = apu->power ? 0xF0 : 0x70;
+    for (int i = 0; i < 4; i++) {
+        if (apu->ch[i].enabled) status |= 1 << i;
+    }
+    return status;
+}
+
+void apu_write(APU* apu, uint16_t address, uint8_t value, uint64_t now) {
+    uint8_t r = address - 0xFF10;
+    apu_sync(apu, now);
+
+    if (r >= WAVE) {
+        apu->regs[r] = value;
+        channel_update(apu, 2, now);
+        return;
+    }
+    if (r == NR52) {
+        if (apu->power && !(value & 0x80)) apu_power_off(apu);
+        if (!apu->power && (value & 0x80)) {
+            apu->power = true;
+            apu->sequencer_step = 0;
+        }
+        apu_update_all(apu, now);
+        return;
+    }
+    if (!apu->power || r > NR52) return;
+    apu->regs[r] = value;
+
+    if (r < NR50) {
+        int i = r / 5;
+        APU_Channel* c = &apu->ch[i];
+        switch (r % 5) {
+            case 0:
+                if (i == 2) {
+                    c->dac = value & 0x80;
+                    if (!c->dac) c->enabled = false;
+                }
+                break;
+            case 1:
+                if (i == 2) {
+                    c->length = 256 - value;
+                } else {
+                    c->length = 64 - (value & 0x3F);
+                    c->duty = value >> 6;
+                }
+                break;
+            case 2:
+                if (i == 2) {
+                    c->volume = wave_shift[(value >> 5) & 3];
+                } else {
+                    c->dac = value & 0xF8;
+                    if (!c->dac) c->enabled = false;
+                }
+                break;
+            case 3:
+                if (i != 3) c->frequency = (c->frequency & 0x700) | value;
+                break;
+            case 4:
+                if (i != 3) c->frequency = (c->frequency & 0xFF) | ((value & 7) << 8);
+                c->length_enabled = value & 0x40;
+                if (value & 0x80) channel_trigger(apu, i, now);
+                break;
+        }
+    }
+    apu_update_all(apu, now);
+}
+
+void apu_end_frame(APU* apu, uint64_t now) {
+    apu_sync(apu, now);
+    if (apu->ring && apu->time != apu->frame_start) apu_flush(apu);
+}
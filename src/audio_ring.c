@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include <string.h>
+#include "audio_ring.h"
+
+AudioRing* audio_ring_create(uint32_t frames) {
+    uint32_t size = 1;
+    while (size < frames) size <<= 1;
+
+    AudioRing* ring = calloc(1, sizeof(AudioRing));
+    if (!ring) return NULL;
+    ring->samples = calloc(size * 2, sizeof(int16_t));
+    if (!ring->samples) {
+        free(ring);
+        return NULL;
+    }
+    ring->size = size;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return ring;
+}
+
+void audio_ring_free(AudioRing* ring) {
+    if (!ring) return;
+    free(ring->samples);
+    free(ring);
+}
+
+// Frames are copied in at most two pieces around the wrap
+static void ring_store(AudioRing* ring, uint64_t position, const int16_t* frames, uint32_t count) {
+    uint32_t start = position & (ring->size - 1);
+    uint32_t first = ring->size - start < count ? ring->size - start : count;
+    memcpy(ring->samples + start * 2, frames, first * 2 * sizeof(int16_t));
+    memcpy(ring->samples, frames + first * 2, (count - first) * 2 * sizeof(int16_t));
+}
+
+static void ring_load(AudioRing* ring, uint64_t position, int16_t* frames, uint32_t count) {
+    uint32_t start = position & (ring->size - 1);
+    uint32_t first = ring->size - start < count ? ring->size - start : count;
+    memcpy(frames, ring->samples + start * 2, first * 2 * sizeof(int16_t));
+    memcpy(frames + first * 2, ring->samples, (count - first) * 2 * sizeof(int16_t));
+}
+
+uint32_t audio_ring_write(AudioRing* ring, const int16_t* frames, uint32_t count) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t space = ring->size - (uint32_t)(head - tail);
+
+    if (count > space) {
+        ring->dropped += count - space;
+        count = space;
+    }
+    ring_store(ring, head, frames, count);
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+    return count;
+}
+
+uint32_t audio_ring_read(AudioRing* ring, int16_t* frames, uint32_t count) {
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t fill = (uint32_t)(head - tail);
+
+    if (count > fill) count = fill;
+    ring_load(ring, tail, frames, count);
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+    return count;
+}
+
+uint32_t audio_ring_fill(AudioRing* ring) {
+    return (uint32_t)(atomic_load_explicit(&ring->head, memory_order_acquire) -
+                      atomic_load_explicit(&ring->tail, memory_order_acquire));
+}
@@ -0,0 +1,87 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blip.h"
+
+int16_t blip_kernel[BLIP_PHASES][BLIP_TAPS];
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+// Blackman-windowed sinc, cut off a little below Nyquist, sampled at the
+// taps for every sub-sample phase and normalized to exactly one unit
+static void blip_build_kernel(void) {
+    const double cutoff = 0.9;
+    const double half = BLIP_TAPS / 2;
+
+    for (int phase = 0; phase < BLIP_PHASES; phase++) {
+        double taps[BLIP_TAPS];
+        double sum = 0;
+        for (int i = 0; i < BLIP_TAPS; i++) {
+            double x = i - half + 1 - (double)phase / BLIP_PHASES;
+            double sinc = x == 0 ? 1 : sin(M_PI * x * cutoff) / (M_PI * x * cutoff);
+            double window = 0.42 + 0.5 * cos(M_PI * x / half) + 0.08 * cos(2 * M_PI * x / half);
+            taps[i] = sinc * window;
+            sum += taps[i];
+        }
+
+        int total = 0;
+        int peak = 0;
+        for (int i = 0; i < BLIP_TAPS; i++) {
+            blip_kernel[phase][i] = (int16_t)lrint(taps[i] / sum * (1 << BLIP_UNIT_BITS));
+            total += blip_kernel[phase][i];
+            if (blip_kernel[phase][i] > blip_kernel[phase][peak]) peak = i;
+        }
+        // Rounding error goes on the peak so a step settles on the exact level
+        blip_kernel[phase][peak] += (1 << BLIP_UNIT_BITS) - total;
+    }
+}
+
+int blip_init(Blip* blip, uint32_t clock_rate, uint32_t sample_rate, uint32_t size) {
+    pthread_once(&kernel_once, blip_build_kernel);
+
+    memset(blip, 0, sizeof(Blip));
+    blip->buffer = calloc(size + BLIP_TAPS, sizeof(int32_t));
+    if (!blip->buffer) return -1;
+    blip->size = size;
+    // Rounded up so a frame never yields fewer samples than real time
+    blip->factor = (((uint64_t)sample_rate << 32) + clock_rate - 1) / clock_rate;
+    return 0;
+}
+
+void blip_free(Blip* blip) {
+    free(blip->buffer);
+    blip->buffer = NULL;
+}
+
+void blip_clear(Blip* blip) {
+    blip->offset = 0;
+    blip->integrator = 0;
+    memset(blip->buffer, 0, (blip->size + BLIP_TAPS) * sizeof(int32_t));
+}
+
+void blip_end_frame(Blip* blip, uint32_t clocks) {
+    blip->offset += clocks * blip->factor;
+}
+
+uint32_t blip_read_samples(Blip* blip, int16_t* out, uint32_t count, int stride) {
+    uint32_t avail = blip_samples_avail(blip);
+    if (count > avail) count = avail;
+
+    int32_t sum = blip->integrator;
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t sample = sum >> BLIP_UNIT_BITS;
+        if (sample > INT16_MAX) sample = INT16_MAX;
+        if (sample < INT16_MIN) sample = INT16_MIN;
+        out[i * stride] = (int16_t)sample;
+        sum += blip->buffer[i];
+        sum -= sample << (BLIP_UNIT_BITS - BLIP_BASS_SHIFT);
+    }
+    blip->integrator = sum;
+
+    // Keep the deltas not yet read (the tail of the last kernels)
+    uint32_t remain = avail - count + BLIP_TAPS;
+    memmove(blip->buffer, blip->buffer + count, remain * sizeof(int32_t));
+    memset(blip->buffer + remain, 0, count * sizeof(int32_t));
+    blip->offset -= (uint64_t)count << 32;
+    return count;
+}
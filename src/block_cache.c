@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+#include "block_cache.h"
+
+BlockCache* block_cache_create(MMU* mmu) {
+    BlockCache* cache = malloc(sizeof(BlockCache));
+    if (!cache) return NULL;
+    memset(cache, 0, sizeof(BlockCache));
+    memset(cache->buckets, 0xFF, sizeof(cache->buckets));
+    memset(cache->page_blocks, 0xFF, sizeof(cache->page_blocks));
+    cache->mmu = mmu;
+    return cache;
+}
+
+void block_cache_free(BlockCache* cache) {
+    free(cache);
+}
+
+// Page and its echo RAM alias
+static void set_page_protection(BlockCache* cache, unsigned page, bool protect) {
+    MMU* mmu = cache->mmu;
+    cache->protected_page[page] = protect;
+    if (page == 0xFF) return;   // HRAM is always on the slow path
+
+    uint8_t* target = protect ? NULL : &mmu->memory[page << MMU_PAGE_SHIFT];
+    mmu->write_page[page] = target;
+    if (page >= 0xC0 && page < 0xDE) mmu->write_page[page + 0x20] = target;
+}
+
+void block_cache_flush(BlockCache* cache) {
+    for (unsigned page = 0; page < MMU_PAGE_COUNT; page++) {
+        if (cache->protected_page[page]) set_page_protection(cache, page, false);
+    }
+    memset(cache->code_bits, 0, sizeof(cache->code_bits));
+    memset(cache->buckets, 0xFF, sizeof(cache->buckets));
+    memset(cache->page_blocks, 0xFF, sizeof(cache->page_blocks));
+    cache->block_count = 0;
+    cache->op_count = 0;
+    cache->flushes++;
+    cache->mmu->code_gen++;
+}
+
+Block* block_cache_insert(BlockCache* cache, const uint8_t* code, uint16_t pc, uint16_t from,
+                          int size, const BlockOp* ops, int count) {
+    if (cache->block_count == BLOCK_POOL || cache->op_count + count > BLOCK_OP_POOL) {
+        block_cache_flush(cache);
+    }
+
+    Block* block = &cache->blocks[cache->block_count];
+    block->code = code;
+    block->pc = pc;
+    block->last = pc;
+    block->end = pc;
+    block->count = count;
+    block->exit[0] = block->exit[1] = -1;
+    block->exit_gen = cache->mmu->code_gen;
+    block->ops = cache->op_count;
+    memcpy(&cache->ops[cache->op_count], ops, count * sizeof(BlockOp));
+
+    uint32_t hash = block_hash(code);
+    block->next = cache->buckets[hash];
+    cache->buckets[hash] = cache->block_count;
+    cache->block_count++;
+    cache->op_count += count;
+    cache->builds++;
+
+    // Code in RAM: route writes to its page through the slow path
+    if (pc >= 0x8000) {
+        for (int i = 0; i < size; i++) {
+            uint16_t address = from + i;
+            cache->code_bits[address >> 3] |= 1 << (address & 7);
+        }
+        // Blocks never leave their page
+        unsigned page = pc >> MMU_PAGE_SHIFT;
+        block->page_next = cache->page_blocks[page];
+        cache->page_blocks[page] = cache->block_count - 1;
+        if (!cache->protected_page[page]) set_page_protection(cache, page, true);
+    }
+    return block;
+}
+
+void block_cache_invalidate(BlockCache* cache, uint16_t address) {
+    unsigned page = address >> MMU_PAGE_SHIFT;
+
+    // Only the page's own blocks, each unchained from its bucket: code
+    // rewritten over and over would otherwise leave lookups walking
+    // every dead copy until the next flush
+    for (int32_t i = cache->page_blocks[page]; i >= 0; i = cache->blocks[i].page_next) {
+        Block* block = &cache->blocks[i];
+        int32_t* link = &cache->buckets[block_hash(block->code)];
+        while (*link != i) link = &cache->blocks[*link].next;
+        *link = block->next;
+        block->code = NULL;
+    }
+    cache->page_blocks[page] = -1;
+    memset(&cache->code_bits[(page << MMU_PAGE_SHIFT) >> 3], 0, MMU_PAGE_SIZE / 8);
+    set_page_protection(cache, page, false);
+    cache->invalidations++;
+
+    // A block running on this page must not replay stale ops
+    cache->mmu->code_gen++;
+}
@@ -3,29 +3,42 @@
 #include <stdlib.h>
 #include <string.h>
 
-Cartridge* load_rom(char *file)
+const uint8_t nintendo_logo[0x30] = {
+    0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83,
+    0x00, 0x0C, 0x00, 0x0D, 0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E,
+    0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99, 0xBB, 0xBB, 0x67, 0x63,
+    0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E,
+};
+
+int load_rom(const char *file, Cartridge** out)
 {
-    // open rom file
-    FILE *f = fopen(file, "rb");
-    // TODO: !f
+    *out = NULL;
+
+    // map (or share) the rom file
+    RomImage* image;
+    int result = rom_cache_acquire(file, &image);
+    if (result != ROM_OK) return result;
+
+    // the header must be complete before we parse it
+    if (image->size < 0x150) {
+        rom_cache_release(image);
+        return CART_ERR_TOO_SMALL;
+    }
+
     Cartridge* cart = malloc(sizeof(Cartridge));
-    // TODO: !cart
-    
-    // check rom size
-    fseek(f, 0, SEEK_END);
-    cart->size = ftell(f);
-    rewind(f);
-
-    // put rom binary data in Cartridge->data
-    cart->data = malloc(cart->size);
-    fread(cart->data, 1, cart->size, f);
-    fclose(f);
-
-    // parse gameboy header $100-$14F
+    if (!cart) {
+        rom_cache_release(image);
+        return CART_ERR_NOMEM;
+    }
+    cart->image = image;
+    cart->data = image->data;
+    cart->size = image->size;
+
+    // parse gameboy header $100-$14F straight from the mapping
     parse_gb_header(cart);
-    print_header(cart);
 
-    return cart;
+    *out = cart;
+    return CART_OK;
 }
 
 void parse_gb_header(Cartridge* cart)
@@ -45,12 +58,57 @@ void parse_gb_header(Cartridge* cart)
     cart->title[title_len] = '\0';
 
     // Extract other header info
+    cart->new_licensee = (cart->data[0x144] << 8) | cart->data[0x145];
+    cart->sgb_flag = cart->data[0x146];
     cart->cartridge_type = cart->data[0x147];
     cart->rom_size = cart->data[0x148];
     cart->ram_size = cart->data[0x149];
     cart->destination = cart->data[0x14A];
+    cart->old_licensee = cart->data[0x14B];
     cart->version = cart->data[0x14C];
     cart->header_checksum = cart->data[0x14D];
+    cart->global_checksum = (cart->data[0x14E] << 8) | cart->data[0x14F];
+
+    cart->logo_ok = memcmp(cart->logo, nintendo_logo, sizeof(nintendo_logo)) == 0;
+    cart->header_ok = cart_header_checksum(cart->data) == cart->header_checksum;
+}
+
+uint8_t cart_header_checksum(const uint8_t* data)
+{
+    uint8_t sum = 0;
+    for (int i = 0x134; i <= 0x14C; i++) sum = sum - data[i] - 1;
+    return sum;
+}
+
+// Eight bytes at a time: the odd and even bytes of each word are added into
+// 16-bit lanes, which hold 128 words' worth before they have to be folded.
+static uint64_t sum_bytes(const uint8_t* data, size_t size)
+{
+    const uint64_t mask = 0x00FF00FF00FF00FFull;
+    uint64_t total = 0;
+    size_t i = 0;
+
+    while (size - i >= 8) {
+        size_t words = (size - i) / 8;
+        if (words > 128) words = 128;
+        uint64_t lanes = 0;
+        for (size_t k = 0; k < words; k++, i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, sizeof(word));
+            lanes += (word & mask) + ((word >> 8) & mask);
+        }
+        lanes = (lanes & 0x0000FFFF0000FFFFull) + ((lanes >> 16) & 0x0000FFFF0000FFFFull);
+        total += (lanes & 0xFFFFFFFF) + (lanes >> 32);
+    }
+    while (i < size) total += data[i++];
+    return total;
+}
+
+uint16_t cart_global_checksum(const uint8_t* data, size_t size)
+{
+    uint64_t sum = sum_bytes(data, size);
+    if (size > 0x14F) sum -= data[0x14E] + data[0x14F];
+    return (uint16_t)sum;
 }
 
 void print_header(Cartridge* cart)
@@ -60,11 +118,14 @@ void print_header(Cartridge* cart)
     printf("\tROM size:%ld\n",cart->size);
     printf("\tCartridge Type: 0x%02X\n", cart->cartridge_type);
     printf("\tROM Size Code: 0x%02X\n", cart->rom_size);
-    printf("\tRAM Size Code: 0x%02X\n\n", cart->ram_size);
+    printf("\tRAM Size Code: 0x%02X\n", cart->ram_size);
+    printf("\tHeader Checksum: 0x%02X (%s)\n", cart->header_checksum, cart->header_ok ? "ok" : "bad");
+    printf("\tGlobal Checksum: 0x%04X (%s)\n\n", cart->global_checksum,
+           cart_global_checksum(cart->data, cart->size) == cart->global_checksum ? "ok" : "bad");
 }
 
 void cartridge_free(Cartridge* cart)
 {
-    free(cart->data);
+    rom_cache_release(cart->image);
     free(cart);
 }
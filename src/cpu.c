@@ -1,7 +1,12 @@
 #include <stdlib.h>
 #include <string.h>
+#include "block_cache.h"
 #include "cpu.h"
 #include "mmu.h"
+#include "profiler.h"
+#include "trace.h"
+
+typedef int (*CPU_CBFunc)(CPU* cpu);
 
 CPU* cpu_create(void) {
     CPU* cpu = malloc(sizeof(CPU));
@@ -11,13 +16,13 @@ CPU* cpu_create(void) {
 
 void cpu_init(CPU* cpu, MMU* mmu) {
     cpu->mmu = mmu;
-    
+
     cpu->pc = 0x0100; // cartridge entry point
     cpu->sp = 0xFFFE; // Initial stack pointer
-    
+
     // Initial register values after boot
     cpu->a = 0x01;
-    cpu->f = 0xB0;  // Flags: Z=1, N=0, H=1, C=1
+    cpu_set_f(cpu, 0xB0);   // Flags: Z=1, N=0, H=1, C=1
     cpu->b = 0x00;
     cpu->c = 0x13;
     cpu->d = 0x00;
@@ -25,41 +30,1112 @@ void cpu_init(CPU* cpu, MMU* mmu) {
     cpu->h = 0x01;
     cpu->l = 0x4D;
 
-    cpu->ime = true;    // Interrupts enabled
+    cpu->ime = false;   // Boot ROM leaves interrupts disabled
+    cpu->ime_scheduled = false;
     cpu->halted = false;
+    cpu->halt_bug = false;
     cpu->cycles = 0;
+    cpu->instructions = 0;
+
+    cpu->idle.mode = CPU_IDLE_FULL;
+    cpu->idle.verdict = -1;
 }
 
 void cpu_free(CPU *cpu)
 {
+    block_cache_free(cpu->blocks);
     free(cpu);
 }
 
-int cpu_step(CPU* cpu) {
+int cpu_set_mode(CPU* cpu, CPU_Mode mode) {
+    if (mode == CPU_MODE_CACHED && !cpu->blocks) {
+        cpu->blocks = block_cache_create(cpu->mmu);
+        if (!cpu->blocks) return -1;
+    } else if (mode == CPU_MODE_INTERPRETER && cpu->blocks) {
+        block_cache_flush(cpu->blocks);     // Drops the write protection
+        block_cache_free(cpu->blocks);
+        cpu->blocks = NULL;
+    }
+    cpu->mmu->blocks = cpu->blocks;
+    return 0;
+}
+
+void cpu_request_interrupt(CPU* cpu, uint8_t interrupt) {
+    cpu->mmu->memory[0xFF0F] |= interrupt;
+}
+
+// ---------------------------------------------------------------------------
+// Memory / stack helpers
+// ---------------------------------------------------------------------------
+
+static inline uint8_t rd(CPU* cpu, uint16_t address) {
+    return mmu_read(cpu->mmu, address);
+}
+
+static inline void wr(CPU* cpu, uint16_t address, uint8_t value) {
+    mmu_write(cpu->mmu, address, value);
+}
+
+static inline void push16(CPU* cpu, uint16_t value) {
+    cpu->sp -= 2;
+    mmu_write16(cpu->mmu, cpu->sp, value);
+}
+
+static inline uint16_t pop16(CPU* cpu) {
+    uint16_t value = mmu_read16(cpu->mmu, cpu->sp);
+    cpu->sp += 2;
+    return value;
+}
+
+// Condition codes
+#define COND_NZ (cpu->flags.z != 0)
+#define COND_Z  (cpu->flags.z == 0)
+#define COND_NC (!(cpu->flags.c & 0x100))
+#define COND_C  (cpu->flags.c & 0x100)
+
+// Carry flag as 0/1
+#define CARRY   ((cpu->flags.c >> 8) & 1)
+
+// ---------------------------------------------------------------------------
+// ALU helpers
+// ---------------------------------------------------------------------------
+
+// Sets all four flags from a 9-bit add/subtract. Bit 4 of a ^ b ^ r is the
+// carry (or borrow) into bit 4; bit 8 of r the carry out of bit 7.
+static inline void alu_flags(CPU* cpu, uint8_t a, uint8_t b, unsigned r, uint8_t n) {
+    cpu->flags.z = (uint8_t)r;
+    cpu->flags.n = n;
+    cpu->flags.h = a ^ b ^ r;
+    cpu->flags.c = r;
+}
+
+static inline void alu_add(CPU* cpu, uint8_t value, uint8_t carry) {
+    unsigned r = cpu->a + value + carry;
+    alu_flags(cpu, cpu->a, value, r, 0);
+    cpu->a = (uint8_t)r;
+}
+
+static inline uint8_t alu_sub_flags(CPU* cpu, uint8_t value, uint8_t carry) {
+    unsigned r = cpu->a - value - carry;    // Borrow wraps, setting bit 8
+    alu_flags(cpu, cpu->a, value, r, 1);
+    return (uint8_t)r;
+}
+
+static inline void alu_sub(CPU* cpu, uint8_t value, uint8_t carry) {
+    cpu->a = alu_sub_flags(cpu, value, carry);
+}
+
+// Z from the result, N and C clear, H as given
+static inline void alu_logic(CPU* cpu, uint8_t h) {
+    cpu->flags.z = cpu->a;
+    cpu->flags.n = 0;
+    cpu->flags.h = h;
+    cpu->flags.c = 0;
+}
+
+static inline void alu_and(CPU* cpu, uint8_t value) {
+    cpu->a &= value;
+    alu_logic(cpu, 0x10);
+}
+
+static inline void alu_xor(CPU* cpu, uint8_t value) {
+    cpu->a ^= value;
+    alu_logic(cpu, 0);
+}
+
+static inline void alu_or(CPU* cpu, uint8_t value) {
+    cpu->a |= value;
+    alu_logic(cpu, 0);
+}
+
+static inline void alu_cp(CPU* cpu, uint8_t value) {
+    alu_sub_flags(cpu, value, 0);
+}
+
+// INC/DEC leave C alone
+static inline uint8_t alu_inc(CPU* cpu, uint8_t value) {
+    uint8_t r = value + 1;
+    cpu->flags.z = r;
+    cpu->flags.n = 0;
+    cpu->flags.h = value ^ r;
+    return r;
+}
+
+static inline uint8_t alu_dec(CPU* cpu, uint8_t value) {
+    uint8_t r = value - 1;
+    cpu->flags.z = r;
+    cpu->flags.n = 1;
+    cpu->flags.h = value ^ r;
+    return r;
+}
+
+// Leaves Z alone; H and C come from bits 11 and 15
+static inline void alu_add_hl(CPU* cpu, uint16_t value) {
+    uint16_t hl = cpu->hl;
+    unsigned r = hl + value;
+    cpu->flags.n = 0;
+    cpu->flags.h = (hl ^ value ^ r) >> 8;
+    cpu->flags.c = r >> 8;
+    cpu->hl = (uint16_t)r;
+}
+
+// SP + signed 8-bit: flags come from the unsigned low-byte addition
+static inline uint16_t alu_sp_offset(CPU* cpu, uint8_t offset) {
+    uint16_t sp = cpu->sp;
+    unsigned low = (sp & 0xFF) + offset;
+    cpu->flags.z = 1;
+    cpu->flags.n = 0;
+    cpu->flags.h = sp ^ offset ^ low;
+    cpu->flags.c = low;
+    return sp + (int8_t)offset;
+}
+
+// Rotates and shifts: Z from r (1 for the A-register forms, which clear
+// it), N and H clear, C from bit 8 of carry
+static inline void alu_shift(CPU* cpu, uint8_t r, unsigned carry) {
+    cpu->flags.z = r;
+    cpu->flags.n = 0;
+    cpu->flags.h = 0;
+    cpu->flags.c = carry;
+}
+
+// CB rotate/shift helpers
+static inline uint8_t cb_rlc(CPU* cpu, uint8_t v) {
+    uint8_t r = (v << 1) | (v >> 7);
+    alu_shift(cpu, r, v << 1);
+    return r;
+}
+
+static inline uint8_t cb_rrc(CPU* cpu, uint8_t v) {
+    uint8_t r = (v >> 1) | (v << 7);
+    alu_shift(cpu, r, v << 8);
+    return r;
+}
+
+static inline uint8_t cb_rl(CPU* cpu, uint8_t v) {
+    uint8_t r = (v << 1) | CARRY;
+    alu_shift(cpu, r, v << 1);
+    return r;
+}
+
+static inline uint8_t cb_rr(CPU* cpu, uint8_t v) {
+    uint8_t r = (v >> 1) | (CARRY << 7);
+    alu_shift(cpu, r, v << 8);
+    return r;
+}
+
+static inline uint8_t cb_sla(CPU* cpu, uint8_t v) {
+    uint8_t r = v << 1;
+    alu_shift(cpu, r, v << 1);
+    return r;
+}
+
+static inline uint8_t cb_sra(CPU* cpu, uint8_t v) {
+    uint8_t r = (v >> 1) | (v & 0x80);
+    alu_shift(cpu, r, v << 8);
+    return r;
+}
+
+static inline uint8_t cb_swap(CPU* cpu, uint8_t v) {
+    uint8_t r = (v << 4) | (v >> 4);
+    alu_shift(cpu, r, 0);
+    return r;
+}
+
+static inline uint8_t cb_srl(CPU* cpu, uint8_t v) {
+    uint8_t r = v >> 1;
+    alu_shift(cpu, r, v << 8);
+    return r;
+}
+
+// ---------------------------------------------------------------------------
+// Handler generators
+// ---------------------------------------------------------------------------
+
+// Invoke X once per 8-bit register (not (HL))
+#define FOR_EACH_REG(X, ...) \
+    X(b, __VA_ARGS__) X(c, __VA_ARGS__) X(d, __VA_ARGS__) X(e, __VA_ARGS__) \
+    X(h, __VA_ARGS__) X(l, __VA_ARGS__) X(a, __VA_ARGS__)
+
+// Second copy so FOR_EACH_REG bodies can iterate again (macros don't recurse)
+#define FOR_EACH_SRC(X, ...) \
+    X(b, __VA_ARGS__) X(c, __VA_ARGS__) X(d, __VA_ARGS__) X(e, __VA_ARGS__) \
+    X(h, __VA_ARGS__) X(l, __VA_ARGS__) X(a, __VA_ARGS__)
+
+#define OP(name) static int op_##name(CPU* cpu, uint16_t operand)
+#define UNUSED_OPERAND (void)operand
+
+// LD r, r' and LD r, (HL) / LD (HL), r
+#define GEN_LD_TO(src, dst) \
+    OP(ld_##dst##_##src) { UNUSED_OPERAND; cpu->dst = cpu->src; return 0; }
+#define GEN_LD_ROW(dst, _) \
+    FOR_EACH_SRC(GEN_LD_TO, dst) \
+    OP(ld_##dst##_mhl) { UNUSED_OPERAND; cpu->dst = rd(cpu, cpu_get_hl(cpu)); return 0; } \
+    OP(ld_mhl_##dst) { UNUSED_OPERAND; wr(cpu, cpu_get_hl(cpu), cpu->dst); return 0; } \
+    OP(ld_##dst##_n) { cpu->dst = (uint8_t)operand; return 0; } \
+    OP(inc_##dst) { UNUSED_OPERAND; cpu->dst = alu_inc(cpu, cpu->dst); return 0; } \
+    OP(dec_##dst) { UNUSED_OPERAND; cpu->dst = alu_dec(cpu, cpu->dst); return 0; }
+FOR_EACH_REG(GEN_LD_ROW, _)
+
+// 8-bit ALU: A op r, A op (HL), A op n
+#define GEN_ALU_REG(r, name, expr) \
+    OP(name##_##r) { UNUSED_OPERAND; uint8_t v = cpu->r; expr; return 0; }
+#define GEN_ALU(name, expr) \
+    FOR_EACH_REG(GEN_ALU_REG, name, expr) \
+    OP(name##_mhl) { UNUSED_OPERAND; uint8_t v = rd(cpu, cpu_get_hl(cpu)); expr; return 0; } \
+    OP(name##_n) { uint8_t v = (uint8_t)operand; expr; return 0; }
+GEN_ALU(add, alu_add(cpu, v, 0))
+GEN_ALU(adc, alu_add(cpu, v, CARRY))
+GEN_ALU(sub, alu_sub(cpu, v, 0))
+GEN_ALU(sbc, alu_sub(cpu, v, CARRY))
+GEN_ALU(and, alu_and(cpu, v))
+GEN_ALU(xor, alu_xor(cpu, v))
+GEN_ALU(or, alu_or(cpu, v))
+GEN_ALU(cp, alu_cp(cpu, v))
+
+// 16-bit register pairs: LD rr,nn / INC rr / DEC rr / ADD HL,rr / PUSH / POP
+#define GEN_PAIR(rr) \
+    OP(ld_##rr##_nn) { cpu_set_##rr(cpu, operand); return 0; } \
+    OP(inc_##rr) { UNUSED_OPERAND; cpu_set_##rr(cpu, cpu_get_##rr(cpu) + 1); return 0; } \
+    OP(dec_##rr) { UNUSED_OPERAND; cpu_set_##rr(cpu, cpu_get_##rr(cpu) - 1); return 0; } \
+    OP(add_hl_##rr) { UNUSED_OPERAND; alu_add_hl(cpu, cpu_get_##rr(cpu)); return 0; } \
+    OP(push_##rr) { UNUSED_OPERAND; push16(cpu, cpu_get_##rr(cpu)); return 0; } \
+    OP(pop_##rr) { UNUSED_OPERAND; cpu_set_##rr(cpu, pop16(cpu)); return 0; }
+GEN_PAIR(bc)
+GEN_PAIR(de)
+GEN_PAIR(hl)
+
+// Conditional control flow; extra cycles are returned when taken
+#define GEN_COND(cc, test) \
+    OP(jr_##cc) { if (test) { cpu->pc += (int8_t)operand; return 4; } return 0; } \
+    OP(jp_##cc) { if (test) { cpu->pc = operand; return 4; } return 0; } \
+    OP(call_##cc) { if (test) { push16(cpu, cpu->pc); cpu->pc = operand; return 12; } return 0; } \
+    OP(ret_##cc) { UNUSED_OPERAND; if (test) { cpu->pc = pop16(cpu); return 12; } return 0; }
+GEN_COND(nz, COND_NZ)
+GEN_COND(z, COND_Z)
+GEN_COND(nc, COND_NC)
+GEN_COND(c, COND_C)
+
+#define GEN_RST(vec) \
+    OP(rst_##vec) { UNUSED_OPERAND; push16(cpu, cpu->pc); cpu->pc = 0x##vec; return 0; }
+GEN_RST(00) GEN_RST(08) GEN_RST(10) GEN_RST(18)
+GEN_RST(20) GEN_RST(28) GEN_RST(30) GEN_RST(38)
+
+// ---------------------------------------------------------------------------
+// Irregular base opcodes
+// ---------------------------------------------------------------------------
+
+OP(nop) { UNUSED_OPERAND; (void)cpu; return 0; }
+OP(stop) { UNUSED_OPERAND; (void)cpu; return 0; }  // Treated as a 2-byte NOP
+OP(halt) {
+    UNUSED_OPERAND;
+    MMU* mmu = cpu->mmu;
+    uint8_t pending = mmu->memory[0xFFFF] & mmu->memory[0xFF0F] & 0x1F;
+    if (!cpu->ime && pending) cpu->halt_bug = true;
+    else cpu->halted = true;
+    return 0;
+}
+// Illegal opcodes lock up the CPU: keep re-executing the same byte
+OP(illegal) { UNUSED_OPERAND; cpu->pc--; return 0; }
+
+OP(ld_mbc_a) { UNUSED_OPERAND; wr(cpu, cpu_get_bc(cpu), cpu->a); return 0; }
+OP(ld_mde_a) { UNUSED_OPERAND; wr(cpu, cpu_get_de(cpu), cpu->a); return 0; }
+OP(ld_a_mbc) { UNUSED_OPERAND; cpu->a = rd(cpu, cpu_get_bc(cpu)); return 0; }
+OP(ld_a_mde) { UNUSED_OPERAND; cpu->a = rd(cpu, cpu_get_de(cpu)); return 0; }
+OP(ld_mhli_a) {
+    UNUSED_OPERAND;
+    uint16_t hl = cpu_get_hl(cpu);
+    wr(cpu, hl, cpu->a);
+    cpu_set_hl(cpu, hl + 1);
+    return 0;
+}
+OP(ld_mhld_a) {
+    UNUSED_OPERAND;
+    uint16_t hl = cpu_get_hl(cpu);
+    wr(cpu, hl, cpu->a);
+    cpu_set_hl(cpu, hl - 1);
+    return 0;
+}
+OP(ld_a_mhli) {
+    UNUSED_OPERAND;
+    uint16_t hl = cpu_get_hl(cpu);
+    cpu->a = rd(cpu, hl);
+    cpu_set_hl(cpu, hl + 1);
+    return 0;
+}
+OP(ld_a_mhld) {
+    UNUSED_OPERAND;
+    uint16_t hl = cpu_get_hl(cpu);
+    cpu->a = rd(cpu, hl);
+    cpu_set_hl(cpu, hl - 1);
+    return 0;
+}
+OP(ld_mhl_n) { wr(cpu, cpu_get_hl(cpu), (uint8_t)operand); return 0; }
+OP(inc_mhl) {
+    UNUSED_OPERAND;
+    uint16_t hl = cpu_get_hl(cpu);
+    wr(cpu, hl, alu_inc(cpu, rd(cpu, hl)));
+    return 0;
+}
+OP(dec_mhl) {
+    UNUSED_OPERAND;
+    uint16_t hl = cpu_get_hl(cpu);
+    wr(cpu, hl, alu_dec(cpu, rd(cpu, hl)));
+    return 0;
+}
+
+OP(ld_sp_nn) { cpu->sp = operand; return 0; }
+OP(inc_sp) { UNUSED_OPERAND; cpu->sp++; return 0; }
+OP(dec_sp) { UNUSED_OPERAND; cpu->sp--; return 0; }
+OP(add_hl_sp) { UNUSED_OPERAND; alu_add_hl(cpu, cpu->sp); return 0; }
+OP(ld_mnn_sp) { mmu_write16(cpu->mmu, operand, cpu->sp); return 0; }
+OP(ld_sp_hl) { UNUSED_OPERAND; cpu->sp = cpu_get_hl(cpu); return 0; }
+OP(add_sp_e) { cpu->sp = alu_sp_offset(cpu, (uint8_t)operand); return 0; }
+OP(ld_hl_sp_e) { cpu_set_hl(cpu, alu_sp_offset(cpu, (uint8_t)operand)); return 0; }
+
+OP(push_af) { UNUSED_OPERAND; push16(cpu, (cpu->a << 8) | cpu_get_f(cpu)); return 0; }
+OP(pop_af) {
+    UNUSED_OPERAND;
+    uint16_t value = pop16(cpu);
+    cpu->a = value >> 8;
+    cpu_set_f(cpu, value);  // Low nibble of F is hardwired to 0
+    return 0;
+}
+
+OP(rlca) {
+    UNUSED_OPERAND;
+    uint8_t a = cpu->a;
+    cpu->a = (a << 1) | (a >> 7);
+    alu_shift(cpu, 1, a << 1);
+    return 0;
+}
+OP(rrca) {
+    UNUSED_OPERAND;
+    uint8_t a = cpu->a;
+    cpu->a = (a >> 1) | (a << 7);
+    alu_shift(cpu, 1, a << 8);
+    return 0;
+}
+OP(rla) {
+    UNUSED_OPERAND;
+    uint8_t a = cpu->a;
+    cpu->a = (a << 1) | CARRY;
+    alu_shift(cpu, 1, a << 1);
+    return 0;
+}
+OP(rra) {
+    UNUSED_OPERAND;
+    uint8_t a = cpu->a;
+    cpu->a = (a >> 1) | (CARRY << 7);
+    alu_shift(cpu, 1, a << 8);
+    return 0;
+}
+OP(daa) {
+    UNUSED_OPERAND;
+    uint8_t a = cpu->a;
+    uint8_t f = cpu_get_f(cpu);
+    uint8_t adjust = 0;
+    bool carry = f & FLAG_C;
+
+    if (f & FLAG_N) {
+        if (f & FLAG_H) adjust |= 0x06;
+        if (carry) adjust |= 0x60;
+        a -= adjust;
+    } else {
+        if ((f & FLAG_H) || (a & 0x0F) > 0x09) adjust |= 0x06;
+        if (carry || a > 0x99) { adjust |= 0x60; carry = true; }
+        a += adjust;
+    }
+    cpu->a = a;
+    cpu_set_f(cpu, (a ? 0 : FLAG_Z) | (f & FLAG_N) | (carry ? FLAG_C : 0));
+    return 0;
+}
+OP(cpl) { UNUSED_OPERAND; cpu->a = ~cpu->a; cpu->flags.n = 1; cpu->flags.h = 0x10; return 0; }
+OP(scf) { UNUSED_OPERAND; cpu->flags.n = 0; cpu->flags.h = 0; cpu->flags.c = 0x100; return 0; }
+OP(ccf) { UNUSED_OPERAND; cpu->flags.n = 0; cpu->flags.h = 0; cpu->flags.c = ~cpu->flags.c & 0x100; return 0; }
+
+OP(jr) { cpu->pc += (int8_t)operand; return 0; }
+OP(jp) { cpu->pc = operand; return 0; }
+OP(jp_hl) { UNUSED_OPERAND; cpu->pc = cpu_get_hl(cpu); return 0; }
+OP(call) { push16(cpu, cpu->pc); cpu->pc = operand; return 0; }
+OP(ret) { UNUSED_OPERAND; cpu->pc = pop16(cpu); return 0; }
+OP(reti) { UNUSED_OPERAND; cpu->pc = pop16(cpu); cpu->ime = true; return 0; }
+OP(di) { UNUSED_OPERAND; cpu->ime = false; cpu->ime_scheduled = false; return 0; }
+OP(ei) { UNUSED_OPERAND; cpu->ime_scheduled = true; return 0; }
+
+OP(ldh_mn_a) { wr(cpu, 0xFF00 | operand, cpu->a); return 0; }
+OP(ldh_a_mn) { cpu->a = rd(cpu, 0xFF00 | operand); return 0; }
+OP(ldh_mc_a) { UNUSED_OPERAND; wr(cpu, 0xFF00 | cpu->c, cpu->a); return 0; }
+OP(ldh_a_mc) { UNUSED_OPERAND; cpu->a = rd(cpu, 0xFF00 | cpu->c); return 0; }
+OP(ld_mnn_a) { wr(cpu, operand, cpu->a); return 0; }
+OP(ld_a_mnn) { cpu->a = rd(cpu, operand); return 0; }
+
+// ---------------------------------------------------------------------------
+// CB-prefixed opcodes
+// ---------------------------------------------------------------------------
+
+#define CB(name) static int cb_##name(CPU* cpu)
+
+#define GEN_CB_REG(r, name) \
+    CB(name##_##r) { cpu->r = cb_##name(cpu, cpu->r); return 0; }
+#define GEN_CB_SHIFT(name) \
+    FOR_EACH_REG(GEN_CB_REG, name) \
+    CB(name##_mhl) { uint16_t hl = cpu_get_hl(cpu); wr(cpu, hl, cb_##name(cpu, rd(cpu, hl))); return 0; }
+GEN_CB_SHIFT(rlc)
+GEN_CB_SHIFT(rrc)
+GEN_CB_SHIFT(rl)
+GEN_CB_SHIFT(rr)
+GEN_CB_SHIFT(sla)
+GEN_CB_SHIFT(sra)
+GEN_CB_SHIFT(swap)
+GEN_CB_SHIFT(srl)
+
+static inline void cb_bit(CPU* cpu, uint8_t v, uint8_t mask) {
+    cpu->flags.z = v & mask;
+    cpu->flags.n = 0;
+    cpu->flags.h = 0x10;
+}
+
+#define GEN_CB_BIT_REG(r, n) \
+    CB(bit##n##_##r) { cb_bit(cpu, cpu->r, 1 << n); return 0; } \
+    CB(res##n##_##r) { cpu->r &= ~(1 << n); return 0; } \
+    CB(set##n##_##r) { cpu->r |= 1 << n; return 0; }
+#define GEN_CB_BIT(n) \
+    FOR_EACH_REG(GEN_CB_BIT_REG, n) \
+    CB(bit##n##_mhl) { cb_bit(cpu, rd(cpu, cpu_get_hl(cpu)), 1 << n); return 0; } \
+    CB(res##n##_mhl) { uint16_t hl = cpu_get_hl(cpu); wr(cpu, hl, rd(cpu, hl) & ~(1 << n)); return 0; } \
+    CB(set##n##_mhl) { uint16_t hl = cpu_get_hl(cpu); wr(cpu, hl, rd(cpu, hl) | (1 << n)); return 0; }
+GEN_CB_BIT(0) GEN_CB_BIT(1) GEN_CB_BIT(2) GEN_CB_BIT(3)
+GEN_CB_BIT(4) GEN_CB_BIT(5) GEN_CB_BIT(6) GEN_CB_BIT(7)
+
+// One row of the CB map: operand order B C D E H L (HL) A
+#define CB_ROW(name) \
+    cb_##name##_b, cb_##name##_c, cb_##name##_d, cb_##name##_e, \
+    cb_##name##_h, cb_##name##_l, cb_##name##_mhl, cb_##name##_a
+
+static const CPU_CBFunc cb_table[256] = {
+    CB_ROW(rlc),  CB_ROW(rrc),  CB_ROW(rl),   CB_ROW(rr),
+    CB_ROW(sla),  CB_ROW(sra),  CB_ROW(swap), CB_ROW(srl),
+    CB_ROW(bit0), CB_ROW(bit1), CB_ROW(bit2), CB_ROW(bit3),
+    CB_ROW(bit4), CB_ROW(bit5), CB_ROW(bit6), CB_ROW(bit7),
+    CB_ROW(res0), CB_ROW(res1), CB_ROW(res2), CB_ROW(res3),
+    CB_ROW(res4), CB_ROW(res5), CB_ROW(res6), CB_ROW(res7),
+    CB_ROW(set0), CB_ROW(set1), CB_ROW(set2), CB_ROW(set3),
+    CB_ROW(set4), CB_ROW(set5), CB_ROW(set6), CB_ROW(set7),
+};
+
+// Cycles after the 0xCB prefix: 4 for registers, 12 for (HL), 8 for BIT n,(HL)
+static const uint8_t cb_cycles[256] = {
+    4, 4, 4, 4, 4, 4, 12, 4,  4, 4, 4, 4, 4, 4, 12, 4,  // 0x00
+    4, 4, 4, 4, 4, 4, 12, 4,  4, 4, 4, 4, 4, 4, 12, 4,  // 0x10
+    4, 4, 4, 4, 4, 4, 12, 4,  4, 4, 4, 4, 4, 4, 12, 4,  // 0x20
+    4, 4, 4, 4, 4, 4, 12, 4,  4, 4, 4, 4, 4, 4, 12, 4,  // 0x30
+    4, 4, 4, 4, 4, 4, 8, 4,   4, 4, 4, 4, 4, 4, 8, 4,   // 0x40
+    4, 4, 4, 4, 4, 4, 8, 4,   4, 4, 4, 4, 4, 4, 8, 4,   // 0x50
+    4, 4, 4, 4, 4, 4, 8, 4,   4, 4, 4, 4, 4, 4, 8, 4,   // 0x60
+    4, 4, 4, 4, 4, 4, 8, 4,   4, 4, 4, 4, 4, 4, 8, 4,   // 0x70
+    4, 4, 4, 4, 4, 4, 12, 4,  4, 4, 4, 4, 4, 4, 12, 4,  // 0x80
+    4, 4, 4, 4, 4, 4, 12, 4,  4, 4, 4, 4, 4, 4, 12, 4,  // 0x90
+    4, 4, 4, 4, 4, 4, 12, 4,  4, 4, 4, 4, 4, 4, 12, 4,  // 0xA0
+    4, 4, 4, 4, 4, 4, 12, 4,  4, 4, 4, 4, 4, 4, 12, 4,  // 0xB0
+    4, 4, 4, 4, 4, 4, 12, 4,  4, 4, 4, 4, 4, 4, 12, 4,  // 0xC0
+    4, 4, 4, 4, 4, 4, 12, 4,  4, 4, 4, 4, 4, 4, 12, 4,  // 0xD0
+    4, 4, 4, 4, 4, 4, 12, 4,  4, 4, 4, 4, 4, 4, 12, 4,  // 0xE0
+    4, 4, 4, 4, 4, 4, 12, 4,  4, 4, 4, 4, 4, 4, 12, 4,  // 0xF0
+};
+
+OP(cb) { return cb_table[operand](cpu) + cb_cycles[operand]; }
+
+// ---------------------------------------------------------------------------
+// Dispatch tables
+// ---------------------------------------------------------------------------
+
+#define ALU_ROW(name) \
+    op_##name##_b, op_##name##_c, op_##name##_d, op_##name##_e, \
+    op_##name##_h, op_##name##_l, op_##name##_mhl, op_##name##_a
+#define LD_ROW(dst) \
+    op_ld_##dst##_b, op_ld_##dst##_c, op_ld_##dst##_d, op_ld_##dst##_e, \
+    op_ld_##dst##_h, op_ld_##dst##_l, op_ld_##dst##_mhl, op_ld_##dst##_a
+
+static const CPU_OpFunc op_table[256] = {
+    // 0x00
+    op_nop,      op_ld_bc_nn, op_ld_mbc_a,  op_inc_bc,  op_inc_b,    op_dec_b,    op_ld_b_n,   op_rlca,
+    op_ld_mnn_sp, op_add_hl_bc, op_ld_a_mbc, op_dec_bc, op_inc_c,    op_dec_c,    op_ld_c_n,   op_rrca,
+    // 0x10
+    op_stop,     op_ld_de_nn, op_ld_mde_a,  op_inc_de,  op_inc_d,    op_dec_d,    op_ld_d_n,   op_rla,
+    op_jr,       op_add_hl_de, op_ld_a_mde, op_dec_de,  op_inc_e,    op_dec_e,    op_ld_e_n,   op_rra,
+    // 0x20
+    op_jr_nz,    op_ld_hl_nn, op_ld_mhli_a, op_inc_hl,  op_inc_h,    op_dec_h,    op_ld_h_n,   op_daa,
+    op_jr_z,     op_add_hl_hl, op_ld_a_mhli, op_dec_hl, op_inc_l,    op_dec_l,    op_ld_l_n,   op_cpl,
+    // 0x30
+    op_jr_nc,    op_ld_sp_nn, op_ld_mhld_a, op_inc_sp,  op_inc_mhl,  op_dec_mhl,  op_ld_mhl_n, op_scf,
+    op_jr_c,     op_add_hl_sp, op_ld_a_mhld, op_dec_sp, op_inc_a,    op_dec_a,    op_ld_a_n,   op_ccf,
+    // 0x40 - 0x7F
+    LD_ROW(b), LD_ROW(c), LD_ROW(d), LD_ROW(e), LD_ROW(h), LD_ROW(l),
+    op_ld_mhl_b, op_ld_mhl_c, op_ld_mhl_d, op_ld_mhl_e, op_ld_mhl_h, op_ld_mhl_l, op_halt, op_ld_mhl_a,
+    LD_ROW(a),
+    // 0x80 - 0xBF
+    ALU_ROW(add), ALU_ROW(adc), ALU_ROW(sub), ALU_ROW(sbc),
+    ALU_ROW(and), ALU_ROW(xor), ALU_ROW(or),  ALU_ROW(cp),
+    // 0xC0
+    op_ret_nz,   op_pop_bc,   op_jp_nz,     op_jp,      op_call_nz,  op_push_bc,  op_add_n,    op_rst_00,
+    op_ret_z,    op_ret,      op_jp_z,      op_cb,      op_call_z,   op_call,     op_adc_n,    op_rst_08,
+    // 0xD0
+    op_ret_nc,   op_pop_de,   op_jp_nc,     op_illegal, op_call_nc,  op_push_de,  op_sub_n,    op_rst_10,
+    op_ret_c,    op_reti,     op_jp_c,      op_illegal, op_call_c,   op_illegal,  op_sbc_n,    op_rst_18,
+    // 0xE0
+    op_ldh_mn_a, op_pop_hl,   op_ldh_mc_a,  op_illegal, op_illegal,  op_push_hl,  op_and_n,    op_rst_20,
+    op_add_sp_e, op_jp_hl,    op_ld_mnn_a,  op_illegal, op_illegal,  op_illegal,  op_xor_n,    op_rst_28,
+    // 0xF0
+    op_ldh_a_mn, op_pop_af,   op_ldh_a_mc,  op_di,      op_illegal,  op_push_af,  op_or_n,     op_rst_30,
+    op_ld_hl_sp_e, op_ld_sp_hl, op_ld_a_mnn, op_ei,     op_illegal,  op_illegal,  op_cp_n,     op_rst_38,
+};
+
+// Base cycles (branch not taken); taken branches add the handler's return value
+static const uint8_t op_cycles[256] = {
+//  x0  x1  x2  x3  x4  x5  x6  x7  x8  x9  xA  xB  xC  xD  xE  xF
+     4, 12,  8,  8,  4,  4,  8,  4, 20,  8,  8,  8,  4,  4,  8,  4,  // 0x00
+     4, 12,  8,  8,  4,  4,  8,  4, 12,  8,  8,  8,  4,  4,  8,  4,  // 0x10
+     8, 12,  8,  8,  4,  4,  8,  4,  8,  8,  8,  8,  4,  4,  8,  4,  // 0x20
+     8, 12,  8,  8, 12, 12, 12,  4,  8,  8,  8,  8,  4,  4,  8,  4,  // 0x30
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 0x40
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 0x50
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 0x60
+     8,  8,  8,  8,  8,  8,  4,  8,  4,  4,  4,  4,  4,  4,  8,  4,  // 0x70
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 0x80
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 0x90
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 0xA0
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 0xB0
+     8, 12, 12, 16, 12, 16,  8, 16,  8, 16, 12,  4, 12, 24,  8, 16,  // 0xC0
+     8, 12, 12,  4, 12, 16,  8, 16,  8, 16, 12,  4, 12,  4,  8, 16,  // 0xD0
+    12, 12,  8,  4,  4, 16,  8, 16, 16,  4, 16,  4,  4,  4,  8, 16,  // 0xE0
+    12, 12,  8,  4,  4, 16,  8, 16, 12,  8, 16,  4,  4,  4,  8, 16,  // 0xF0
+};
+
+// Instruction length in bytes (opcode + immediates)
+static const uint8_t op_length[256] = {
+//  x0 x1 x2 x3 x4 x5 x6 x7 x8 x9 xA xB xC xD xE xF
+    1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1,  // 0x00
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,  // 0x10
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,  // 0x20
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,  // 0x30
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x40
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x50
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x60
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x70
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x80
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x90
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0xA0
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0xB0
+    1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1,  // 0xC0
+    1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 1, 2, 1,  // 0xD0
+    2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1,  // 0xE0
+    2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1,  // 0xF0
+};
+
+// ---------------------------------------------------------------------------
+// Execution
+// ---------------------------------------------------------------------------
+
+// Push PC and jump to the highest-priority pending vector
+static int cpu_service_interrupt(CPU* cpu, uint8_t pending) {
+    uint8_t bit = pending & -pending;   // lowest set bit = highest priority
+    int index = __builtin_ctz(bit);
+
+    cpu->ime = false;
+    cpu->mmu->memory[0xFF0F] &= ~bit;
+    push16(cpu, cpu->pc);
+    cpu->pc = 0x40 + index * 8;
+    return 20;
+}
+
+#ifndef GB_NO_TRACE
+// Kept out of line so the hot path only carries the branch
+__attribute__((noinline, cold))
+static void cpu_trace(CPU* cpu, uint16_t pc, uint8_t opcode, uint8_t length, uint16_t operand, uint8_t flags) {
+    TraceRecord record = {
+        .cycles = cpu->cycles,
+        .pc = pc,
+        .sp = cpu->sp,
+        .af = (cpu->a << 8) | cpu_get_f(cpu),
+        .bc = cpu_get_bc(cpu),
+        .de = cpu_get_de(cpu),
+        .hl = cpu_get_hl(cpu),
+        .opcode = opcode,
+        .length = length,
+        .operand = operand,
+        .flags = (cpu->ime ? TRACE_IME : 0) | flags,
+    };
+    trace_write(cpu->trace, &record);
+}
+#endif
+
+static inline int cpu_execute(CPU* cpu) {
+    MMU* mmu = cpu->mmu;
+
+    // Interrupts: a pending IRQ always wakes HALT, and is serviced if IME
+    uint8_t pending = mmu->memory[0xFFFF] & mmu->memory[0xFF0F] & 0x1F;
+    if (pending) {
+        cpu->halted = false;
+        if (cpu->ime) {
+#ifndef GB_NO_TRACE
+            if (__builtin_expect(cpu->trace != NULL, 0)) {
+                // Interrupted PC, and the vector as the operand
+                cpu_trace(cpu, cpu->pc, 0, 0, 0x40 + __builtin_ctz(pending) * 8, TRACE_INTERRUPT);
+            }
+#endif
+#ifndef GB_NO_PROFILE
+            uint16_t sp = cpu->sp;
+#endif
+            int cycles = cpu_service_interrupt(cpu, pending);
+            cpu->cycles += cycles;
+#ifndef GB_NO_PROFILE
+            if (__builtin_expect(cpu->profile != NULL, 0)) {
+                profiler_interrupt(cpu->profile, cpu->pc, sp, cycles);
+            }
+#endif
+            return cycles;
+        }
+    }
+
     // Dont execute if halted
-    if (cpu->halted) return 4;   // still consumes cycles
-
-    // Fetch instruction at PC
-    uint8_t opcode = mmu_read(cpu->mmu, cpu->pc);
-    cpu->pc++;
-    
-    // Decode and execute
-    switch(opcode) {
-        case 0x00: return 4; // NOP takes 4 cycles
-            
-        case 0x3E:  // LD A, n - Load immediate into A
-            cpu->a = mmu_read(cpu->mmu, cpu->pc++);
-            return 8;  // 8 cycles
-        
-        case 0xC3:  // JP nn - Jump to address
-            cpu->pc = mmu_read16(cpu->mmu, cpu->pc);
-            return 16;  // 16 cycles
-        
-        case 0x76:  // HALT
-            cpu->halted = true;
-            return 4;
-            
-        case 0x10: return 4; // STOP (treated as NOP for now)
-        default: return 4;
+    if (cpu->halted) {
+#ifndef GB_NO_PROFILE
+        if (__builtin_expect(cpu->profile != NULL, 0)) {
+            profiler_halt(cpu->profile, cpu->pc - 1, 4);
+        }
+#endif
+        cpu->cycles += 4;
+        return 4;   // still consumes cycles
+    }
+
+    bool enable_ime = cpu->ime_scheduled;
+
+    // Fetch opcode + immediates
+    uint16_t pc = cpu->pc;
+    uint8_t opcode = mmu_read(mmu, pc);
+    bool halt_bug = cpu->halt_bug;
+    if (halt_bug) {
+        // PC fails to increment past the byte after HALT
+        cpu->halt_bug = false;
+        pc--;
+    }
+
+    uint16_t operand = 0;
+    uint8_t length = op_length[opcode];
+    if (length == 2) {
+        operand = mmu_read(mmu, pc + 1);
+    } else if (length == 3) {
+        operand = mmu_read16(mmu, pc + 1);
+    }
+    cpu->pc = pc + length;
+
+#ifndef GB_NO_TRACE
+    if (__builtin_expect(cpu->trace != NULL, 0)) {
+        cpu_trace(cpu, halt_bug ? pc + 1 : pc, opcode, length, operand, halt_bug ? TRACE_HALT_BUG : 0);
+    }
+#endif
+
+    // Execute through the handler table
+#ifndef GB_NO_PROFILE
+    uint16_t sp = cpu->sp;
+#endif
+    int cycles = op_cycles[opcode] + op_table[opcode](cpu, operand);
+
+#ifndef GB_NO_PROFILE
+    if (__builtin_expect(cpu->profile != NULL, 0)) {
+        profiler_step(cpu->profile, halt_bug ? pc + 1 : pc, opcode, sp, cpu->pc, cycles);
+    }
+#endif
+
+    if (enable_ime && cpu->ime_scheduled) {
+        cpu->ime = true;
+        cpu->ime_scheduled = false;
+    }
+
+    cpu->cycles += cycles;
+    cpu->instructions++;
+    return cycles;
+}
+
+int cpu_step(CPU* cpu) {
+    return cpu_execute(cpu);
+}
+
+// ---------------------------------------------------------------------------
+// Block cache
+// ---------------------------------------------------------------------------
+
+// Control flow and anything that changes IME/HALT state ends a block
+static bool op_ends_block(uint8_t opcode) {
+    switch (opcode) {
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:             // JR
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: case 0xE9:  // JP
+        case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:             // CALL
+        case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9:  // RET, RETI
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF:                        // RST
+        case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+        case 0x76: case 0xF3: case 0xFB:                                   // HALT, DI, EI
+            return true;
+        default:
+            return op_table[opcode] == op_illegal;
+    }
+}
+
+// Host address of the code at pc if it may be cached: ROM, VRAM, WRAM and
+// HRAM. Cart RAM, echo RAM, OAM and I/O always go through the interpreter.
+static inline const uint8_t* cpu_code_pointer(MMU* mmu, uint16_t pc) {
+    if (pc >= 0xFF80) return pc == 0xFFFF ? NULL : &mmu->memory[pc];
+    if ((pc >= 0xA000 && pc < 0xC000) || pc >= 0xE000) return NULL;
+    const uint8_t* page = mmu->read_page[pc >> MMU_PAGE_SHIFT];
+    return page ? page + (pc & (MMU_PAGE_SIZE - 1)) : NULL;
+}
+
+// BLOCK_CALL etc. for a block ending on opcode
+static uint8_t op_block_kind(uint8_t opcode) {
+    switch (opcode) {
+        case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            return BLOCK_CALL;
+        case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9:
+            return BLOCK_RET;
+        case 0x76: case 0xFB:
+            return BLOCK_STOP;
+        default:
+            return BLOCK_PLAIN;
+    }
+}
+
+// Unconditional jumps, calls and restarts with a fixed target
+static bool op_follows(uint8_t opcode) {
+    return opcode == 0x18 || opcode == 0xC3 || opcode == 0xCD || (opcode & 0xC7) == 0xC7;
+}
+
+// Decode from pc up to the first control transfer, carrying on through
+// fixed jumps that stay on the page. Blocks never leave their page, so one
+// host pointer covers every byte of them.
+static Block* cpu_build_block(CPU* cpu, const uint8_t* code) {
+    BlockOp ops[BLOCK_MAX_OPS];
+    uint8_t seen[MMU_PAGE_SIZE / 8] = {0};
+    int start = cpu->pc, base = start & ~(MMU_PAGE_SIZE - 1);
+    int low = start >= 0xFF80 ? 0xFF80 : base;
+    int top = start >= 0xFF80 ? 0xFFFF : base + MMU_PAGE_SIZE;
+    const uint8_t* page = code - (start - base);
+    int pc = start, last = start, from = start, to = start, count = 0;
+    uint8_t tail = 0;
+
+    while (count < BLOCK_MAX_OPS && pc < top) {
+        uint8_t opcode = page[pc - base];
+        uint8_t length = op_length[opcode];
+        if (pc + length > top) break;
+
+        BlockOp* op = &ops[count++];
+        op->handler = op_table[opcode];
+        op->length = length;
+        op->cycles = op_cycles[opcode];
+        op->operand = 0;
+        if (length == 2) op->operand = page[pc - base + 1];
+        else if (length == 3) op->operand = page[pc - base + 1] | (page[pc - base + 2] << 8);
+
+        seen[(pc - base) >> 3] |= 1 << (pc & 7);
+        if (pc < from) from = pc;
+        if (pc + length > to) to = pc + length;
+        last = pc;
+        tail = opcode;
+        pc += length;
+
+        if (op_follows(opcode)) {
+            // The handler sets pc, so decoding simply moves to the target
+            int target = opcode == 0x18 ? (uint16_t)(pc + (int8_t)op->operand)
+                       : opcode == 0xC3 || opcode == 0xCD ? op->operand
+                       : opcode & 0x38;
+            if (target < low || target >= top || (seen[(target - base) >> 3] & (1 << (target & 7)))) break;
+            pc = target;
+        } else if (op_ends_block(opcode)) {
+            break;
+        }
+    }
+
+    if (count == 0) return NULL;
+    Block* block = block_cache_insert(cpu->blocks, code, start, from, to - from, ops, count);
+    block->last = last;
+    block->end = last + ops[count - 1].length;
+    block->kind = op_block_kind(tail);
+    return block;
+}
+
+// ---------------------------------------------------------------------------
+// Idle skipping
+
+// Halted with nothing pending: every step adds 4 cycles until an event
+// raises an interrupt, so jump straight to the first step at or past it
+static void cpu_skip_halt(CPU* cpu, const uint64_t* deadline) {
+    uint64_t steps = (*deadline - cpu->cycles + 3) / 4;
+#ifndef GB_NO_PROFILE
+    if (__builtin_expect(cpu->profile != NULL, 0)) {
+        profiler_halt(cpu->profile, cpu->pc - 1, steps * 4);
+    }
+#endif
+    cpu->cycles += steps * 4;
+    cpu->idle.skipped += steps * 4;
+}
+
+// Registers that change with time rather than on events (DIV, TIMA, NR52)
+static bool cpu_idle_volatile(uint16_t address) {
+    return (address >= 0xFF04 && address <= 0xFF07) || address == 0xFF26;
+}
+
+// A poll loop writes nothing but A and F, reads no timer register, and ends
+// in a branch back to head; forward exits out of the loop are allowed.
+// Returns the instruction count, and cycles per iteration in *cycles.
+static int cpu_idle_decode(CPU* cpu, uint16_t head, uint16_t tail, uint16_t* cycles) {
+    MMU* mmu = cpu->mmu;
+    uint16_t pc = head;
+    int count = 0;
+    *cycles = 0;
+
+    while (pc <= tail) {
+        uint8_t op = mmu_read(mmu, pc);
+        uint8_t length = op_length[op];
+        uint8_t n = mmu_read(mmu, pc + 1);
+        uint16_t nn = n | (mmu_read(mmu, pc + 2) << 8);
+        uint16_t address = 0;   // Memory operand, if any
+        count++;
+
+        if (pc == tail) {
+            uint16_t target = length == 2 ? pc + 2 + (int8_t)n : nn;
+            bool conditional = op != 0x18 && op != 0xC3;
+            bool branch = op == 0x18 || op == 0x20 || op == 0x28 || op == 0x30 || op == 0x38 ||
+                          op == 0xC3 || op == 0xC2 || op == 0xCA || op == 0xD2 || op == 0xDA;
+            if (!branch || target != head) return 0;
+            *cycles += op_cycles[op] + (conditional ? 4 : 0);
+            return count;
+        }
+
+        switch (op) {
+            case 0x00:                                      // NOP
+            case 0x07: case 0x0F: case 0x17: case 0x1F:     // RLCA RRCA RLA RRA
+            case 0x27: case 0x2F: case 0x37: case 0x3F:     // DAA CPL SCF CCF
+            case 0x3C: case 0x3D: case 0x3E:                // INC A, DEC A, LD A,n
+            case 0xC6: case 0xCE: case 0xD6: case 0xDE:     // ALU A,n
+            case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+                break;
+            case 0x0A: address = cpu_get_bc(cpu); break;    // LD A,(BC)
+            case 0x1A: address = cpu_get_de(cpu); break;    // LD A,(DE)
+            case 0x7E: address = cpu_get_hl(cpu); break;    // LD A,(HL)
+            case 0xF0: address = 0xFF00 | n; break;         // LDH A,(n)
+            case 0xF2: address = 0xFF00 | cpu->c; break;    // LDH A,(C)
+            case 0xFA: address = nn; break;                 // LD A,(nn)
+            case 0xCB:
+                // BIT n,r / BIT n,(HL), or any CB op on A
+                if ((n & 0xC0) != 0x40 && (n & 7) != 7) return 0;
+                if ((n & 7) == 6) address = cpu_get_hl(cpu);
+                *cycles += cb_cycles[n];
+                break;
+            case 0x20: case 0x28: case 0x30: case 0x38: {   // JR cc out of the loop
+                uint16_t target = pc + 2 + (int8_t)n;
+                if (target >= head && target <= tail) return 0;
+                break;
+            }
+            case 0xC2: case 0xCA: case 0xD2: case 0xDA:     // JP cc out of the loop
+                if (nn >= head && nn <= tail) return 0;
+                break;
+            default:
+                if (op >= 0x78 && op <= 0x7F) break;        // LD A,r
+                if (op >= 0x80 && op <= 0xBF) {             // ALU A,r / A,(HL)
+                    if ((op & 7) == 6) address = cpu_get_hl(cpu);
+                    break;
+                }
+                return 0;
+        }
+        if (address && cpu_idle_volatile(address)) return 0;
+
+        *cycles += op_cycles[op];
+        pc += length;
+    }
+    return 0;
+}
+
+// Called when a branch at tail lands on an earlier pc. After one whole
+// iteration that left A/F unchanged, every further one is identical until
+// the next event, so whole iterations up to the deadline are skipped.
+static void cpu_idle_loop(CPU* cpu, uint16_t tail, const uint64_t* deadline) {
+    CPU_Idle* idle = &cpu->idle;
+    uint16_t head = cpu->pc;
+    if (tail - head >= CPU_IDLE_MAX_BYTES || cpu->halted) return;
+
+    // The loop can't change BC/DE/HL, but the same loop entered again with
+    // them pointing elsewhere (at DIV, say) reads different addresses
+    uint16_t bc = cpu_get_bc(cpu), de = cpu_get_de(cpu), hl = cpu_get_hl(cpu);
+    if (idle->verdict < 0 || head != idle->head || tail != idle->tail || cpu->mmu->code_gen != idle->gen ||
+        bc != idle->bc || de != idle->de || hl != idle->hl) {
+        uint16_t cycles;
+        idle->head = head;
+        idle->tail = tail;
+        idle->gen = cpu->mmu->code_gen;
+        idle->bc = bc;
+        idle->de = de;
+        idle->hl = hl;
+        idle->count = cpu_idle_decode(cpu, head, tail, &cycles);
+        idle->iteration = cycles;
+        idle->verdict = idle->count > 0;
+        for (int i = 0; i < idle->ignore_count; i++) {
+            if (idle->ignore[i] == head) idle->verdict = 0;
+        }
+        idle->armed = false;
+    }
+    if (!idle->verdict) return;
+
+    if (!idle->armed || cpu->a != idle->a || cpu_get_f(cpu) != idle->f ||
+        cpu->cycles - idle->cycles != idle->iteration ||
+        cpu->instructions - idle->instructions != idle->count ||
+        cpu->ime_scheduled || cpu->halt_bug) {
+        idle->armed = true;
+        idle->a = cpu->a;
+        idle->f = cpu_get_f(cpu);
+        idle->cycles = cpu->cycles;
+        idle->instructions = cpu->instructions;
+        return;
+    }
+
+    if (cpu->cycles < *deadline) {
+        uint64_t iterations = (*deadline - cpu->cycles) / idle->iteration;
+        cpu->cycles += iterations * idle->iteration;
+        cpu->instructions += iterations * idle->count;
+        idle->skipped += iterations * idle->iteration;
+    }
+    idle->cycles = cpu->cycles;
+    idle->instructions = cpu->instructions;
+}
+
+// Block at pc, built on a miss; NULL where code can't be cached
+static Block* cpu_find_block(CPU* cpu) {
+    const uint8_t* code = cpu_code_pointer(cpu->mmu, cpu->pc);
+    if (!code) return NULL;
+    Block* block = block_cache_find(cpu->blocks, code, cpu->pc);
+    return block ? block : cpu_build_block(cpu, code);
+}
+
+// Successor of a block that ran to its end. Each block remembers the block
+// its fall-through and its other exit led to; both hold until code_gen
+// changes, since every remap, code write and flush bumps it. The pc check
+// covers exits with more than one target (RET, JP HL).
+static inline Block* cpu_next_block(CPU* cpu, Block* last) {
+    BlockCache* cache = cpu->blocks;
+    uint32_t gen = cpu->mmu->code_gen;
+    int slot = cpu->pc != last->end;
+
+    // RET blocks are shared by every caller, so a return goes by the fall-
+    // through link of the block that called. Stale entries fail the checks.
+    Block* caller = NULL;
+    if (slot && last->kind == BLOCK_CALL) {
+        cache->calls[cache->call_top++ & (BLOCK_CALLS - 1)] = last - cache->blocks;
+    } else if (slot && last->kind == BLOCK_RET) {
+        caller = &cache->blocks[cache->calls[--cache->call_top & (BLOCK_CALLS - 1)]];
+        if (caller->exit_gen != gen || caller->end != cpu->pc) {
+            caller = NULL;
+        } else if (caller->exit[0] >= 0) {
+            Block* next = &cache->blocks[caller->exit[0]];
+            if (next->pc == cpu->pc) return next;
+        }
+    }
+
+    if (last->exit_gen != gen) {
+        last->exit[0] = last->exit[1] = -1;
+        last->exit_gen = gen;
+    } else if (last->exit[slot] >= 0) {
+        Block* next = &cache->blocks[last->exit[slot]];
+        if (next->pc == cpu->pc) return next;
+    }
+
+    // A build that flushed the cache reused last's slot, so don't link it
+    Block* next = cpu_find_block(cpu);
+    if (next && cpu->mmu->code_gen == gen) {
+        last->exit[slot] = next - cache->blocks;
+        if (caller) caller->exit[0] = next - cache->blocks;
+    }
+    return next;
+}
+
+static void cpu_run_cached(CPU* cpu, const uint64_t* deadline) {
+    MMU* mmu = cpu->mmu;
+    BlockCache* cache = cpu->blocks;
+
+    while (cpu->cycles < *deadline) {
+        // Interrupt entry, HALT, the EI delay and the HALT bug are left to
+        // the interpreter; blocks only ever start on a plain instruction
+        uint8_t pending = mmu->memory[0xFFFF] & mmu->memory[0xFF0F] & 0x1F;
+        if (cpu->halted && !pending && cpu->idle.mode != CPU_IDLE_OFF) {
+            cpu_skip_halt(cpu, deadline);
+            continue;
+        }
+        if ((pending && cpu->ime) || cpu->halted || cpu->halt_bug || cpu->ime_scheduled) {
+            cpu_execute(cpu);
+            continue;
+        }
+
+        Block* block = cpu_find_block(cpu);
+        if (!block) {
+            cpu_execute(cpu);
+            continue;
+        }
+
+        // Run the block, then straight on into its successors for as long
+        // as each one ends cleanly and nothing needs the interpreter
+        for (;;) {
+            // Replay. Stop early at the deadline, when a bank switch or code
+            // write invalidates the rest of the block, or when an enabled
+            // interrupt becomes pending, so timing matches the interpreter.
+            uint32_t gen = mmu->code_gen;
+            bool ime = cpu->ime;
+            const BlockOp* first = &cache->ops[block->ops];
+            const BlockOp* op = first;
+            const BlockOp* end = first + block->count;
+            do {
+                cpu->pc += op->length;
+                cpu->cycles += op->cycles + op->handler(cpu, op->operand);
+                op++;
+            } while (op < end && cpu->cycles < *deadline && mmu->code_gen == gen &&
+                     !(ime && (mmu->memory[0xFFFF] & mmu->memory[0xFF0F] & 0x1F)));
+            cpu->instructions += op - first;
+            if (op != end || mmu->code_gen != gen) break;
+
+            // A block that branched back into itself may be a poll loop
+            if (cpu->idle.mode == CPU_IDLE_FULL && cpu->pc <= block->last) {
+                cpu_idle_loop(cpu, block->last, deadline);
+            }
+
+            if (cpu->cycles >= *deadline || block->kind == BLOCK_STOP ||
+                (cpu->ime && (mmu->memory[0xFFFF] & mmu->memory[0xFF0F] & 0x1F))) {
+                break;
+            }
+            block = cpu_next_block(cpu, block);
+            if (!block) break;
+        }
+    }
+}
+
+void cpu_run(CPU* cpu, const uint64_t* deadline) {
+    // Events ran since the last call, so no iteration seen so far counts
+    cpu->idle.armed = false;
+
+    // Tracing needs every instruction, so it always uses the interpreter
+    if (cpu->blocks && !cpu->trace && !cpu->profile) {
+        cpu_run_cached(cpu, deadline);
+        return;
+    }
+
+    // Poll loops are only skipped when nobody watches individual instructions
+    MMU* mmu = cpu->mmu;
+    bool halt_skip = cpu->idle.mode != CPU_IDLE_OFF;
+    bool loop_skip = cpu->idle.mode == CPU_IDLE_FULL && !cpu->trace && !cpu->profile;
+    while (cpu->cycles < *deadline) {
+        if (cpu->halted && halt_skip && !(mmu->memory[0xFFFF] & mmu->memory[0xFF0F] & 0x1F)) {
+            cpu_skip_halt(cpu, deadline);
+            continue;
+        }
+        uint16_t pc = cpu->pc;
+        cpu_execute(cpu);
+        if (loop_skip && cpu->pc <= pc) cpu_idle_loop(cpu, pc, deadline);
     }
 }
@@ -1,34 +1,506 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include "disassemble.h"
 
-void d_asm_opcode(uint8_t opcode){
-    switch(opcode) {
-        case 0x00: printf("NOP"); break;
-        case 0x01: printf("LD BC, nn"); break;
-        case 0x06: printf("LD B, n"); break;
-        case 0x0E: printf("LD C, n"); break;
-        case 0x11: printf("LD DE, nn"); break;
-        case 0x16: printf("LD D, n"); break;
-        case 0x1E: printf("LD E, n"); break;
-        case 0x21: printf("LD HL, nn"); break;
-        case 0x26: printf("LD H, n"); break;
-        case 0x2E: printf("LD L, n"); break;
-        case 0x31: printf("LD SP, nn"); break;
-        case 0x3E: printf("LD A, n"); break;
-        case 0xC3: printf("JP nn"); break;
-        case 0x18: printf("JR n"); break;
-        case 0xCD: printf("CALL nn"); break;
-        case 0xC9: printf("RET"); break;
-        case 0xF5: printf("PUSH AF"); break;
-        case 0xF1: printf("POP AF"); break;
-        case 0x3C: printf("INC A"); break;
-        case 0x05: printf("DEC B"); break;
-        case 0x80: printf("ADD A, B"); break;
-        case 0xFE: printf("CP n"); break;
-        case 0x07: printf("RLCA"); break;
-        case 0x76: printf("HALT"); break;
-        case 0x10: printf("STOP"); break;
-        default: printf("----"); break;
+// ---------------------------------------------------------------------------
+// Instruction tables
+// ---------------------------------------------------------------------------
+
+// Operand markers: %b d8, %w d16, %m a16 memory operand, %j a16 code target,
+// %r relative code target, %s signed 8-bit offset, %h 0xFF00+a8.
+// NULL marks an illegal opcode.
+
+#define LD_ROW(dst) \
+    "LD " dst ", B", "LD " dst ", C", "LD " dst ", D", "LD " dst ", E", \
+    "LD " dst ", H", "LD " dst ", L", "LD " dst ", (HL)", "LD " dst ", A"
+#define ALU_ROW(op) \
+    op "B", op "C", op "D", op "E", op "H", op "L", op "(HL)", op "A"
+
+static const char* const base_ops[256] = {
+    // 0x00
+    "NOP", "LD BC, %w", "LD (BC), A", "INC BC", "INC B", "DEC B", "LD B, %b", "RLCA",
+    "LD (%m), SP", "ADD HL, BC", "LD A, (BC)", "DEC BC", "INC C", "DEC C", "LD C, %b", "RRCA",
+    // 0x10
+    "STOP", "LD DE, %w", "LD (DE), A", "INC DE", "INC D", "DEC D", "LD D, %b", "RLA",
+    "JR %r", "ADD HL, DE", "LD A, (DE)", "DEC DE", "INC E", "DEC E", "LD E, %b", "RRA",
+    // 0x20
+    "JR NZ, %r", "LD HL, %w", "LD (HL+), A", "INC HL", "INC H", "DEC H", "LD H, %b", "DAA",
+    "JR Z, %r", "ADD HL, HL", "LD A, (HL+)", "DEC HL", "INC L", "DEC L", "LD L, %b", "CPL",
+    // 0x30
+    "JR NC, %r", "LD SP, %w", "LD (HL-), A", "INC SP", "INC (HL)", "DEC (HL)", "LD (HL), %b", "SCF",
+    "JR C, %r", "ADD HL, SP", "LD A, (HL-)", "DEC SP", "INC A", "DEC A", "LD A, %b", "CCF",
+    // 0x40 - 0x7F
+    LD_ROW("B"), LD_ROW("C"), LD_ROW("D"), LD_ROW("E"), LD_ROW("H"), LD_ROW("L"),
+    "LD (HL), B", "LD (HL), C", "LD (HL), D", "LD (HL), E", "LD (HL), H", "LD (HL), L", "HALT", "LD (HL), A",
+    LD_ROW("A"),
+    // 0x80 - 0xBF
+    ALU_ROW("ADD A, "), ALU_ROW("ADC A, "), ALU_ROW("SUB "), ALU_ROW("SBC A, "),
+    ALU_ROW("AND "), ALU_ROW("XOR "), ALU_ROW("OR "), ALU_ROW("CP "),
+    // 0xC0
+    "RET NZ", "POP BC", "JP NZ, %j", "JP %j", "CALL NZ, %j", "PUSH BC", "ADD A, %b", "RST $00",
+    "RET Z", "RET", "JP Z, %j", "PREFIX CB", "CALL Z, %j", "CALL %j", "ADC A, %b", "RST $08",
+    // 0xD0
+    "RET NC", "POP DE", "JP NC, %j", NULL, "CALL NC, %j", "PUSH DE", "SUB %b", "RST $10",
+    "RET C", "RETI", "JP C, %j", NULL, "CALL C, %j", NULL, "SBC A, %b", "RST $18",
+    // 0xE0
+    "LDH (%h), A", "POP HL", "LD (C), A", NULL, NULL, "PUSH HL", "AND %b", "RST $20",
+    "ADD SP, %s", "JP HL", "LD (%m), A", NULL, NULL, NULL, "XOR %b", "RST $28",
+    // 0xF0
+    "LDH A, (%h)", "POP AF", "LD A, (C)", "DI", NULL, "PUSH AF", "OR %b", "RST $30",
+    "LD HL, SP%s", "LD SP, HL", "LD A, (%m)", "EI", NULL, NULL, "CP %b", "RST $38",
+};
+
+static const char* const cb_ops[8] = { "RLC", "RRC", "RL", "RR", "SLA", "SRA", "SWAP", "SRL" };
+static const char* const cb_bit_ops[4] = { NULL, "BIT", "RES", "SET" };
+static const char* const cb_regs[8] = { "B", "C", "D", "E", "H", "L", "(HL)", "A" };
+
+// Hardware register names for 0xFF00-0xFFFF operands
+static const char* io_name(uint8_t low) {
+    switch (low) {
+        case 0x00: return "rP1";
+        case 0x01: return "rSB";
+        case 0x02: return "rSC";
+        case 0x04: return "rDIV";
+        case 0x05: return "rTIMA";
+        case 0x06: return "rTMA";
+        case 0x07: return "rTAC";
+        case 0x0F: return "rIF";
+        case 0x40: return "rLCDC";
+        case 0x41: return "rSTAT";
+        case 0x42: return "rSCY";
+        case 0x43: return "rSCX";
+        case 0x44: return "rLY";
+        case 0x45: return "rLYC";
+        case 0x46: return "rDMA";
+        case 0x47: return "rBGP";
+        case 0x48: return "rOBP0";
+        case 0x49: return "rOBP1";
+        case 0x4A: return "rWY";
+        case 0x4B: return "rWX";
+        case 0xFF: return "rIE";
+        default:   return NULL;
+    }
+}
+
+int d_asm_length(uint8_t opcode) {
+    const char* text = base_ops[opcode];
+    if (opcode == 0xCB || opcode == 0x10) return 2;
+    if (!text) return 1;
+
+    const char* marker = strchr(text, '%');
+    if (!marker) return 1;
+    return (marker[1] == 'w' || marker[1] == 'm' || marker[1] == 'j') ? 3 : 2;
+}
+
+// ---------------------------------------------------------------------------
+// Formatting
+// ---------------------------------------------------------------------------
+
+static void format_address(char* out, size_t size, uint16_t address, DAsmSymbolFunc symbol, void* ctx) {
+    const char* name = symbol ? symbol(ctx, address) : NULL;
+    if (name) snprintf(out, size, "%s", name);
+    else snprintf(out, size, "$%04X", address);
+}
+
+int d_asm_format(const uint8_t* code, size_t avail, uint16_t pc, char* buf, size_t size,
+                 DAsmSymbolFunc symbol, void* ctx) {
+    uint8_t opcode = code[0];
+    int length = d_asm_length(opcode);
+    const char* text = base_ops[opcode];
+
+    if (!text || (size_t)length > avail) {
+        snprintf(buf, size, "DB $%02X", opcode);
+        return 1;
+    }
+
+    if (opcode == 0xCB) {
+        uint8_t cb = code[1];
+        const char* reg = cb_regs[cb & 7];
+        if (cb < 0x40) snprintf(buf, size, "%s %s", cb_ops[cb >> 3], reg);
+        else snprintf(buf, size, "%s %d, %s", cb_bit_ops[cb >> 6], (cb >> 3) & 7, reg);
+        return 2;
+    }
+
+    // Expand the operand marker; every template has at most one
+    const char* marker = strchr(text, '%');
+    if (!marker) {
+        snprintf(buf, size, "%s", text);
+        return length;
+    }
+
+    char operand[D_ASM_TEXT_SIZE];
+    uint8_t n = code[1];
+    uint16_t nn = length == 3 ? code[1] | (code[2] << 8) : n;
+    const char* name;
+
+    switch (marker[1]) {
+        case 'b':
+            snprintf(operand, sizeof(operand), "$%02X", n);
+            break;
+        case 'w':
+            snprintf(operand, sizeof(operand), "$%04X", nn);
+            break;
+        case 'm':
+            name = nn >= 0xFF00 ? io_name(nn & 0xFF) : NULL;
+            if (name) snprintf(operand, sizeof(operand), "%s", name);
+            else snprintf(operand, sizeof(operand), "$%04X", nn);
+            break;
+        case 'h':
+            name = io_name(n);
+            if (name) snprintf(operand, sizeof(operand), "%s", name);
+            else snprintf(operand, sizeof(operand), "$FF%02X", n);
+            break;
+        case 's':
+            snprintf(operand, sizeof(operand), "%+d", (int8_t)n);
+            break;
+        case 'j':
+            format_address(operand, sizeof(operand), nn, symbol, ctx);
+            break;
+        default:    // 'r'
+            format_address(operand, sizeof(operand), pc + 2 + (int8_t)n, symbol, ctx);
+            break;
+    }
+
+    snprintf(buf, size, "%.*s%s%s", (int)(marker - text), text, operand, marker + 2);
+    return length;
+}
+
+// ---------------------------------------------------------------------------
+// Whole-ROM discovery
+// ---------------------------------------------------------------------------
+
+DAsmRom* d_asm_rom_create(const uint8_t* rom, size_t size) {
+    DAsmRom* dasm = calloc(1, sizeof(DAsmRom));
+    if (!dasm) return NULL;
+
+    dasm->rom = rom;
+    dasm->size = size;
+    dasm->banks = (size + D_ASM_BANK_SIZE - 1) / D_ASM_BANK_SIZE;
+    dasm->flags = calloc(size ? size : 1, 1);
+    memset(dasm->rst_table, -1, sizeof(dasm->rst_table));
+    if (!dasm->flags) {
+        free(dasm);
+        return NULL;
+    }
+    return dasm;
+}
+
+void d_asm_rom_free(DAsmRom* dasm) {
+    if (!dasm) return;
+    free(dasm->flags);
+    free(dasm->work);
+    free(dasm);
+}
+
+// CPU address -> ROM offset, or -1 if not in ROM or the bank is unknown
+static int64_t rom_offset(DAsmRom* dasm, uint16_t address, uint32_t bank) {
+    uint64_t offset;
+    if (address < 0x4000) offset = address;
+    else if (address < 0x8000) offset = (uint64_t)bank * D_ASM_BANK_SIZE + (address - 0x4000);
+    else return -1;
+    return offset < dasm->size ? (int64_t)offset : -1;
+}
+
+static uint16_t cpu_address(uint32_t offset) {
+    return offset < D_ASM_BANK_SIZE ? offset : 0x4000 + (offset % D_ASM_BANK_SIZE);
+}
+
+// Bank mapped at 0x4000 while code at offset runs, given the caller's guess
+static int effective_bank(DAsmRom* dasm, uint32_t offset, int hint) {
+    if (offset >= D_ASM_BANK_SIZE) return offset / D_ASM_BANK_SIZE;
+    if (hint >= 1) return hint;
+    return dasm->banks <= 2 ? 1 : -1;
+}
+
+static int push_work(DAsmRom* dasm, uint32_t offset, int bank) {
+    if (dasm->flags[offset] & D_ASM_CODE) return 0;
+    if (dasm->work_count == dasm->work_cap) {
+        size_t cap = dasm->work_cap ? dasm->work_cap * 2 : 1024;
+        DAsmWork* work = realloc(dasm->work, cap * sizeof(DAsmWork));
+        if (!work) return -1;
+        dasm->work = work;
+        dasm->work_cap = cap;
+    }
+    dasm->work[dasm->work_count++] = (DAsmWork){ offset, bank };
+    return 0;
+}
+
+// Queue a code target; from is the offset of the referencing code
+static int add_target(DAsmRom* dasm, uint16_t address, uint32_t from, int hint, uint8_t kind) {
+    int bank = effective_bank(dasm, from, hint);
+    if (address >= 0x4000 && address < 0x8000 && bank < 0) {
+        dasm->unresolved++;
+        return 0;
+    }
+
+    int64_t offset = rom_offset(dasm, address, bank < 0 ? 1 : bank);
+    if (offset < 0) return 0;
+
+    dasm->flags[offset] |= kind;
+    return push_work(dasm, offset, hint);
+}
+
+// A dispatcher pops its return address (the table) and jumps through it:
+// POP HL somewhere before JP HL in the first few instructions
+static bool is_table_dispatcher(DAsmRom* dasm, uint32_t offset) {
+    bool pop_hl = false;
+    for (int i = 0; i < 16 && offset < dasm->size; i++) {
+        uint8_t opcode = dasm->rom[offset];
+        if (opcode == 0xE1) pop_hl = true;
+        if (opcode == 0xE9) return pop_hl;
+        if (opcode == 0xC3 && i == 0 && offset + 2 < dasm->size) {
+            // RST slot that just jumps to the real dispatcher
+            int64_t target = rom_offset(dasm, dasm->rom[offset + 1] | (dasm->rom[offset + 2] << 8), 1);
+            if (target < 0 || target >= D_ASM_BANK_SIZE) return false;
+            offset = target;
+            continue;
+        }
+        if (opcode == 0xC9 || opcode == 0xD9 || opcode == 0x18 || opcode == 0xC3) return false;
+        offset += d_asm_length(opcode);
+    }
+    return false;
+}
+
+// Read 16-bit code pointers at offset until one does not look like code
+static int read_jump_table(DAsmRom* dasm, uint32_t offset, int hint) {
+    uint32_t bank_end = (offset / D_ASM_BANK_SIZE + 1) * D_ASM_BANK_SIZE;
+    int entries = 0;
+
+    for (; entries < 256 && offset + 1 < bank_end && offset + 1 < dasm->size; offset += 2) {
+        if ((dasm->flags[offset] | dasm->flags[offset + 1]) & (D_ASM_CODE | D_ASM_TABLE)) break;
+        uint16_t target = dasm->rom[offset] | (dasm->rom[offset + 1] << 8);
+        if (target < 0x0150 || target >= 0x8000) break;
+
+        if (entries == 0) dasm->flags[offset] |= D_ASM_TABLE_START;
+        dasm->flags[offset] |= D_ASM_TABLE;
+        dasm->flags[offset + 1] |= D_ASM_TABLE;
+        if (add_target(dasm, target, offset, hint, D_ASM_JUMP) != 0) return -1;
+        entries++;
+    }
+    if (entries) dasm->tables++;
+    return 0;
+}
+
+// Instructions that leave A alone between "LD A,n" and the bank register write
+static bool keeps_a(uint8_t opcode) {
+    switch (opcode) {
+        case 0x00: case 0x3E: case 0xAF:                        // NOP, LD A,n, XOR A
+        case 0x02: case 0x12: case 0x22: case 0x32: case 0x77:  // Stores of A
+        case 0xE0: case 0xEA: case 0xE2:
+        case 0x01: case 0x11: case 0x21: case 0x31: case 0xF5:  // LD rr,nn, PUSH AF
+        case 0x47: case 0x4F: case 0x57: case 0x5F: case 0x67: case 0x6F:   // LD r,A
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Decode linearly from one work item until control cannot fall through
+static int trace_code(DAsmRom* dasm, uint32_t offset, int hint) {
+    uint32_t bank_end = (offset / D_ASM_BANK_SIZE + 1) * D_ASM_BANK_SIZE;
+    if (bank_end > dasm->size) bank_end = dasm->size;
+
+    int last_a = -1;        // Known value of A, for bank switch writes
+    int table_hl = -1;      // LD HL,d16 seen before a pointer load
+    bool pointer_load = false;
+
+    while (offset < bank_end && !(dasm->flags[offset] & (D_ASM_CODE | D_ASM_TABLE))) {
+        const uint8_t* code = &dasm->rom[offset];
+        uint8_t opcode = code[0];
+        int length = d_asm_length(opcode);
+        if (offset + length > bank_end) break;
+        if (length > 1 && (dasm->flags[offset + length - 1] & (D_ASM_CODE | D_ASM_TABLE))) break;   // Overlap
+
+        dasm->flags[offset] |= D_ASM_CODE | D_ASM_START;
+        for (int i = 1; i < length; i++) dasm->flags[offset + i] |= D_ASM_CODE;
+        dasm->instructions++;
+        dasm->code_bytes += length;
+
+        uint16_t pc = cpu_address(offset);
+        uint16_t nn = length == 3 ? code[1] | (code[2] << 8) : 0;
+        uint32_t here = offset;
+        offset += length;
+
+        switch (opcode) {
+            // Unconditional transfers
+            case 0xC3:
+                return add_target(dasm, nn, here, hint, D_ASM_JUMP);
+            case 0x18:
+                return add_target(dasm, pc + 2 + (int8_t)code[1], here, hint, D_ASM_JUMP);
+            case 0xC9: case 0xD9:
+                return 0;
+            case 0xE9:
+                if (table_hl >= 0 && pointer_load) {
+                    int bank = effective_bank(dasm, here, hint);
+                    int64_t table = bank >= 0 || table_hl < 0x4000 ? rom_offset(dasm, table_hl, bank) : -1;
+                    if (table >= 0) return read_jump_table(dasm, table, hint);
+                }
+                return 0;
+
+            // Conditional transfers and calls fall through
+            case 0xC2: case 0xCA: case 0xD2: case 0xDA:
+                if (add_target(dasm, nn, here, hint, D_ASM_JUMP) != 0) return -1;
+                break;
+            case 0x20: case 0x28: case 0x30: case 0x38:
+                if (add_target(dasm, pc + 2 + (int8_t)code[1], here, hint, D_ASM_JUMP) != 0) return -1;
+                break;
+            case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:
+                if (add_target(dasm, nn, here, hint, D_ASM_CALL) != 0) return -1;
+                break;
+
+            case 0xC7: case 0xCF: case 0xD7: case 0xDF:
+            case 0xE7: case 0xEF: case 0xF7: case 0xFF: {
+                int vector = opcode & 0x38;
+                if (add_target(dasm, vector, here, hint, D_ASM_CALL) != 0) return -1;
+                int8_t* table = &dasm->rst_table[vector >> 3];
+                if (*table < 0) *table = is_table_dispatcher(dasm, vector);
+                if (*table) return read_jump_table(dasm, offset, hint);
+                break;
+            }
+
+            // Track enough state to follow bank switches and jump tables
+            case 0x3E:
+                last_a = code[1];
+                break;
+            case 0xAF:
+                last_a = 0;
+                break;
+            case 0xEA:
+                if (nn >= 0x2000 && nn < 0x4000 && last_a >= 0 && here < D_ASM_BANK_SIZE) {
+                    hint = last_a ? last_a % dasm->banks : 1;
+                }
+                break;
+            case 0x21:
+                table_hl = nn;
+                pointer_load = false;
+                break;
+            case 0x66:      // LD H,(HL) after LD A,(HL+): pointer fetched from the table
+                pointer_load = table_hl >= 0;
+                break;
+
+            default:
+                // Illegal opcodes lock the CPU
+                if (!base_ops[opcode]) return 0;
+                break;
+        }
+        if (!keeps_a(opcode)) last_a = -1;
+    }
+    return 0;
+}
+
+int d_asm_rom_analyze(DAsmRom* dasm) {
+    if (dasm->size < 0x150) return 0;
+
+    // Entry point and interrupt vectors; RST vectors count once referenced
+    static const uint16_t roots[] = { 0x0100, 0x0040, 0x0048, 0x0050, 0x0058, 0x0060 };
+    for (size_t i = 0; i < sizeof(roots) / sizeof(roots[0]); i++) {
+        dasm->flags[roots[i]] |= i == 0 ? D_ASM_JUMP : D_ASM_CALL;
+        if (push_work(dasm, roots[i], -1) != 0) return -1;
+    }
+
+    // The cartridge header is data
+    for (uint32_t i = 0x104; i < 0x150; i++) dasm->flags[i] |= D_ASM_CODE;
+
+    while (dasm->work_count > 0) {
+        DAsmWork work = dasm->work[--dasm->work_count];
+        if (trace_code(dasm, work.offset, work.bank) != 0) return -1;
+    }
+
+    for (uint32_t i = 0x104; i < 0x150; i++) dasm->flags[i] &= ~D_ASM_CODE;
+    for (size_t i = 0; i < dasm->size; i++) {
+        if (dasm->flags[i] & (D_ASM_JUMP | D_ASM_CALL | D_ASM_TABLE_START)) dasm->labels++;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Listing
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    DAsmRom* dasm;
+    uint32_t bank;          // Bank of the instruction being printed
+    char name[32];
+} ListContext;
+
+static bool label_name(DAsmRom* dasm, uint32_t offset, char* buf, size_t size) {
+    uint8_t flags = dasm->flags[offset];
+    uint32_t bank = offset / D_ASM_BANK_SIZE;
+    uint16_t address = cpu_address(offset);
+
+    if (!(flags & (D_ASM_JUMP | D_ASM_CALL | D_ASM_TABLE_START))) return false;
+
+    static const char* const vectors[] = { "int_vblank", "int_stat", "int_timer", "int_serial", "int_joypad" };
+    if (address == 0x0100 && bank == 0) snprintf(buf, size, "entry");
+    else if (address < 0x40 && bank == 0 && !(address & 7)) snprintf(buf, size, "rst_%02X", address);
+    else if (address >= 0x40 && address <= 0x60 && !(address & 7) && bank == 0) snprintf(buf, size, "%s", vectors[(address - 0x40) >> 3]);
+    else if (flags & D_ASM_TABLE_START) snprintf(buf, size, "tbl_%02X_%04X", bank, address);
+    else if (flags & D_ASM_CALL) snprintf(buf, size, "sub_%02X_%04X", bank, address);
+    else snprintf(buf, size, "loc_%02X_%04X", bank, address);
+    return true;
+}
+
+static const char* list_symbol(void* arg, uint16_t address) {
+    ListContext* ctx = arg;
+    int64_t offset = rom_offset(ctx->dasm, address, ctx->bank ? ctx->bank : 1);
+    if (address >= 0x4000 && ctx->bank == 0 && ctx->dasm->banks > 2) return NULL;   // Bank unknown
+    if (offset < 0 || !label_name(ctx->dasm, offset, ctx->name, sizeof(ctx->name))) return NULL;
+    return ctx->name;
+}
+
+void d_asm_rom_list(DAsmRom* dasm, FILE* out) {
+    ListContext ctx = { .dasm = dasm };
+    char label[32];
+    char text[D_ASM_TEXT_SIZE];
+    size_t offset = 0;
+
+    while (offset < dasm->size) {
+        uint32_t bank = offset / D_ASM_BANK_SIZE;
+        uint16_t address = cpu_address(offset);
+        if (address == 0 || address == 0x4000) fprintf(out, "\n; ---- bank $%02X ----\n", bank);
+        if (label_name(dasm, offset, label, sizeof(label))) fprintf(out, "%s:\n", label);
+
+        uint8_t flags = dasm->flags[offset];
+        if (flags & D_ASM_START) {
+            ctx.bank = bank;
+            int length = d_asm_format(&dasm->rom[offset], dasm->size - offset, address,
+                                      text, sizeof(text), list_symbol, &ctx);
+            fprintf(out, "%02X:%04X  ", bank, address);
+            for (int i = 0; i < 3; i++) {
+                if (i < length) fprintf(out, "%02X ", dasm->rom[offset + i]);
+                else fputs("   ", out);
+            }
+            fprintf(out, "  %s\n", text);
+            offset += length;
+        } else if (flags & D_ASM_TABLE) {
+            ctx.bank = bank;
+            const char* name = list_symbol(&ctx, dasm->rom[offset] | (dasm->rom[offset + 1] << 8));
+            fprintf(out, "%02X:%04X  %02X %02X      DW ", bank, address, dasm->rom[offset], dasm->rom[offset + 1]);
+            if (name) fprintf(out, "%s\n", name);
+            else fprintf(out, "$%04X\n", dasm->rom[offset] | (dasm->rom[offset + 1] << 8));
+            offset += 2;
+        } else {
+            // Data run up to 16 bytes, stopping at code, tables, labels or the bank edge
+            size_t end = offset + 1;
+            while (end < dasm->size && end - offset < 16 && end % D_ASM_BANK_SIZE &&
+                   !(dasm->flags[end] & (D_ASM_START | D_ASM_TABLE | D_ASM_JUMP | D_ASM_CALL | D_ASM_TABLE_START))) {
+                end++;
+            }
+            // Hand-formatted: data dominates large ROMs
+            static const char hex[] = "0123456789ABCDEF";
+            char line[128];
+            int n = snprintf(line, sizeof(line), "%02X:%04X  DB ", bank, address);
+            for (size_t i = offset; i < end; i++) {
+                uint8_t byte = dasm->rom[i];
+                line[n++] = '$';
+                line[n++] = hex[byte >> 4];
+                line[n++] = hex[byte & 15];
+                line[n++] = i + 1 < end ? ',' : '\n';
+            }
+            fwrite(line, 1, n, out);
+            offset = end;
+        }
     }
 }
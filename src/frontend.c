@@ -0,0 +1,340 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "frontend.h"
+#include "hud.h"
+#include "rewind.h"
+#include "triple_buffer.h"
+
+// Keyboard -> JOYPAD_* bit, 0 for keys we ignore
+static uint8_t key_button(SDL_Keycode key)
+{
+    switch (key) {
+        case SDLK_RIGHT:     return JOYPAD_RIGHT;
+        case SDLK_LEFT:      return JOYPAD_LEFT;
+        case SDLK_UP:        return JOYPAD_UP;
+        case SDLK_DOWN:      return JOYPAD_DOWN;
+        case SDLK_x:         return JOYPAD_A;
+        case SDLK_z:         return JOYPAD_B;
+        case SDLK_RETURN:    return JOYPAD_START;
+        case SDLK_BACKSPACE:
+        case SDLK_RSHIFT:    return JOYPAD_SELECT;
+        default:             return 0;
+    }
+}
+
+// Input messages, SDL thread -> emulation thread
+#define INPUT_BUTTONS    0x100      // | JOYPAD_* state
+#define INPUT_REWIND_ON  0x200
+#define INPUT_REWIND_OFF 0x300
+#define INPUT_QUEUE_SIZE 64         // Power of two
+
+// One published frame: the picture and what the overlay shows for it
+typedef struct {
+    uint32_t pixels[PPU_WIDTH * PPU_HEIGHT];
+    HudSnapshot hud;
+} FrontendFrame;
+
+// State shared by the two threads. Everything else in the emulation thread
+// (the GameBoy, rewind history, movie) is only touched by that thread once
+// it has started.
+typedef struct {
+    GameBoy* gb;
+    const FrontendOptions* options;
+    uint32_t frameskip;
+    TripleBuffer* frames;
+
+    // Single-producer/single-consumer input queue
+    uint16_t input[INPUT_QUEUE_SIZE];
+    _Atomic uint32_t input_head;    // SDL thread
+    _Atomic uint32_t input_tail;    // Emulation thread
+
+    _Atomic bool quit;              // Set by the SDL thread
+    _Atomic bool done;              // Set by the emulation thread when it stops
+} Frontend;
+
+// A full queue drops the message; the next key event resends the whole state
+static void input_push(Frontend* fe, uint16_t message)
+{
+    uint32_t head = atomic_load_explicit(&fe->input_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&fe->input_tail, memory_order_acquire);
+    if (head - tail == INPUT_QUEUE_SIZE) return;
+    fe->input[head & (INPUT_QUEUE_SIZE - 1)] = message;
+    atomic_store_explicit(&fe->input_head, head + 1, memory_order_release);
+}
+
+static bool input_pop(Frontend* fe, uint16_t* message)
+{
+    uint32_t tail = atomic_load_explicit(&fe->input_tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&fe->input_head, memory_order_acquire);
+    if (tail == head) return false;
+    *message = fe->input[tail & (INPUT_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&fe->input_tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// Returns false once the window is closed
+static bool poll_input(Frontend* fe, uint8_t* buttons, bool* hud)
+{
+    SDL_Event event;
+    uint8_t state = *buttons;
+    while (SDL_PollEvent(&event)) {
+        switch (event.type) {
+            case SDL_QUIT:
+                return false;
+            case SDL_KEYDOWN:
+                if (event.key.keysym.sym == SDLK_ESCAPE) return false;
+                if (event.key.keysym.sym == SDLK_r) input_push(fe, INPUT_REWIND_ON);
+                if (event.key.keysym.sym == SDLK_F1) *hud = !*hud;
+                state |= key_button(event.key.keysym.sym);
+                break;
+            case SDL_KEYUP:
+                if (event.key.keysym.sym == SDLK_r) input_push(fe, INPUT_REWIND_OFF);
+                state &= ~key_button(event.key.keysym.sym);
+                break;
+        }
+    }
+    if (state != *buttons) {
+        input_push(fe, INPUT_BUTTONS | state);
+        *buttons = state;
+    }
+    return true;
+}
+
+// SDL audio thread: drain the ring, repeat the last frame on underrun
+static void audio_callback(void* userdata, Uint8* stream, int length)
+{
+    AudioRing* ring = userdata;
+    int16_t* out = (int16_t*)stream;
+    uint32_t wanted = length / (2 * sizeof(int16_t));
+    uint32_t got = audio_ring_read(ring, out, wanted);
+
+    int16_t left = got ? out[got * 2 - 2] : 0;
+    int16_t right = got ? out[got * 2 - 1] : 0;
+    for (uint32_t i = got; i < wanted; i++) {
+        out[i * 2] = left;
+        out[i * 2 + 1] = right;
+    }
+}
+
+static SDL_AudioDeviceID open_audio(GameBoy* gb)
+{
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) return 0;
+    AudioRing* ring = gb_audio_open(gb, APU_SAMPLE_RATE);
+    if (!ring) return 0;
+
+    SDL_AudioSpec want = {
+        .freq = APU_SAMPLE_RATE,
+        .format = AUDIO_S16SYS,
+        .channels = 2,
+        .samples = 512,
+        .callback = audio_callback,
+        .userdata = ring,
+    };
+    SDL_AudioDeviceID device = SDL_OpenAudioDevice(NULL, 0, &want, NULL, 0);
+    if (!device) {
+        printf("SDL audio: %s\n", SDL_GetError());
+        return 0;
+    }
+    SDL_PauseAudioDevice(device, 0);
+    return device;
+}
+
+// Copy a frame into the streaming texture and show it; blocks for vsync
+static void present(SDL_Renderer* renderer, SDL_Texture* texture, const FrontendFrame* frame,
+                    Hud* hud, float fps)
+{
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(texture, NULL, &pixels, &pitch) == 0) {
+        for (int y = 0; y < PPU_HEIGHT; y++) {
+            memcpy((uint8_t*)pixels + y * pitch, frame->pixels + y * PPU_WIDTH, PPU_WIDTH * sizeof(uint32_t));
+        }
+        SDL_UnlockTexture(texture);
+    }
+    SDL_RenderClear(renderer);
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    if (hud) hud_draw(hud, &frame->hud, fps);
+    SDL_RenderPresent(renderer);
+}
+
+// The picture finished at the last VBlank; the framebuffer at a frame end
+// is usually partway into the next one
+static void publish(Frontend* fe, float fps)
+{
+    FrontendFrame* frame = triple_buffer_back(fe->frames);
+    memcpy(frame->pixels, gb_picture(fe->gb), sizeof(frame->pixels));
+    hud_capture(&frame->hud, fe->gb, fps);
+    triple_buffer_publish(fe->frames);
+}
+
+// Frames per second over the last second or so
+typedef struct {
+    uint64_t start;
+    uint32_t frames;
+    float fps;
+} RateMeter;
+
+static void rate_tick(RateMeter* meter, uint64_t frequency)
+{
+    uint64_t now = SDL_GetPerformanceCounter();
+    meter->frames++;
+    if (now - meter->start >= frequency) {
+        meter->fps = (float)(meter->frames * (double)frequency / (now - meter->start));
+        meter->start = now;
+        meter->frames = 0;
+    }
+}
+
+// Emulation thread: runs and paces the machine, never waits on the display
+static void* emulate(void* arg)
+{
+    Frontend* fe = arg;
+    GameBoy* gb = fe->gb;
+    const FrontendOptions* options = fe->options;
+
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    double ticks_per_frame = options->speed > 0 ? frequency / (FRONTEND_FPS * options->speed) : 0;
+    double deadline = (double)SDL_GetPerformanceCounter();
+
+    Rewind* history = options->rewind ? rewind_create(gb, REWIND_BUDGET, REWIND_FRAMES, REWIND_KEYFRAME) : NULL;
+    if (options->rewind && !history) printf("rewind: out of memory\n");
+
+    RateMeter rate = { .start = SDL_GetPerformanceCounter() };
+    bool rewinding = false;
+    uint8_t held = gb->joypad->state;
+    uint32_t drawn = gb_frames_drawn(gb);
+    for (long frame = 0; options->frames == 0 || frame < options->frames; frame++) {
+        if (atomic_load_explicit(&fe->quit, memory_order_relaxed)) break;
+
+        uint16_t message;
+        while (input_pop(fe, &message)) {
+            if (message == INPUT_REWIND_ON) rewinding = true;
+            else if (message == INPUT_REWIND_OFF) rewinding = false;
+            else held = message & 0xFF;
+        }
+
+        if (history && rewinding) {
+            // Replayed frames are always drawn
+            rewind_step(history);
+            if (options->movie) movie_truncate(options->movie, gb->frame_count);
+        } else {
+            // After a rewind the joypad holds the recorded buttons
+            if (gb->joypad->state != held) gb_set_buttons(gb, held);
+            if (options->movie) movie_add_frame(options->movie, held);
+            gb_run_frame(gb);
+            if (history) rewind_capture(history);
+        }
+        rate_tick(&rate, frequency);
+
+        if (gb_frames_drawn(gb) != drawn) {
+            drawn = gb_frames_drawn(gb);
+            publish(fe, rate.fps);
+        } else if (!(gb->ppu->lcdc & 0x80) && frame % fe->frameskip == 0) {
+            publish(fe, rate.fps);              // LCD off: show the blank screen
+        }
+
+        if (ticks_per_frame == 0) continue;
+        deadline += ticks_per_frame;
+        double now = (double)SDL_GetPerformanceCounter();
+        if (now > deadline + 4 * ticks_per_frame) {
+            deadline = now;                     // Fell behind: don't try to catch up
+        } else if (deadline > now) {
+            SDL_Delay((uint32_t)((deadline - now) * 1000 / frequency));
+        }
+    }
+
+    rewind_free(history);
+    atomic_store_explicit(&fe->done, true, memory_order_release);
+    return NULL;
+}
+
+int frontend_run(GameBoy* gb, const FrontendOptions* options)
+{
+    int scale = options->scale > 0 ? options->scale : 3;
+    Frontend fe = {
+        .gb = gb,
+        .options = options,
+        .frameskip = options->frameskip ? options->frameskip : 1,
+        .frames = triple_buffer_create(sizeof(FrontendFrame)),
+    };
+    if (!fe.frames) {
+        printf("out of memory\n");
+        return -1;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        printf("SDL_Init: %s\n", SDL_GetError());
+        triple_buffer_free(fe.frames);
+        return -1;
+    }
+    SDL_Window* window = SDL_CreateWindow(gb->cart->title,
+                                          SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                                          PPU_WIDTH * scale, PPU_HEIGHT * scale, 0);
+    // Vsync only blocks this thread; pacing is the emulation thread's
+    SDL_Renderer* renderer = window ? SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED |
+                                                         SDL_RENDERER_PRESENTVSYNC) : NULL;
+    SDL_Texture* texture = renderer ? SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                                        SDL_TEXTUREACCESS_STREAMING,
+                                                        PPU_WIDTH, PPU_HEIGHT) : NULL;
+    if (!texture) {
+        printf("SDL: %s\n", SDL_GetError());
+        if (renderer) SDL_DestroyRenderer(renderer);
+        if (window) SDL_DestroyWindow(window);
+        SDL_Quit();
+        triple_buffer_free(fe.frames);
+        return -1;
+    }
+
+    // Text is rasterized once; without the font there is just no overlay
+    Hud* hud = hud_create(renderer, HUD_FONT_PATH, HUD_POINT_SIZE);
+    if (!hud) printf("%s: could not load the overlay font\n", HUD_FONT_PATH);
+    bool show_hud = options->hud;
+
+    // Skipped frames produce no pixels, so only every Nth one is presented
+    gb_set_frameskip(gb, fe.frameskip);
+
+    // Faster than real time the ring would only overflow
+    SDL_AudioDeviceID audio = options->audio && options->speed == 1.0 ? open_audio(gb) : 0;
+
+    atomic_init(&fe.input_head, 0);
+    atomic_init(&fe.input_tail, 0);
+    atomic_init(&fe.quit, false);
+    atomic_init(&fe.done, false);
+    pthread_t thread;
+    bool started = pthread_create(&thread, NULL, emulate, &fe) == 0;
+    if (!started) {
+        printf("could not start the emulation thread\n");
+        atomic_store(&fe.done, true);
+    }
+
+    // Present whatever is newest; with nothing new, poll input again shortly
+    uint8_t buttons = 0;
+    RateMeter rate = { .start = SDL_GetPerformanceCounter() };
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    while (!atomic_load_explicit(&fe.done, memory_order_acquire)) {
+        if (!poll_input(&fe, &buttons, &show_hud)) break;
+        const FrontendFrame* frame = triple_buffer_take(fe.frames);
+        if (!frame) {
+            SDL_Delay(1);
+            continue;
+        }
+        present(renderer, texture, frame, show_hud ? hud : NULL, rate.fps);
+        rate_tick(&rate, frequency);
+    }
+    atomic_store_explicit(&fe.quit, true, memory_order_relaxed);
+    if (gb->link) link_unplug(gb->link);    // It may be waiting on its partner
+    if (started) pthread_join(thread, NULL);
+
+    if (audio) SDL_CloseAudioDevice(audio);
+    hud_free(hud);
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    triple_buffer_free(fe.frames);
+    return 0;
+}
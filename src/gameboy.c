@@ -0,0 +1,296 @@
+#include <stdlib.h>
+#include <string.h>
+#include "gameboy.h"
+#include "idle.h"
+#include "profiler.h"
+#include "trace.h"
+
+static void set_error(int* error, int value) {
+    if (error) *error = value;
+}
+
+GameBoy* gb_create(const char* rom_path, int* error) {
+    GameBoy* gb = calloc(1, sizeof(GameBoy));
+    if (!gb) {
+        set_error(error, GB_ERR_NOMEM);
+        return NULL;
+    }
+
+    int result = load_rom(rom_path, &gb->cart);
+    if (result != CART_OK) {
+        if (result == CART_ERR_NOMEM) set_error(error, GB_ERR_NOMEM);
+        else if (result == CART_ERR_TOO_SMALL) set_error(error, GB_ERR_ROM_INVALID);
+        else set_error(error, GB_ERR_ROM);
+        gb_destroy(gb);
+        return NULL;
+    }
+
+    gb->mmu = mmu_create();
+    gb->cpu = cpu_create();
+    gb->timer = gb_timer_create();
+    gb->ppu = ppu_create();
+    gb->apu = apu_create();
+    gb->joypad = joypad_create();
+    gb->serial = serial_create();
+    if (!gb->mmu || !gb->cpu || !gb->timer || !gb->ppu || !gb->apu || !gb->joypad || !gb->serial) {
+        set_error(error, GB_ERR_NOMEM);
+        gb_destroy(gb);
+        return NULL;
+    }
+
+    // Link components through the MMU
+    sched_init(&gb->sched);
+    MMU* mmu = gb->mmu;
+    mmu->cpu = gb->cpu;
+    mmu->sched = &gb->sched;
+    mmu->timer = gb->timer;
+    mmu->ppu = gb->ppu;
+    mmu->apu = gb->apu;
+    mmu->joypad = gb->joypad;
+    mmu->serial = gb->serial;
+
+    // Init memory managment unit
+    if (mmu_init(mmu, gb->cart) == -1) {
+        set_error(error, GB_ERR_CARTRIDGE);
+        gb_destroy(gb);
+        return NULL;
+    }
+
+    cpu_init(gb->cpu, mmu);
+    timer_init(gb->timer, mmu, &gb->sched);
+    ppu_init(gb->ppu, mmu, &gb->sched);
+    apu_init(gb->apu);
+    joypad_init(gb->joypad);
+    serial_init(gb->serial);
+
+    if (gb_state_init(gb) != 0) {
+        set_error(error, GB_ERR_NOMEM);
+        gb_destroy(gb);
+        return NULL;
+    }
+
+    set_error(error, GB_OK);
+    return gb;
+}
+
+void gb_destroy(GameBoy* gb) {
+    if (!gb) return;
+    if (gb->cpu) gb_trace_stop(gb);
+    if (gb->cpu) gb_profile_stop(gb);
+    if (gb->mmu) gb_link_close(gb);
+    save_close(gb->save);
+    if (gb->cpu) cpu_free(gb->cpu);
+    if (gb->mmu) mmu_free(gb->mmu);
+    if (gb->timer) timer_free(gb->timer);
+    if (gb->ppu) ppu_free(gb->ppu);
+    if (gb->apu) apu_free(gb->apu);
+    if (gb->serial) serial_free(gb->serial);
+    if (gb->joypad) joypad_free(gb->joypad);
+    if (gb->cart) cartridge_free(gb->cart);
+    free(gb->state_stage);
+    free(gb);
+}
+
+const char* gb_error_string(int error) {
+    switch (error) {
+        case GB_OK: return "ok";
+        case GB_ERR_ROM: return "could not load ROM";
+        case GB_ERR_CARTRIDGE: return "cartridge type not implemented";
+        case GB_ERR_NOMEM: return "out of memory";
+        case GB_ERR_ROM_INVALID: return "ROM too small to hold a header";
+        default: return "unknown error";
+    }
+}
+
+// Partner transfers whose byte has landed by now; this end is the one on
+// the external clock
+static void gb_link_receive(GameBoy* gb, uint64_t now) {
+    LinkPending message;
+    while (link_take(gb->link, LINK_START, now, &message)) {
+        uint8_t out;
+        if (serial_receive(gb->serial, message.value, &out)) {
+            gb->mmu->memory[0xFF0F] |= INT_SERIAL;
+        }
+        link_send(gb->link, LINK_REPLY, message.due, out);
+    }
+}
+
+// Publish how far this end has run. Capped at a window past the partner:
+// bytes it sent later land no earlier than that, and our replies to them
+// have to be in the ring before our time passes them.
+static void gb_link_publish(GameBoy* gb, uint64_t partner, uint64_t now) {
+    uint64_t limit = partner == SCHED_NEVER ? now : partner + LINK_WINDOW;
+    link_publish(gb->link, now < limit ? now : limit);
+}
+
+// Lockstep: deliver what has landed, publish, and wait while a whole window
+// ahead of the partner. Then run to the window end or the next partner byte.
+static void gb_link_sync(GameBoy* gb) {
+    Link* link = gb->link;
+    uint64_t now = gb->cpu->cycles;
+    uint64_t partner;
+    for (;;) {
+        partner = link_partner_time(link);
+        link_poll(link);
+        gb_link_receive(gb, now);
+        gb_link_publish(gb, partner, now);
+        if (partner == SCHED_NEVER || partner + LINK_WINDOW > now) break;
+        link_wait(link, partner);
+    }
+
+    // Without a partner, look for one now and then
+    uint64_t when = (partner == SCHED_NEVER ? now : partner) + LINK_WINDOW;
+    uint64_t due = link_next_due(link, LINK_START);
+    sched_post(&gb->sched, SCHED_LINK, due < when ? due : when);
+}
+
+// The byte the partner shifted out during our transfer ending at `when`:
+// wait for it to get there
+static uint8_t gb_link_reply(GameBoy* gb, uint64_t when) {
+    Link* link = gb->link;
+    uint64_t now = gb->cpu->cycles;
+    for (;;) {
+        uint64_t partner = link_partner_time(link);
+        link_poll(link);
+
+        LinkPending reply;
+        if (link_take(link, LINK_REPLY, when, &reply)) return reply.value;
+        // Unplugged, or it passed the end without our start (it plugged in
+        // during the transfer)
+        if (partner == SCHED_NEVER || partner >= when) return 0xFF;
+
+        gb_link_receive(gb, now);
+        gb_link_publish(gb, partner, now);
+        link_wait(link, partner);
+    }
+}
+
+// Run every event that is due; returns true if the run slice ended
+static bool gb_dispatch_events(GameBoy* gb) {
+    bool stop = false;
+    uint64_t when;
+    int event;
+
+    while ((event = sched_pop_due(&gb->sched, gb->cpu->cycles, &when)) >= 0) {
+        switch (event) {
+            case SCHED_STOP:   stop = true; break;
+            case SCHED_TIMER:  timer_event(gb->timer, when); break;
+            case SCHED_PPU:    ppu_event(gb->ppu, when); break;
+            case SCHED_DMA:    mmu_dma_event(gb->mmu); break;
+            case SCHED_SERIAL:
+                mmu_serial_event(gb->mmu, gb->link ? gb_link_reply(gb, when) : 0xFF);
+                break;
+            case SCHED_LINK:   gb_link_sync(gb); break;
+        }
+    }
+    return stop;
+}
+
+int gb_step(GameBoy* gb) {
+    int cycles = cpu_step(gb->cpu);
+    gb_dispatch_events(gb);
+    return cycles;
+}
+
+uint64_t gb_run_cycles(GameBoy* gb, uint64_t cycles) {
+    CPU* cpu = gb->cpu;
+    uint64_t start = cpu->cycles;
+
+    // The slice end is just another deadline for the CPU to run up to
+    sched_post(&gb->sched, SCHED_STOP, start + cycles);
+    do {
+        cpu_run(cpu, &gb->sched.next);
+    } while (!gb_dispatch_events(gb));
+
+    return cpu->cycles - start;
+}
+
+void gb_run_frame(GameBoy* gb) {
+    // Frames stay aligned to multiples of GB_CYCLES_PER_FRAME
+    uint64_t frame_end = (uint64_t)(gb->frame_count + 1) * GB_CYCLES_PER_FRAME;
+    if (frame_end > gb->cpu->cycles) {
+        gb_run_cycles(gb, frame_end - gb->cpu->cycles);
+    }
+    gb->frame_count++;
+    apu_end_frame(gb->apu, gb->cpu->cycles);
+    if (gb->save) save_frame(gb->save);
+}
+
+AudioRing* gb_audio_open(GameBoy* gb, uint32_t sample_rate) {
+    if (apu_open_output(gb->apu, sample_rate, gb_cycles(gb)) != 0) return NULL;
+    return gb->apu->ring;
+}
+
+void gb_set_frameskip(GameBoy* gb, uint32_t period) {
+    PPU* ppu = gb->ppu;
+    ppu->render_period = period ? period : 1;
+    ppu->render = ppu->frame % ppu->render_period == 0;
+}
+
+int gb_trace_start(GameBoy* gb, const char* path) {
+    gb_trace_stop(gb);
+    gb->cpu->trace = trace_open(path);
+    return gb->cpu->trace ? 0 : -1;
+}
+
+int gb_trace_stop(GameBoy* gb) {
+    int result = trace_close(gb->cpu->trace);
+    gb->cpu->trace = NULL;
+    return result;
+}
+
+void gb_set_idle(GameBoy* gb, CPU_IdleMode mode) {
+    gb->cpu->idle.mode = mode;
+    gb->cpu->idle.verdict = -1;
+}
+
+int gb_idle_overrides(GameBoy* gb, const char* path) {
+    return idle_overrides_apply(&gb->cpu->idle, gb->cart->title, path);
+}
+
+int gb_save_open(GameBoy* gb, const char* path) {
+    MBC* mbc = gb->mmu->mbc;
+    if (gb->save || !mbc->battery || mbc->ram_size + mbc->footer_size == 0) return 0;
+    gb->save = save_open(path, mbc, SAVE_FLUSH_FRAMES);
+    return gb->save ? 0 : -1;
+}
+
+int gb_profile_start(GameBoy* gb) {
+    gb_profile_stop(gb);
+    gb->cpu->profile = profiler_create(gb->mmu);
+    return gb->cpu->profile ? 0 : -1;
+}
+
+int gb_profile_write(GameBoy* gb, const char* prefix) {
+    if (!gb->cpu->profile) return -1;
+    return profiler_write(gb->cpu->profile, prefix);
+}
+
+void gb_profile_stop(GameBoy* gb) {
+    profiler_free(gb->cpu->profile);
+    gb->cpu->profile = NULL;
+}
+
+int gb_link_open(GameBoy* gb, const char* name) {
+    gb_link_close(gb);
+    gb->link = link_open(name);
+    if (!gb->link) return -1;
+    gb->mmu->link = gb->link;
+    link_attach(gb->link, gb->cpu->cycles);
+    gb_link_sync(gb);
+    return 0;
+}
+
+void gb_link_close(GameBoy* gb) {
+    if (!gb->link) return;
+    link_close(gb->link);
+    gb->link = NULL;
+    gb->mmu->link = NULL;
+    sched_cancel(&gb->sched, SCHED_LINK);
+}
+
+void gb_set_buttons(GameBoy* gb, uint8_t buttons) {
+    if (joypad_set_state(gb->joypad, buttons)) {
+        cpu_request_interrupt(gb->cpu, INT_JOYPAD);
+    }
+}
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_ttf.h>
+#include "disassemble.h"
+#include "hud.h"
+
+#define ATLAS_COLUMNS 16
+#define HUD_LINES     (5 + HUD_CODE_LINES)
+#define HUD_COLUMNS   56
+#define HUD_MARGIN    4
+
+static SDL_Rect atlas_cell(Hud* hud, int glyph) {
+    int index = glyph - HUD_FIRST_GLYPH;
+    SDL_Rect cell = {
+        (index % ATLAS_COLUMNS) * hud->cell_width,
+        (index / ATLAS_COLUMNS) * hud->cell_height,
+        hud->cell_width, hud->cell_height,
+    };
+    return cell;
+}
+
+Hud* hud_create(SDL_Renderer* renderer, const char* font_path, int point_size) {
+    if (!TTF_WasInit() && TTF_Init() != 0) return NULL;
+    TTF_Font* font = TTF_OpenFont(font_path, point_size);
+    Hud* hud = font ? calloc(1, sizeof(Hud)) : NULL;
+    if (!hud) {
+        if (font) TTF_CloseFont(font);
+        TTF_Quit();
+        return NULL;
+    }
+    hud->renderer = renderer;
+
+    // Monospace: every glyph advances by the same width
+    int advance = 0;
+    TTF_GlyphMetrics(font, 'M', NULL, NULL, NULL, NULL, &advance);
+    hud->cell_width = advance;
+    hud->cell_height = TTF_FontHeight(font);
+    int glyphs = HUD_SOLID - HUD_FIRST_GLYPH + 1;
+    hud->atlas_width = ATLAS_COLUMNS * hud->cell_width;
+    hud->atlas_height = (glyphs + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS * hud->cell_height;
+
+    // Rasterize once: white glyphs with alpha, tinted per vertex when drawn
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, hud->atlas_width, hud->atlas_height,
+                                                          32, SDL_PIXELFORMAT_ARGB8888);
+    if (surface) {
+        SDL_Color white = { 255, 255, 255, 255 };
+        for (int c = HUD_FIRST_GLYPH; c <= HUD_LAST_GLYPH; c++) {
+            SDL_Surface* glyph = TTF_RenderGlyph_Blended(font, (Uint16)c, white);
+            if (!glyph) continue;
+            SDL_Rect cell = atlas_cell(hud, c);
+            SDL_SetSurfaceBlendMode(glyph, SDL_BLENDMODE_NONE);
+            SDL_SetClipRect(surface, &cell);
+            SDL_BlitSurface(glyph, NULL, surface, &cell);
+            SDL_FreeSurface(glyph);
+        }
+        SDL_SetClipRect(surface, NULL);
+        SDL_Rect solid = atlas_cell(hud, HUD_SOLID);
+        SDL_FillRect(surface, &solid, 0xFFFFFFFF);
+
+        hud->atlas = SDL_CreateTextureFromSurface(renderer, surface);
+        SDL_FreeSurface(surface);
+    }
+    TTF_CloseFont(font);
+
+    if (!hud->atlas) {
+        hud_free(hud);
+        return NULL;
+    }
+    SDL_SetTextureBlendMode(hud->atlas, SDL_BLENDMODE_BLEND);
+    return hud;
+}
+
+void hud_free(Hud* hud) {
+    if (!hud) return;
+    if (hud->atlas) SDL_DestroyTexture(hud->atlas);
+    free(hud->vertices);
+    free(hud->indices);
+    free(hud);
+    TTF_Quit();
+}
+
+// Code bytes at address, without touching I/O or anything else with side
+// effects; -1 where the bytes aren't plain memory
+static int peek(MMU* mmu, uint16_t address) {
+    if (address >= 0xFF80 && address != 0xFFFF) return mmu->memory[address];
+    if (address >= 0xFE00) return -1;
+    const uint8_t* page = mmu->read_page[address >> MMU_PAGE_SHIFT];
+    return page ? page[address & (MMU_PAGE_SIZE - 1)] : -1;
+}
+
+void hud_capture(HudSnapshot* s, GameBoy* gb, float fps) {
+    CPU* cpu = gb->cpu;
+    MMU* mmu = gb->mmu;
+
+    s->af = (cpu->a << 8) | cpu_get_f(cpu);
+    s->bc = cpu_get_bc(cpu);
+    s->de = cpu_get_de(cpu);
+    s->hl = cpu_get_hl(cpu);
+    s->sp = cpu->sp;
+    s->pc = cpu->pc;
+    s->ime = cpu->ime;
+    s->halted = cpu->halted;
+    s->ly = gb->ppu->ly;
+    s->lcdc = gb->ppu->lcdc;
+    s->stat = gb->ppu->stat;
+    s->ie = mmu->memory[0xFFFF];
+    s->iflag = mmu->memory[0xFF0F];
+    s->frame = gb->frame_count;
+    s->cycles = cpu->cycles;
+    s->fps = fps;
+
+    s->code_avail = 0;
+    while (s->code_avail < HUD_CODE_BYTES) {
+        int byte = peek(mmu, (uint16_t)(cpu->pc + s->code_avail));
+        if (byte < 0) break;
+        s->code[s->code_avail++] = (uint8_t)byte;
+    }
+}
+
+// Room for quads more quads; the index pattern never changes
+static bool reserve(Hud* hud, int quads) {
+    if (hud->quads + quads <= hud->capacity) return true;
+    int capacity = hud->capacity ? hud->capacity * 2 : 1024;
+    while (capacity < hud->quads + quads) capacity *= 2;
+
+    SDL_Vertex* vertices = realloc(hud->vertices, capacity * 4 * sizeof(SDL_Vertex));
+    if (!vertices) return false;
+    hud->vertices = vertices;
+    int* indices = realloc(hud->indices, capacity * 6 * sizeof(int));
+    if (!indices) return false;
+    hud->indices = indices;
+
+    for (int q = hud->capacity; q < capacity; q++) {
+        static const int corners[6] = { 0, 1, 2, 2, 1, 3 };
+        for (int k = 0; k < 6; k++) indices[q * 6 + k] = q * 4 + corners[k];
+    }
+    hud->capacity = capacity;
+    return true;
+}
+
+// One textured quad; u0..v1 in atlas texels
+static void quad(Hud* hud, float x, float y, float w, float h,
+                 float u0, float v0, float u1, float v1, SDL_Color color) {
+    SDL_Vertex* v = &hud->vertices[hud->quads++ * 4];
+    float aw = hud->atlas_width, ah = hud->atlas_height;
+    v[0] = (SDL_Vertex){ { x, y }, color, { u0 / aw, v0 / ah } };
+    v[1] = (SDL_Vertex){ { x + w, y }, color, { u1 / aw, v0 / ah } };
+    v[2] = (SDL_Vertex){ { x, y + h }, color, { u0 / aw, v1 / ah } };
+    v[3] = (SDL_Vertex){ { x + w, y + h }, color, { u1 / aw, v1 / ah } };
+}
+
+// Panels sample the middle of the solid cell, so filtering never picks up a glyph
+static void panel(Hud* hud, float x, float y, float w, float h, SDL_Color color) {
+    if (!reserve(hud, 1)) return;
+    SDL_Rect cell = atlas_cell(hud, HUD_SOLID);
+    float u = cell.x + cell.w / 2.0f, v = cell.y + cell.h / 2.0f;
+    quad(hud, x, y, w, h, u, v, u, v, color);
+}
+
+static void text(Hud* hud, float x, float y, const char* string, SDL_Color color) {
+    size_t length = strlen(string);
+    if (!reserve(hud, (int)length)) return;
+    for (size_t i = 0; i < length; i++, x += hud->cell_width) {
+        int c = (unsigned char)string[i];
+        if (c <= HUD_FIRST_GLYPH || c > HUD_LAST_GLYPH) continue;    // Spaces draw nothing
+        SDL_Rect cell = atlas_cell(hud, c);
+        quad(hud, x, y, cell.w, cell.h, cell.x, cell.y, cell.x + cell.w, cell.y + cell.h, color);
+    }
+}
+
+void hud_draw(Hud* hud, const HudSnapshot* s, float present_fps) {
+    char lines[HUD_LINES][HUD_COLUMNS + 1];
+    int count = 0;
+
+    snprintf(lines[count++], sizeof(lines[0]), "%5.1f fps  %5.1f present", s->fps, present_fps);
+    snprintf(lines[count++], sizeof(lines[0]), "AF %04X  BC %04X  %c%c%c%c %s%s",
+             s->af, s->bc,
+             (s->af & FLAG_Z) ? 'Z' : '-', (s->af & FLAG_N) ? 'N' : '-',
+             (s->af & FLAG_H) ? 'H' : '-', (s->af & FLAG_C) ? 'C' : '-',
+             s->ime ? "IME" : "", s->halted ? " HALT" : "");
+    snprintf(lines[count++], sizeof(lines[0]), "DE %04X  HL %04X  IE %02X IF %02X", s->de, s->hl, s->ie, s->iflag);
+    snprintf(lines[count++], sizeof(lines[0]), "SP %04X  PC %04X  LY %3u LCDC %02X", s->sp, s->pc, s->ly, s->lcdc);
+    snprintf(lines[count++], sizeof(lines[0]), "frame %u  cycle %llu", s->frame, (unsigned long long)s->cycles);
+
+    // Disassembly from PC, as far as the captured bytes go
+    int offset = 0;
+    int code_start = count;
+    for (int i = 0; i < HUD_CODE_LINES && offset < s->code_avail; i++) {
+        char instruction[D_ASM_TEXT_SIZE];
+        uint16_t pc = s->pc + offset;
+        offset += d_asm_format(s->code + offset, s->code_avail - offset, pc,
+                               instruction, sizeof(instruction), NULL, NULL);
+        snprintf(lines[count++], sizeof(lines[0]), "%c%04X  %s", i == 0 ? '>' : ' ', pc, instruction);
+    }
+
+    int columns = 0;
+    for (int i = 0; i < count; i++) {
+        int length = (int)strlen(lines[i]);
+        if (length > columns) columns = length;
+    }
+
+    hud->quads = 0;
+    SDL_Color shade = { 0, 0, 0, 176 };
+    SDL_Color label = { 255, 255, 255, 255 };
+    SDL_Color code = { 160, 224, 160, 255 };
+    SDL_Color current = { 255, 224, 96, 255 };
+    panel(hud, HUD_MARGIN, HUD_MARGIN, columns * hud->cell_width + 2 * HUD_MARGIN,
+          count * hud->cell_height + 2 * HUD_MARGIN, shade);
+    for (int i = 0; i < count; i++) {
+        SDL_Color color = i < code_start ? label : i == code_start ? current : code;
+        text(hud, 2 * HUD_MARGIN, 2 * HUD_MARGIN + i * hud->cell_height, lines[i], color);
+    }
+
+    SDL_RenderGeometry(hud->renderer, hud->atlas, hud->vertices, hud->quads * 4,
+                       hud->indices, hud->quads * 6);
+}
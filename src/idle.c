@@ -0,0 +1,56 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "idle.h"
+
+int idle_mode_parse(const char* name) {
+    if (strcmp(name, "off") == 0) return CPU_IDLE_OFF;
+    if (strcmp(name, "halt") == 0) return CPU_IDLE_HALT;
+    if (strcmp(name, "full") == 0) return CPU_IDLE_FULL;
+    return -1;
+}
+
+// Parse one line; returns 1 if it names title and was applied, 0 for a
+// comment or another title, -1 if malformed
+static int idle_apply_line(CPU_Idle* idle, const char* title, char* line) {
+    char* p = line;
+    while (isspace((unsigned char)*p)) p++;
+    if (*p == '\0' || *p == '#') return 0;
+    if (*p != '"') return -1;
+
+    char* name = ++p;
+    char* close = strchr(name, '"');
+    if (!close) return -1;
+    *close = '\0';
+
+    char* mode = strtok(close + 1, " \t\r\n");
+    int parsed = mode ? idle_mode_parse(mode) : -1;
+    if (parsed < 0) return -1;
+    if (strcmp(name, title) != 0) return 0;
+
+    idle->mode = parsed;
+    idle->ignore_count = 0;
+    char* head;
+    while ((head = strtok(NULL, " \t\r\n")) && *head != '#') {
+        char* end;
+        unsigned long pc = strtoul(head, &end, 16);
+        if (*end != '\0' || pc > 0xFFFF) return -1;
+        if (idle->ignore_count < CPU_IDLE_MAX_IGNORE) idle->ignore[idle->ignore_count++] = pc;
+    }
+    idle->verdict = -1;
+    return 1;
+}
+
+int idle_overrides_apply(CPU_Idle* idle, const char* title, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+
+    char line[256];
+    int result = 0;
+    while (result == 0 && fgets(line, sizeof(line), f)) {
+        result = idle_apply_line(idle, title, line);
+    }
+    fclose(f);
+    return result;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "audio_ring.h"
+#include "blip.h"
+
+// Audio. Nothing is stepped per CPU cycle: the APU catches up to the
+// master clock whenever a sound register is touched and at the end of every
+// frame, walking each channel from one waveform edge to the next and adding
+// level changes to band-limited delta buffers. The frame's samples are then
+// read out at the output rate and handed to the audio ring.
+//
+// Without an output the channels still keep length/sweep/envelope state
+// (NR52 stays exact) but waveform edges are skipped arithmetically.
+
+#define APU_SAMPLE_RATE     48000
+#define APU_SEQUENCER_CYCLES 8192       // 512 Hz frame sequencer
+#define APU_FLUSH_CYCLES    70224       // Read out samples at least this often
+#define APU_RING_FRAMES     8192        // ~170 ms at 48 kHz
+#define APU_GAIN            48          // Output units per DAC step per volume step
+
+// One sound channel. Square channels use duty/phase (and sweep on channel 1),
+// the wave channel phase/volume shift, the noise channel the LFSR.
+typedef struct {
+    bool enabled;           // NR52 status bit
+    bool dac;               // NRx2 & 0xF8, NR30 bit 7
+    bool length_enabled;
+    uint16_t length;        // Length ticks left
+    uint16_t frequency;     // 11-bit period value (squares, wave)
+
+    uint8_t volume;         // Envelope level 0-15 (wave: output shift)
+    uint8_t env_period;
+    uint8_t env_timer;
+    bool env_up;
+
+    uint8_t duty;
+    uint8_t phase;          // Square step 0-7, wave sample 0-31
+    uint16_t lfsr;
+
+    // Channel 1 sweep
+    bool sweep_enabled;
+    uint8_t sweep_timer;
+    uint16_t shadow;
+
+    uint64_t next;          // Master cycle of the next waveform step
+    int output[2];          // Level currently in the right/left buffers
+} APU_Channel;
+
+typedef struct APU {
+    APU_Channel ch[4];
+    uint8_t regs[0x30];     // 0xFF10-0xFF3F as written (wave RAM at 0x20)
+    bool power;             // NR52 bit 7
+
+    uint64_t time;          // Master cycle the channels are caught up to
+    uint64_t sequencer_next;
+    uint8_t sequencer_step;
+
+    // Output, NULL/unused until apu_open_output
+    AudioRing* ring;
+    Blip blip[2];           // Right, left (NR51/NR50 bit order)
+    uint64_t frame_start;   // Master cycle at blip time 0
+    int16_t* staging;       // One frame of interleaved samples
+} APU;
+
+// Public interface
+APU* apu_create(void);
+void apu_init(APU* apu);
+void apu_free(APU* apu);
+
+// Start producing samples at sample_rate into apu->ring. Returns 0 or -1.
+int apu_open_output(APU* apu, uint32_t sample_rate, uint64_t now);
+
+// After a state load moved apu->time: drop pending output and restart the
+// sample stream from the loaded levels
+void apu_restart_output(APU* apu);
+
+// Register access (0xFF10-0xFF3F)
+uint8_t apu_read(APU* apu, uint16_t address, uint64_t now);
+void apu_write(APU* apu, uint16_t address, uint8_t value, uint64_t now);
+
+// Catch up to now and push the finished samples (called once per frame)
+void apu_end_frame(APU* apu, uint64_t now);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Single-producer/single-consumer ring of interleaved stereo int16 frames.
+// The emulation thread writes a frame's worth at a time; the audio device
+// callback reads. Neither side ever blocks: a full ring drops the newest
+// frames, an empty one leaves the rest of the request to the caller.
+
+typedef struct AudioRing {
+    int16_t* samples;       // 2 per frame (left, right)
+    uint32_t size;          // Frames, power of two
+    _Atomic uint64_t head;  // Next frame to write (producer)
+    _Atomic uint64_t tail;  // Next frame to read (consumer)
+    uint64_t dropped;       // Frames lost to a full ring (producer side)
+} AudioRing;
+
+AudioRing* audio_ring_create(uint32_t frames);     // Rounded up to a power of two
+void audio_ring_free(AudioRing* ring);
+
+// Both return the number of frames actually moved
+uint32_t audio_ring_write(AudioRing* ring, const int16_t* frames, uint32_t count);
+uint32_t audio_ring_read(AudioRing* ring, int16_t* frames, uint32_t count);
+
+// Frames waiting to be read
+uint32_t audio_ring_fill(AudioRing* ring);
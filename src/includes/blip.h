@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+// Band-limited step synthesis. Level changes are added as deltas at their
+// exact clock time; each delta is spread over BLIP_TAPS output samples with
+// a windowed-sinc step picked by the sub-sample phase. Reading integrates
+// the deltas back into samples and removes DC with a gentle high-pass.
+
+#define BLIP_PHASE_BITS  5                      // 32 sub-sample positions
+#define BLIP_PHASES      (1 << BLIP_PHASE_BITS)
+#define BLIP_TAPS        16
+#define BLIP_UNIT_BITS   14                     // Kernel fixed point
+#define BLIP_BASS_SHIFT  9                      // High-pass: ~15 Hz at 48 kHz
+
+typedef struct Blip {
+    uint64_t factor;        // Output samples per input clock, 32.32 fixed point
+    uint64_t offset;        // Start of the current frame in the buffer, 32.32
+    int32_t integrator;
+    int32_t* buffer;        // Deltas, BLIP_TAPS of slack past size
+    uint32_t size;          // Samples the buffer can hold per frame
+} Blip;
+
+// Step kernels per phase, each row sums to 1 << BLIP_UNIT_BITS
+extern int16_t blip_kernel[BLIP_PHASES][BLIP_TAPS];
+
+// size: the most samples a frame can produce before it is read out
+int blip_init(Blip* blip, uint32_t clock_rate, uint32_t sample_rate, uint32_t size);
+void blip_free(Blip* blip);
+void blip_clear(Blip* blip);
+
+// time is in clocks since the start of the current frame
+static inline void blip_add_delta(Blip* blip, uint32_t time, int delta) {
+    uint64_t position = blip->offset + time * blip->factor;
+    int32_t* out = blip->buffer + (position >> 32);
+    const int16_t* kernel = blip_kernel[(position >> (32 - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1)];
+    for (int i = 0; i < BLIP_TAPS; i++) {
+        out[i] += delta * kernel[i];
+    }
+}
+
+// Ends the frame at clocks; its samples become readable
+void blip_end_frame(Blip* blip, uint32_t clocks);
+static inline uint32_t blip_samples_avail(const Blip* blip) { return blip->offset >> 32; }
+
+// Reads up to count samples to out[0], out[stride], ...; returns the number read
+uint32_t blip_read_samples(Blip* blip, int16_t* out, uint32_t count, int stride);
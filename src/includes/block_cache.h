@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cpu.h"
+#include "mmu.h"
+
+// Predecoded basic blocks keyed by the host address of their first opcode,
+// so each ROM bank gets its own blocks and bank switches need no flush.
+
+#define BLOCK_HASH_BITS  12
+#define BLOCK_MAX_OPS    32             // Instructions per block
+#define BLOCK_POOL       8192           // Blocks before a full flush
+#define BLOCK_OP_POOL    (BLOCK_POOL * 8)
+#define BLOCK_CALLS      16             // Return predictions kept, a power of two
+
+// How a block's last op leaves it
+enum {
+    BLOCK_PLAIN,
+    BLOCK_CALL,             // CALL or RST
+    BLOCK_RET,              // RET or RETI
+    BLOCK_STOP,             // HALT or EI: the interpreter takes over
+};
+
+typedef struct {
+    CPU_OpFunc handler;
+    uint16_t operand;       // Immediate, already fetched
+    uint8_t length;
+    uint8_t cycles;         // Base cycles; the handler returns branch extras
+} BlockOp;
+
+typedef struct {
+    const uint8_t* code;    // Host address of the first opcode, NULL once invalidated
+    uint16_t pc;
+    uint16_t last;          // Address of the last op
+    uint16_t end;           // pc after the last op (the fall-through)
+    uint16_t count;         // Number of ops
+    uint8_t kind;           // BLOCK_PLAIN etc.
+    uint32_t ops;           // First op in BlockCache::ops
+    int32_t next;           // Hash chain, -1 terminates
+    int32_t page_next;      // Blocks on the same RAM page, -1 terminates
+
+    // Blocks run next after falling through and after the other exit, -1
+    // if not seen yet; only valid while mmu->code_gen equals exit_gen
+    int32_t exit[2];
+    uint32_t exit_gen;
+} Block;
+
+typedef struct BlockCache {
+    MMU* mmu;
+    int32_t buckets[1 << BLOCK_HASH_BITS];
+    Block blocks[BLOCK_POOL];
+    uint32_t block_count;
+    BlockOp ops[BLOCK_OP_POOL];
+    uint32_t op_count;
+
+    // Blocks that left through a call, most recent last, so a RET can use
+    // its caller's fall-through link
+    int32_t calls[BLOCK_CALLS];
+    uint32_t call_top;
+
+    // RAM holding cached code: one bit per byte, the protected pages, and
+    // the blocks on each of them, so a code write only visits those
+    uint8_t code_bits[0x10000 / 8];
+    bool protected_page[MMU_PAGE_COUNT];
+    int32_t page_blocks[MMU_PAGE_COUNT];    // -1 if none
+
+    // Statistics
+    uint64_t builds;
+    uint64_t flushes;
+    uint64_t invalidations;
+} BlockCache;
+
+BlockCache* block_cache_create(MMU* mmu);
+void block_cache_free(BlockCache* cache);
+void block_cache_flush(BlockCache* cache);      // Drop every block
+
+// Copies ops into the cache; the block's bytes lie within size bytes from
+// address from, on pc's page
+Block* block_cache_insert(BlockCache* cache, const uint8_t* code, uint16_t pc, uint16_t from,
+                          int size, const BlockOp* ops, int count);
+
+// Drop the blocks on the page if address holds cached code
+void block_cache_invalidate(BlockCache* cache, uint16_t address);
+
+static inline uint32_t block_hash(const uint8_t* code) {
+    return (uint32_t)(((uintptr_t)code * 0x9E3779B97F4A7C15ULL) >> (64 - BLOCK_HASH_BITS));
+}
+
+static inline Block* block_cache_find(BlockCache* cache, const uint8_t* code, uint16_t pc) {
+    for (int32_t i = cache->buckets[block_hash(code)]; i >= 0; i = cache->blocks[i].next) {
+        Block* block = &cache->blocks[i];
+        if (block->code == code && block->pc == pc) return block;
+    }
+    return NULL;
+}
+
+// Write to a protected RAM page (address already folded out of echo RAM)
+static inline void block_cache_write(BlockCache* cache, uint16_t address) {
+    if (cache->code_bits[address >> 3] & (1 << (address & 7))) {
+        block_cache_invalidate(cache, address);
+    }
+}
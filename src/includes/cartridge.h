@@ -1,16 +1,26 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include "rom_cache.h"
+
+// load_rom error codes (the first three match rom_cache_acquire)
+#define CART_OK             ROM_OK
+#define CART_ERR_OPEN       ROM_ERR_OPEN    // ROM file missing or unreadable
+#define CART_ERR_MAP        ROM_ERR_MAP     // mmap failed or file is empty
+#define CART_ERR_NOMEM      ROM_ERR_NOMEM
+#define CART_ERR_TOO_SMALL  -4              // No complete header (0x100-0x14F)
 
 typedef struct {
-    uint8_t* data;          // Raw rom data
+    const uint8_t* data;    // Raw rom data (shared read-only mapping)
     size_t size;            // Rom file size
+    RomImage* image;        // Owning reference into the ROM cache
 
     // Cartridge header info (0x100-0x14F)
     uint8_t entry[4];           // 0x100-0x103: entry point
     uint8_t logo[0x30];         // 0x104-0x133: nintendo logo
-    char title[16];             // 0x134-0x143: Title
+    char title[17];             // 0x134-0x143: Title, NUL terminated
     uint16_t new_licensee;      // 0x144-0x145
     uint8_t sgb_flag;           // 0x146
     uint8_t cartridge_type;     // 0x147: MBC type + RAM + Battery
@@ -20,10 +30,24 @@ typedef struct {
     uint8_t old_licensee;       // 0x14B
     uint8_t version;            // 0x14C: ROM version
     uint8_t header_checksum;    // 0x14D
-    uint16_t global_checksum;   // 0x14E-0x14F
+    uint16_t global_checksum;   // 0x14E-0x14F (big-endian in the ROM)
+
+    // Verification (the boot ROM only checks the logo and header checksum)
+    bool logo_ok;
+    bool header_ok;
 } Cartridge;
 
-Cartridge* load_rom(char *file);
-void parse_gb_header(Cartridge* cart);
+// Logo bitmap every licensed header carries at 0x104
+extern const uint8_t nintendo_logo[0x30];
+
+int load_rom(const char *file, Cartridge** cart);
+void parse_gb_header(Cartridge* cart);  // cart->data must hold 0x150 bytes
 void print_header(Cartridge* cart);
 void cartridge_free(Cartridge* cart);
+
+// 0x14D: computed over 0x134-0x14C
+uint8_t cart_header_checksum(const uint8_t* data);
+
+// 0x14E-0x14F: 16-bit sum of every byte in the file except those two.
+// Not checked by hardware; a mismatch usually means a bad dump or a hack.
+uint16_t cart_global_checksum(const uint8_t* data, size_t size);
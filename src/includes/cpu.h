@@ -4,80 +4,182 @@
 #include <stdint.h>
 #include "mmu.h"
 
+typedef struct Tracer Tracer;
+typedef struct Profiler Profiler;
+
+// Execution strategy, switchable at runtime
+typedef enum {
+    CPU_MODE_INTERPRETER = 0,   // Fetch/decode every instruction
+    CPU_MODE_CACHED = 1         // Replay predecoded basic blocks
+} CPU_Mode;
+
+// Idle skipping: HALT and side-effect-free poll loops jump the master clock
+// to the next scheduled event. Both are exact; nothing a guest can observe
+// changes between events.
+typedef enum {
+    CPU_IDLE_OFF = 0,       // Step through everything
+    CPU_IDLE_HALT = 1,      // Skip HALT only
+    CPU_IDLE_FULL = 2       // Skip HALT and poll loops
+} CPU_IdleMode;
+
+#define CPU_IDLE_MAX_BYTES   16     // Longest poll loop body
+#define CPU_IDLE_MAX_IGNORE  8
+
+typedef struct {
+    CPU_IdleMode mode;
+    uint16_t ignore[CPU_IDLE_MAX_IGNORE];   // Loop heads never skipped (per-title overrides)
+    int ignore_count;
+
+    // Last candidate loop and its verdict
+    uint16_t head, tail;    // First instruction, backward branch
+    uint32_t gen;           // mmu->code_gen the verdict was made under
+    uint16_t bc, de, hl;    // Pointers the memory operands were resolved with
+    int8_t verdict;         // -1 unchecked, 0 not idle, 1 idle
+    uint8_t count;          // Instructions per iteration
+    uint16_t iteration;     // Cycles per iteration
+
+    // State when the last iteration started; an identical one after a
+    // whole iteration is a fixed point
+    bool armed;
+    uint8_t a, f;
+    uint64_t cycles;
+    uint64_t instructions;
+
+    uint64_t skipped;       // Cycles fast-forwarded
+} CPU_Idle;
+
+// Register pair: the two 8-bit halves overlay the 16-bit value, so BC/DE/HL
+// reads and writes are single loads and stores
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define CPU_PAIR(hi, lo) union { struct { uint8_t hi, lo; }; uint16_t hi##lo; }
+#else
+#define CPU_PAIR(hi, lo) union { struct { uint8_t lo, hi; }; uint16_t hi##lo; }
+#endif
+
+// Flags are evaluated lazily. An ALU instruction stores what it already has
+// at hand (result, operand XOR result, wide result) instead of working out
+// each flag; a flag is decoded when something tests it and F is assembled
+// only for PUSH AF, DAA, snapshots and traces (cpu_get_f).
+typedef struct {
+    uint8_t z;      // Z set when this is 0 (the result)
+    uint8_t n;      // N set when nonzero
+    uint16_t h;     // H is bit 4 (operand ^ operand ^ result)
+    uint16_t c;     // C is bit 8 (the unwrapped result)
+} CPU_Flags;
+
 typedef struct CPU{
     // Registers
-    uint8_t a, f;   // Accumulator & Flags
-    uint8_t b, c;
-    uint8_t d, e;
-    uint8_t h, l;
+    uint8_t a;      // Accumulator
+    CPU_Flags flags;
+    CPU_PAIR(b, c);
+    CPU_PAIR(d, e);
+    CPU_PAIR(h, l);
     
     // 16bit Registers
     uint16_t pc;    // Program Counter
     uint16_t sp;    // Stack Pointer
 
     // CPU state 
-    bool ime;       // Interrupt Master Enable
+    bool ime;           // Interrupt Master Enable
+    bool ime_scheduled; // EI takes effect after the next instruction
     bool halted;
-    int cycles;     // Total cycles executed
+    bool halt_bug;      // HALT with IME=0 and pending IRQ: next PC increment is skipped
+    uint64_t cycles;    // Master clock: total cycles executed
+    uint64_t instructions;  // Instructions retired
 
     // Current MMU for memory access
     MMU* mmu;
+
+    // Block cache, NULL in interpreter mode
+    BlockCache* blocks;
+
+    // Instruction trace, NULL when off
+    Tracer* trace;
+
+    // Per-PC profile, NULL when off
+    Profiler* profile;
+
+    // HALT / poll loop fast-forward
+    CPU_Idle idle;
 } CPU;
 
+// Opcode handler: operand holds the immediate (n/nn/e, or the CB opcode)
+// already fetched by the dispatcher. Returns extra cycles on top of the
+// static cycle table (taken branches only).
+typedef int (*CPU_OpFunc)(CPU* cpu, uint16_t operand);
+
 // Flags
 #define FLAG_Z 0x80  // Zero
 #define FLAG_N 0x40  // Subtract
 #define FLAG_H 0x20  // Half Carry
 #define FLAG_C 0x10  // Carry
 
+// Interrupt bits (IE 0xFFFF / IF 0xFF0F)
+#define INT_VBLANK  0x01
+#define INT_STAT    0x02
+#define INT_TIMER   0x04
+#define INT_SERIAL  0x08
+#define INT_JOYPAD  0x10
+
 // CPU functions
 CPU* cpu_create(void);
 void cpu_init(CPU* cpu, MMU* mmu);
 void cpu_free(CPU* cpu);
+int cpu_set_mode(CPU* cpu, CPU_Mode mode);  // 0, or -1 if out of memory
 
 // Execute one instruction
 int cpu_step(CPU* cpu);   // Execute on instruction
+
+// Execute until the master clock reaches *deadline. The deadline is
+// re-read after every instruction, so I/O writes may move it.
+void cpu_run(CPU* cpu, const uint64_t* deadline);
 void cpu_request_interrupt(CPU* cpu, uint8_t interrupt);
 
 // Flag helpers
+static inline uint8_t cpu_get_f(const CPU* cpu) {
+    return (cpu->flags.z ? 0 : FLAG_Z) | (cpu->flags.n ? FLAG_N : 0) |
+           ((cpu->flags.h & 0x10) << 1) | ((cpu->flags.c & 0x100) >> 4);
+}
+
+static inline void cpu_set_f(CPU* cpu, uint8_t f) {
+    cpu->flags.z = !(f & FLAG_Z);
+    cpu->flags.n = f & FLAG_N;
+    cpu->flags.h = (f & FLAG_H) >> 1;
+    cpu->flags.c = (f & FLAG_C) << 4;
+}
+
 static inline bool cpu_get_flag(CPU* cpu, uint8_t flag)
 {
-    return (cpu->f & flag) != 0;
+    return (cpu_get_f(cpu) & flag) != 0;
 }
 
 static inline void cpu_set_flag(CPU* cpu, uint8_t flag, bool value) {
-    if (value) {
-        cpu->f |= flag;
-    } else {
-        cpu->f &= ~flag;
-    }
+    uint8_t f = cpu_get_f(cpu);
+    cpu_set_f(cpu, value ? f | flag : f & ~flag);
 }
 
 // 16-bit register helpers
 static inline uint16_t cpu_get_bc(CPU* cpu) {
-    return (cpu->b << 8) | cpu->c;
+    return cpu->bc;
 }
 
 static inline void cpu_set_bc(CPU* cpu, uint16_t value) {
-    cpu->b = value >> 8;
-    cpu->c = value & 0xFF;
+    cpu->bc = value;
 }
 
 // Same for DE, HL
 static inline uint16_t cpu_get_de(CPU* cpu) {
-    return (cpu->d << 8) | cpu->e;
+    return cpu->de;
 }
 
 static inline void cpu_set_de(CPU* cpu, uint16_t value) {
-    cpu->d = value >> 8;
-    cpu->e = value & 0xFF;
+    cpu->de = value;
 }
 
 static inline uint16_t cpu_get_hl(CPU* cpu) {
-    return (cpu->h << 8) | cpu->l;
+    return cpu->hl;
 }
 
 static inline void cpu_set_hl(CPU* cpu, uint16_t value) {
-    cpu->h = value >> 8;
-    cpu->l = value & 0xFF;
+    cpu->hl = value;
 }
@@ -1,6 +1,63 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
-#include "cpu.h"
+#include <stdio.h>
 
-void d_asm_opcode(uint8_t opcode);
+// Longest formatted instruction, including the terminator
+#define D_ASM_TEXT_SIZE 48
+
+// Resolves a code address to a label, or NULL to print it as $XXXX
+typedef const char* (*DAsmSymbolFunc)(void* ctx, uint16_t address);
+
+// Instruction length in bytes (opcode + immediates)
+int d_asm_length(uint8_t opcode);
+
+// Format the instruction at code[0] (located at pc) into buf, e.g.
+// "LD A, $05" or "JR NZ, loc_00_0160". avail is the number of readable
+// bytes; a truncated instruction is formatted as DB. Returns the length.
+int d_asm_format(const uint8_t* code, size_t avail, uint16_t pc, char* buf, size_t size,
+                 DAsmSymbolFunc symbol, void* ctx);
+
+// Whole-ROM disassembly: recursive-descent code discovery from the entry
+// point, RST/interrupt vectors and jump tables, across all banks.
+
+#define D_ASM_BANK_SIZE 0x4000
+
+// Per ROM byte flags
+#define D_ASM_CODE         0x01    // Part of a decoded instruction
+#define D_ASM_START        0x02    // First byte of an instruction
+#define D_ASM_JUMP         0x04    // Jump/branch target
+#define D_ASM_CALL         0x08    // Call/RST target
+#define D_ASM_TABLE        0x10    // Jump table entry
+#define D_ASM_TABLE_START  0x20
+
+typedef struct {
+    uint32_t offset;        // ROM offset to decode from
+    int16_t bank;           // Bank believed mapped at 0x4000 (-1 unknown)
+} DAsmWork;
+
+typedef struct {
+    const uint8_t* rom;
+    size_t size;
+    uint32_t banks;
+    uint8_t* flags;         // One per ROM byte
+
+    DAsmWork* work;
+    size_t work_count;
+    size_t work_cap;
+    int8_t rst_table[8];    // Per RST vector: 1 = jump table dispatcher, -1 unknown
+
+    // Statistics
+    size_t instructions;
+    size_t code_bytes;
+    size_t labels;
+    size_t tables;
+    size_t unresolved;      // Switchable-bank targets with an unknown bank
+} DAsmRom;
+
+DAsmRom* d_asm_rom_create(const uint8_t* rom, size_t size);
+void d_asm_rom_free(DAsmRom* dasm);
+int d_asm_rom_analyze(DAsmRom* dasm);     // 0, or -1 if out of memory
+void d_asm_rom_list(DAsmRom* dasm, FILE* out);
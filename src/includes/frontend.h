@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "gameboy.h"
+#include "movie.h"
+
+// SDL window frontend (frontend.c, hud.c). Not part of libgameboy; only
+// build/gameboy links SDL.
+
+#define FRONTEND_FPS  (GB_CLOCK_HZ / (double)GB_CYCLES_PER_FRAME)    // ~59.73
+
+typedef struct {
+    double speed;           // Multiple of real time, 0 = unlimited (no throttling)
+    uint32_t frameskip;     // Draw and present every frameskip-th frame (1 = all)
+    int scale;              // Window size in multiples of 160x144
+    long frames;            // Stop after this many frames, 0 = until closed
+    bool audio;             // Play sound (only at speed 1)
+    bool rewind;            // Record history; hold R to play it backwards
+    Movie* movie;           // Append every frame's buttons, NULL for none
+    bool hud;               // Start with the debug overlay shown (F1 toggles)
+} FrontendOptions;
+
+// Runs gb in a window until it is closed (Esc) or options->frames have run.
+// Returns 0, or -1 if SDL could not be set up.
+int frontend_run(GameBoy* gb, const FrontendOptions* options);
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "apu.h"
+#include "cartridge.h"
+#include "cpu.h"
+#include "joypad.h"
+#include "link.h"
+#include "mmu.h"
+#include "ppu.h"
+#include "save.h"
+#include "scheduler.h"
+#include "serial.h"
+#include "timer.h"
+
+#define GB_CLOCK_HZ          4194304   // DMG master clock
+#define GB_CYCLES_PER_FRAME  70224     // 154 lines * 456 cycles
+
+// Error codes returned through gb_create's error out-parameter
+typedef enum {
+    GB_OK = 0,
+    GB_ERR_ROM = -1,            // ROM could not be opened or mapped
+    GB_ERR_CARTRIDGE = -2,      // Cartridge type not supported
+    GB_ERR_NOMEM = -3,
+    GB_ERR_ROM_INVALID = -4,    // ROM too small to hold a header
+} GB_Error;
+
+// One emulator instance. Everything an instance touches lives here, so any
+// number of them can run side by side in one process.
+typedef struct GameBoy {
+    // Core components
+    Cartridge* cart;
+    MMU* mmu;
+    CPU* cpu;
+    Timer* timer;
+    PPU* ppu;
+    APU* apu;
+    Joypad* joypad;
+    Serial* serial;
+
+    // Event deadlines on the master clock (CPU::cycles)
+    Scheduler sched;
+
+    // Battery RAM file, NULL when not persisted
+    SaveFile* save;
+
+    // Link cable, NULL when there is none
+    Link* link;
+
+    // System state
+    uint32_t frame_count;
+
+    // Snapshot header and MBC registers, staged by gb_state_sections
+    uint8_t* state_stage;
+} GameBoy;
+
+// Lifecycle
+GameBoy* gb_create(const char* rom_path, int* error);
+void gb_destroy(GameBoy* gb);
+const char* gb_error_string(int error);
+
+// Execution
+static inline uint64_t gb_cycles(GameBoy* gb) { return gb->cpu->cycles; }
+int gb_step(GameBoy* gb);                               // Single instruction, returns cycles
+uint64_t gb_run_cycles(GameBoy* gb, uint64_t cycles);   // Returns cycles actually executed
+void gb_run_frame(GameBoy* gb);                         // Runs to the next frame boundary
+
+// Video: PPU_WIDTH x PPU_HEIGHT ARGB8888, rows top to bottom. The
+// framebuffer is the frame being drawn: gb_run_frame ends on fixed cycle
+// counts from power-on, and once the game has turned the LCD off and on
+// that is mid-picture. gb_picture is the last frame finished at VBlank.
+static inline const uint32_t* gb_framebuffer(GameBoy* gb) { return gb->ppu->framebuffer; }
+static inline const uint32_t* gb_picture(GameBoy* gb) { return gb->ppu->picture; }
+
+// Frame skipping: draw only every period-th frame (1 = all). Skipped frames
+// keep LY/STAT/interrupt timing; frames_drawn changes whenever gb_picture
+// holds a new picture.
+void gb_set_frameskip(GameBoy* gb, uint32_t period);
+static inline uint32_t gb_frames_drawn(GameBoy* gb) { return gb->ppu->frames_drawn; }
+
+// Audio: start generating stereo samples at sample_rate (APU_SAMPLE_RATE
+// for SDL). Returns the ring to drain from the audio thread, NULL on failure.
+AudioRing* gb_audio_open(GameBoy* gb, uint32_t sample_rate);
+
+// Snapshots (state.c): a flat image of everything that changes while running,
+// gb_state_size bytes. The layout follows this build's structs, so snapshots
+// are for in-process use (rewind, replays), not files shared across builds.
+int gb_state_init(GameBoy* gb);                        // Called by gb_create
+size_t gb_state_size(GameBoy* gb);
+void gb_state_save(GameBoy* gb, uint8_t* out);
+void gb_state_load(GameBoy* gb, const uint8_t* in);
+
+// The same image as its pieces in layout order, without copying the address
+// space or cart RAM: those sections point at the live arrays and stay valid
+// until the machine runs again. Every section is whole 64-bit words.
+#define GB_STATE_SECTIONS 4
+typedef struct {
+    const uint64_t* words;
+    size_t count;
+} GB_StateSection;
+void gb_state_sections(GameBoy* gb, GB_StateSection sections[GB_STATE_SECTIONS]);
+
+// 64-bit hash of the picture and the guest-visible machine state (CPU,
+// address space, cart RAM, timer/PPU registers). Equal for any CPU or idle
+// mode at the same frame, so it can be compared across builds (gbreplay).
+uint64_t gb_state_hash(GameBoy* gb);
+
+// Binary instruction trace (see trace.h); both return 0 or -1. Stopping
+// fails if any record could not be written, and the file is then truncated.
+int gb_trace_start(GameBoy* gb, const char* path);
+int gb_trace_stop(GameBoy* gb);
+
+// Per-PC profile (see profiler.h); gb_profile_write writes <prefix>.txt and
+// <prefix>.folded. Both return 0 or -1.
+int gb_profile_start(GameBoy* gb);
+int gb_profile_write(GameBoy* gb, const char* prefix);
+void gb_profile_stop(GameBoy* gb);
+
+// Idle skipping (HALT and poll loops, see CPU_IdleMode); on by default.
+// gb_idle_overrides applies this title's entry from an overrides file
+// (see idle.h): 1 if one matched, 0 if none, -1 on a read/parse error.
+void gb_set_idle(GameBoy* gb, CPU_IdleMode mode);
+int gb_idle_overrides(GameBoy* gb, const char* path);
+
+// Battery saves: map path as the cart RAM, flushed in the background every
+// SAVE_FLUSH_FRAMES frames while dirty and on gb_destroy. Returns 0, or -1
+// if the file could not be mapped. Carts without battery RAM ignore it.
+int gb_save_open(GameBoy* gb, const char* path);
+
+// Link cable (see link.h): plug into the free end of link `name`. Each end
+// of a plugged-in link must be run on its own thread or process; an end
+// waits for its partner. Rewind and movies only cover this instance, so
+// they don't reproduce a linked run. Returns 0, or -1 if the link could
+// not be opened or both ends are taken.
+int gb_link_open(GameBoy* gb, const char* name);
+void gb_link_close(GameBoy* gb);                        // Also done by gb_destroy
+
+// Input (JOYPAD_* bits, 1 = pressed)
+void gb_set_buttons(GameBoy* gb, uint8_t buttons);
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// xxHash64 (XXH64) of a buffer; stable across hosts and runs
+uint64_t hash64(const void* data, size_t len, uint64_t seed);
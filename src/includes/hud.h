@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+#include "gameboy.h"
+
+// Debug overlay for the window frontend: FPS, registers and a disassembly
+// window at PC. The font is rasterized once into a glyph atlas texture;
+// every frame the whole overlay (text and panel backgrounds) becomes one
+// vertex list drawn with a single SDL_RenderGeometry call, so nothing is
+// rendered or uploaded per string.
+//
+// The emulation thread fills a HudSnapshot next to each frame it publishes
+// (see frontend.c); the SDL thread only ever reads the snapshot.
+
+#define HUD_FONT_PATH    "asset/NotoSansMono-Medium.ttf"
+#define HUD_POINT_SIZE   12
+#define HUD_CODE_BYTES   32         // Bytes captured from PC for disassembly
+#define HUD_CODE_LINES   8
+
+#define HUD_FIRST_GLYPH  32         // Printable ASCII in the atlas
+#define HUD_LAST_GLYPH   126
+#define HUD_SOLID        127        // Atlas cell filled white, for panels
+
+typedef struct {
+    uint16_t af, bc, de, hl, sp, pc;
+    bool ime, halted;
+    uint8_t ly, lcdc, stat, ie, iflag;
+    uint32_t frame;
+    uint64_t cycles;
+    float fps;                      // Emulated frames per second
+    uint8_t code[HUD_CODE_BYTES];
+    uint8_t code_avail;             // Bytes readable without side effects
+} HudSnapshot;
+
+typedef struct Hud {
+    SDL_Renderer* renderer;
+    SDL_Texture* atlas;
+    int atlas_width, atlas_height;
+    int cell_width, cell_height;    // Monospace glyph cell
+
+    // Per-frame batch, reused
+    SDL_Vertex* vertices;
+    int* indices;
+    int quads;
+    int capacity;                   // Quads
+} Hud;
+
+// NULL if SDL_ttf, the font or the atlas could not be set up
+Hud* hud_create(SDL_Renderer* renderer, const char* font_path, int point_size);
+void hud_free(Hud* hud);
+
+// Emulation thread: record what the overlay shows for the current frame
+void hud_capture(HudSnapshot* snapshot, GameBoy* gb, float fps);
+
+// SDL thread: draw the overlay for snapshot on top of the current target
+void hud_draw(Hud* hud, const HudSnapshot* snapshot, float present_fps);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "cpu.h"
+
+// Per-title idle-skip overrides. One entry per line, title in quotes as it
+// appears in the cartridge header, then the mode and optional loop heads
+// (hex) that must never be skipped:
+//
+//     # title             mode   ignore
+//     "TETRIS"            full
+//     "SOME GAME"         halt
+//     "OTHER GAME"        full   0x0A3C 0x0A52
+//
+// Modes: off, halt, full.
+
+int idle_mode_parse(const char* name);     // CPU_IdleMode, or -1
+
+// Apply the entry for title. Returns 1 if one matched, 0 if none did, or -1
+// if the file could not be read or a line is malformed.
+int idle_overrides_apply(CPU_Idle* idle, const char* title, const char* path);
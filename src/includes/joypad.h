@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Button bits (1 = pressed)
+#define JOYPAD_A      0x01
+#define JOYPAD_B      0x02
+#define JOYPAD_SELECT 0x04
+#define JOYPAD_START  0x08
+#define JOYPAD_RIGHT  0x10
+#define JOYPAD_LEFT   0x20
+#define JOYPAD_UP     0x40
+#define JOYPAD_DOWN   0x80
+
+typedef struct Joypad {
+    uint8_t state;      // Currently pressed buttons (JOYPAD_* bits)
+    uint8_t select;     // JOYP (0xFF00) bits 4-5 as last written
+} Joypad;
+
+// Public interface
+Joypad* joypad_create(void);
+void joypad_init(Joypad* joypad);
+void joypad_free(Joypad* joypad);
+
+// Input handling; returns true when a button went from released to pressed
+// (the caller raises the joypad interrupt)
+bool joypad_set_state(Joypad* joypad, uint8_t state);
+
+// Register access
+uint8_t joypad_read(Joypad* joypad);
+void joypad_write(Joypad* joypad, uint8_t value);
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "scheduler.h"
+#include "serial.h"
+
+// Link cable between two instances, in one process or in two, through a
+// POSIX shared memory segment "/gameboy-link-<name>". Each end writes a
+// single-producer single-consumer ring of timestamped messages for its
+// partner and publishes how far it has run. Times on the link are master
+// cycles counted from when the link was plugged in.
+//
+// The ends run in lockstep windows: neither runs more than LINK_WINDOW
+// cycles past the time its partner last published. A byte lands
+// SERIAL_TRANSFER_CYCLES after a transfer starts, so with the window no
+// longer than that, a transfer always reaches the other end before it has
+// run past the moment the byte lands, and a linked pair runs the same way
+// however the host schedules it. The only other wait is the clocking
+// end's, for its partner to reach the end of the transfer and report the
+// byte it shifted out.
+
+#define LINK_WINDOW     SERIAL_TRANSFER_CYCLES
+#define LINK_RING       64      // Messages in flight per direction (power of two)
+#define LINK_NAME_MAX   64
+
+typedef enum {
+    LINK_START,         // Partner started a transfer on its internal clock
+    LINK_REPLY,         // Byte the externally clocked partner shifted out
+} LinkKind;
+
+typedef struct {
+    uint64_t time;      // LINK_START: start of the transfer, LINK_REPLY: its end
+    uint8_t kind;       // LinkKind
+    uint8_t value;
+} LinkMessage;
+
+// One end in the shared segment. Everything but head is written by the
+// end itself; head belongs to the partner reading the ring.
+typedef struct {
+    alignas(64) _Atomic uint64_t time;      // Link time this end has run to
+    _Atomic uint32_t tail;                  // Messages written
+    _Atomic int32_t pid;                    // Owning process, 0 while unplugged
+    alignas(64) _Atomic uint32_t head;      // Messages read
+    LinkMessage ring[LINK_RING];
+} LinkEnd;
+
+typedef struct {
+    LinkEnd ends[2];
+} LinkShared;
+
+// Received message, due on the local clock
+typedef struct {
+    uint64_t due;
+    uint8_t kind;
+    uint8_t value;
+} LinkPending;
+
+typedef struct Link {
+    LinkShared* shared;
+    LinkEnd* out;               // This end
+    LinkEnd* in;                // Partner's
+    char name[LINK_NAME_MAX];   // Segment name
+    uint64_t base;              // Local cycles at link time 0
+    _Atomic bool unplugged;     // Set by link_unplug, from any thread
+
+    LinkPending pending[LINK_RING];     // Polled, in arrival order
+    uint32_t pending_count;
+} Link;
+
+// Take the free end of link `name`, creating the segment if needed; an end
+// left behind by a process that died is free. NULL if both ends are in use
+// or the segment could not be mapped.
+Link* link_open(const char* name);
+void link_close(Link* link);
+
+// Stop waiting and behave as if unplugged from now on. Callable from any
+// thread, e.g. to shut down an instance that is waiting on its partner.
+void link_unplug(Link* link);
+
+// Start the link clock at local time cycles: 0 if the partner has not
+// plugged in yet, otherwise the partner's time, so neither waits for the
+// other to catch up on what it ran alone
+void link_attach(Link* link, uint64_t cycles);
+
+// Partner's published time on the local clock, SCHED_NEVER if there is no
+// partner. Read before link_poll: every message up to it is in the ring.
+// Messages already polled stay pending after the partner unplugs.
+uint64_t link_partner_time(Link* link);
+
+// Promise that this end has sent everything up to local time cycles
+void link_publish(Link* link, uint64_t cycles);
+
+// Move the partner's messages from the ring to the pending list. What a
+// partner sent before unplugging is still delivered at its due time;
+// nothing is taken once this end has unplugged.
+void link_poll(Link* link);
+
+// Send a message stamped with local time cycles; dropped without a partner
+void link_send(Link* link, LinkKind kind, uint64_t cycles, uint8_t value);
+
+// Pop the first pending message of this kind due at or before cycles
+bool link_take(Link* link, LinkKind kind, uint64_t cycles, LinkPending* out);
+
+// Earliest due time of pending messages of this kind, SCHED_NEVER if none
+uint64_t link_next_due(Link* link, LinkKind kind);
+
+// Wait until the partner publishes a time other than seen, or goes away
+void link_wait(Link* link, uint64_t seen);
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "cartridge.h"
 
 typedef struct MBC MBC;
+typedef struct MMU MMU;
+
+#define MBC_ROM_BANK_SIZE 0x4000
+#define MBC_RAM_BANK_SIZE 0x2000
 
 // All MBCs must implement these
 typedef uint8_t (*MBC_ReadRomFunc)(MBC* mbc, uint16_t address);
@@ -11,6 +16,10 @@ typedef void (*MBC_WriteRomFunc)(MBC* mbc, uint16_t address, uint8_t value);
 typedef uint8_t (*MBC_ReadRamFunc)(MBC* mbc, uint16_t address);
 typedef void (*MBC_WriteRamFunc)(MBC* mbc, uint16_t address, uint8_t value);
 
+// Optional: extra state stored after the RAM in the .sav file (MBC3 RTC)
+typedef void (*MBC_SaveFooterFunc)(MBC* mbc, uint8_t* footer);
+typedef void (*MBC_LoadFooterFunc)(MBC* mbc, const uint8_t* footer);
+
 // mbc.h - Memory Bank Controller interface
 typedef struct MBC {
     // Virtual function table
@@ -18,16 +27,64 @@ typedef struct MBC {
     MBC_WriteRomFunc write_rom;
     MBC_ReadRamFunc read_ram;
     MBC_WriteRamFunc write_ram;
-    
+    MBC_SaveFooterFunc save_footer;
+    MBC_LoadFooterFunc load_footer;
+    size_t footer_size;
+
     // Common data
     Cartridge* cart;  // Reference to cartridge
+    MMU* mmu;         // Page tables to update on bank switches
     uint8_t* ram_data;
     size_t ram_size;
-    
+
+    // Battery RAM. While ram_protect is set the window is mapped read-only,
+    // so the first write after a flush takes the slow path and sets ram_dirty.
+    bool battery;
+    bool ram_file;      // ram_data is a .sav mapping owned by a SaveFile
+    bool ram_protect;
+    bool ram_dirty;
+
+    // ROM as whole 16KB banks. Points at the cartridge mapping, or at a
+    // 0xFF-padded copy when the file does not end on a bank boundary.
+    const uint8_t* rom;
+    uint32_t rom_banks;
+    uint8_t* rom_copy;
+
+    // Bank base pointers, recomputed on every banking register write and
+    // mirrored into the MMU page tables
+    const uint8_t* rom_low;     // 0x0000-0x3FFF
+    const uint8_t* rom_high;    // 0x4000-0x7FFF
+    uint8_t* ram_bank;          // 0xA000-0xBFFF, NULL while disabled
+
     // Type-specific data (use a union or void*)
     void* type_data;  // For MBC1, MBC2, etc. specific data
+    size_t type_size; // Plain bytes, copied as-is into save states
 } MBC;
 
-// Type-specific creators
-MBC* mbc_none_create(Cartridge* cart);
-MBC* mbc1_create(Cartridge* cart);
+// Shared setup: common fields, ROM image, and ram_size bytes of cart RAM
+MBC* mbc_alloc(Cartridge* cart, MMU* mmu, size_t ram_size, size_t type_size);
+void mbc_free(MBC* mbc);
+size_t mbc_ram_size(uint8_t code);      // Header 0x149 code to bytes
+bool mbc_has_battery(uint8_t type);     // Header 0x147
+
+// Swap in file-backed RAM (before the RAM is first enabled), and
+// write-protect the window again after a flush
+void mbc_set_ram(MBC* mbc, uint8_t* data);
+void mbc_protect_ram(MBC* mbc);
+
+// Select banks (wrapped to the ROM/RAM size) and update the page tables
+void mbc_map_rom(MBC* mbc, uint32_t low, uint32_t high);
+void mbc_map_ram(MBC* mbc, bool enabled, uint32_t bank);
+
+// Default handlers: reads through the bank pointers, open bus (0xFF) and
+// ignored writes while cart RAM is disabled
+uint8_t mbc_read_rom(MBC* mbc, uint16_t address);
+uint8_t mbc_read_ram(MBC* mbc, uint16_t address);
+void mbc_write_ram(MBC* mbc, uint16_t address, uint8_t value);
+
+// Type-specific creators; each maps its initial banks into mmu's page tables
+MBC* mbc_none_create(Cartridge* cart, MMU* mmu);
+MBC* mbc1_create(Cartridge* cart, MMU* mmu);
+MBC* mbc2_create(Cartridge* cart, MMU* mmu);
+MBC* mbc3_create(Cartridge* cart, MMU* mmu);
+MBC* mbc5_create(Cartridge* cart, MMU* mmu);
@@ -1,13 +1,54 @@
 #ifndef MMU_H
 #define MMU_H
 
+#include "apu.h"
 #include "cartridge.h"
+#include "joypad.h"
+#include "link.h"
 #include "mbc.h"
+#include "ppu.h"
+#include "scheduler.h"
+#include "serial.h"
+#include "timer.h"
+
+typedef struct CPU CPU;
+typedef struct BlockCache BlockCache;
+
+// OAM DMA copies 160 bytes and keeps the bus busy for 640 cycles
+#define MMU_DMA_CYCLES 640
+
+// Page tables split the address space into 256-byte pages
+#define MMU_PAGE_SHIFT 8
+#define MMU_PAGE_SIZE  0x100
+#define MMU_PAGE_COUNT 0x100
 
 typedef struct MMU {
     uint8_t memory[0x10000];    // 64KB address space
     Cartridge* cart;
     MBC* mbc;
+
+    // Per-page direct pointers; NULL falls back to mmu_read_slow/mmu_write_slow
+    // (I/O, MBC banking registers, unmapped areas)
+    const uint8_t* read_page[MMU_PAGE_COUNT];
+    uint8_t* write_page[MMU_PAGE_COUNT];
+    uint32_t code_gen;          // Bumped whenever mapped or cached code may have changed
+
+    // Predecoded blocks; RAM pages holding cached code are write-protected
+    // (write_page NULL) and report writes here. NULL in interpreter mode.
+    BlockCache* blocks;
+
+    // OAM DMA
+    bool dma_active;
+
+    // Linked components (owned by the GameBoy)
+    CPU* cpu;           // Master clock (CPU::cycles)
+    Scheduler* sched;
+    Timer* timer;
+    PPU* ppu;
+    APU* apu;
+    Joypad* joypad;
+    Serial* serial;
+    Link* link;         // Link cable, NULL when there is none
 } MMU;
 
 // Public interface
@@ -15,10 +56,48 @@ MMU* mmu_create(void);
 int mmu_init(MMU* mmu, Cartridge* cart);
 void mmu_free(MMU* mmu);
 
+// Page table maintenance (used by MBCs on bank switches).
+// address/size must be page aligned; read/write may be NULL for handler pages.
+void mmu_map_pages(MMU* mmu, uint16_t address, uint32_t size, const uint8_t* read, uint8_t* write);
+
+// Bank switch fast path: map a 16KB ROM bank at 0x0000 or 0x4000. ROM is
+// never writable, so only the read table changes, and the fixed page count
+// lets the compiler vectorize the fill.
+void mmu_map_rom(MMU* mmu, uint16_t address, const uint8_t* bank);
+
+// Scheduler event handlers
+void mmu_dma_event(MMU* mmu);
+void mmu_serial_event(MMU* mmu, uint8_t in);    // in: byte shifted in
+
+// Slow paths for pages without a direct mapping
+uint8_t mmu_read_slow(MMU* mmu, uint16_t address);
+void mmu_write_slow(MMU* mmu, uint16_t address, uint8_t value);
+
 // Memory access
-uint8_t mmu_read(MMU* mmu, uint16_t address);
-void mmu_write(MMU* mmu, uint16_t address, uint8_t value);
-uint16_t mmu_read16(MMU* mmu, uint16_t address);
-void mmu_write16(MMU* mmu, uint16_t address, uint16_t value);
+static inline uint8_t mmu_read(MMU* mmu, uint16_t address) {
+    const uint8_t* page = mmu->read_page[address >> MMU_PAGE_SHIFT];
+    if (page) return page[address & (MMU_PAGE_SIZE - 1)];
+    return mmu_read_slow(mmu, address);
+}
+
+static inline void mmu_write(MMU* mmu, uint16_t address, uint8_t value) {
+    uint8_t* page = mmu->write_page[address >> MMU_PAGE_SHIFT];
+    if (page) {
+        page[address & (MMU_PAGE_SIZE - 1)] = value;
+        return;
+    }
+    mmu_write_slow(mmu, address, value);
+}
+
+static inline uint16_t mmu_read16(MMU* mmu, uint16_t address) {
+    uint8_t low = mmu_read(mmu, address);
+    uint8_t high = mmu_read(mmu, address + 1);
+    return (high << 8) | low;
+}
+
+static inline void mmu_write16(MMU* mmu, uint16_t address, uint16_t value) {
+    mmu_write(mmu, address, value & 0xFF);
+    mmu_write(mmu, address + 1, value >> 8);
+}
 
 #endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gameboy.h"
+
+// Input movies: the joypad state of every frame since power-on, plus what a
+// power-on doesn't reproduce by itself (the ROM it was made with and the
+// battery RAM it started from). The core is deterministic, so replaying
+// the buttons one frame at a time gives back the same session, in any CPU
+// or idle mode and in any later build. Replay and compare with tools/gbreplay.
+//
+// File: MovieHeader, battery image (cart RAM then the MBC footer, as in a
+// .sav), then (buttons, frame count as LEB128) runs until all frames are
+// covered.
+
+#define MOVIE_MAGIC  "GBMOVIE1"
+
+typedef struct {
+    char magic[8];
+    uint64_t rom_hash;      // hash64 of the ROM file, seed 0
+    uint32_t frames;
+    uint32_t battery_size;
+} MovieHeader;
+
+// movie_read/movie_start results
+#define MOVIE_OK            0
+#define MOVIE_ERR_OPEN      -1      // Missing, unreadable or not a movie
+#define MOVIE_ERR_NOMEM     -2
+#define MOVIE_ERR_ROM       -3      // Recorded with a different ROM
+#define MOVIE_ERR_BATTERY   -4      // Battery image doesn't fit this cart
+
+typedef struct {
+    uint64_t rom_hash;
+    uint8_t* battery;
+    size_t battery_size;
+
+    uint8_t* buttons;       // JOYPAD_* bits, one per frame
+    uint32_t frames;
+    uint32_t capacity;
+} Movie;
+
+// Start recording from gb, which must not have run yet
+Movie* movie_create(GameBoy* gb);
+void movie_free(Movie* movie);
+
+// Append the buttons held during the next frame; 0 or -1
+int movie_add_frame(Movie* movie, uint8_t buttons);
+
+// Forget frames from frames on (after rewinding)
+void movie_truncate(Movie* movie, uint32_t frames);
+
+// 0 or -1
+int movie_write(const Movie* movie, const char* path);
+int movie_read(const char* path, Movie** out);
+
+// Check the ROM and load the battery image into a freshly created gb
+int movie_start(const Movie* movie, GameBoy* gb);
+
+const char* movie_error_string(int error);
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "scheduler.h"
+
+typedef struct MMU MMU;
+
+typedef enum {
+    PPU_MODE_HBLANK = 0,
+    PPU_MODE_VBLANK = 1,
+    PPU_MODE_OAM = 2,
+    PPU_MODE_TRANSFER = 3
+} PPU_Mode;
+
+// Mode lengths in cycles
+#define PPU_OAM_CYCLES       80
+#define PPU_TRANSFER_CYCLES  172
+#define PPU_HBLANK_CYCLES    204
+#define PPU_LINE_CYCLES      456
+#define PPU_VBLANK_LINE      144
+#define PPU_LINES            154
+#define PPU_FIFO_DELAY       12     // Fetcher warm-up before the first pixel
+
+#define PPU_WIDTH            160
+#define PPU_HEIGHT           144
+#define PPU_MAX_SPRITES      10     // Per line
+
+typedef enum {
+    PPU_RENDER_SCANLINE = 0,    // Whole line at the start of mode 3
+    PPU_RENDER_FIFO = 1         // 8 pixels at a time across mode 3, sees mid-line writes
+} PPU_RenderMode;
+
+// The PPU only wakes up on mode changes posted to the scheduler
+typedef struct PPU {
+    // Internal state
+    PPU_Mode mode;
+    uint8_t ly;             // Current line (0xFF44)
+    bool stat_line;         // STAT interrupt line; IRQ on rising edge
+
+    // Registers (the rest live in MMU::memory)
+    uint8_t lcdc;           // LCD Control (0xFF40)
+    uint8_t stat;           // LCD Status enables, bits 3-6 (0xFF41)
+    uint8_t lyc;            // LY Compare (0xFF45)
+
+    // Rendering
+    PPU_RenderMode render_mode;
+    bool simd;              // SSSE3 shuffles available at runtime
+    uint8_t x;              // Next pixel to output (FIFO mode)
+    uint8_t window_line;    // Internal window line counter
+    bool window_active;     // Window was drawn on this line
+    uint8_t sprite_count;
+    uint8_t sprites[PPU_MAX_SPRITES];   // OAM indices for this line, by priority
+    uint32_t colors[4];                 // ARGB8888 for shades 0-3
+    uint32_t framebuffer[PPU_WIDTH * PPU_HEIGHT];  // Being drawn, line by line
+    uint32_t picture[PPU_WIDTH * PPU_HEIGHT];      // Last drawn frame, copied at VBlank
+
+    // Frame skipping: only every render_period-th frame is drawn; the rest
+    // keep full LY/STAT/interrupt timing but produce no pixels
+    uint32_t render_period;     // 1 = draw every frame
+    uint32_t frame;             // Frames started since the LCD came on
+    bool render;                // Drawing the current frame
+    uint32_t frames_drawn;      // Bumped when a drawn frame reaches VBlank (new picture)
+
+    // Linked components
+    MMU* mmu;
+    Scheduler* sched;
+} PPU;
+
+// Public interface
+PPU* ppu_create(void);
+void ppu_init(PPU* ppu, MMU* mmu, Scheduler* sched);
+void ppu_free(PPU* ppu);
+
+// Register access (0xFF40, 0xFF41, 0xFF44, 0xFF45)
+uint8_t ppu_read(PPU* ppu, uint16_t address);
+void ppu_write(PPU* ppu, uint16_t address, uint8_t value, uint64_t now);
+
+// SCHED_PPU handler
+void ppu_event(PPU* ppu, uint64_t when);
+
+// Rendering (ppu_render.c)
+void ppu_render_init(PPU* ppu);
+void ppu_scan_oam(PPU* ppu);                    // Select this line's sprites
+void ppu_render_line(PPU* ppu);                 // Scanline mode: the whole line
+void ppu_render_span(PPU* ppu, int x0, int x1); // FIFO mode: pixels [x0, x1)
+void ppu_clear(PPU* ppu);                       // Blank screen (and picture) while the LCD is off
+void ppu_skip_line(PPU* ppu);                   // Undrawn frame: window line bookkeeping only
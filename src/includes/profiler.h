@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "mmu.h"
+
+// Guest profiler. Counts executed instructions and cycles per (bank, PC)
+// and keeps a shadow call stack (CALL/RST/interrupt entry, RET/RETI) as a
+// calling-context tree. At the end it writes a text report (hot loops,
+// idle-wait loops, hot blocks, call edges) and a collapsed-stack file for
+// flamegraph.pl / speedscope.
+//
+// Build with -DGB_NO_PROFILE to compile the hook out of the CPU; otherwise
+// it costs one predicted branch while no profile is running.
+
+#define PROFILE_MAX_DEPTH 256   // Deeper calls are folded into the deepest frame
+
+// Key: ROM bank in the high bits for 0x4000-0x7FFF, plain address elsewhere
+typedef uint32_t ProfileKey;
+
+#define PROFILE_KEY(bank, pc)  (((ProfileKey)(bank) << 16) | (pc))
+#define PROFILE_BANK(key)      ((key) >> 16)
+#define PROFILE_PC(key)        ((uint16_t)(key))
+
+typedef struct {
+    uint64_t instructions;
+    uint64_t cycles;
+    uint64_t halt_cycles;   // Cycles spent halted after this HALT
+    uint64_t back_taken;    // Taken backward branches from this instruction
+} ProfileEntry;
+
+// Calling-context tree node: one per distinct call path
+typedef struct {
+    ProfileKey function;    // Entry address of the callee
+    int32_t parent;
+    int32_t child;          // First child
+    int32_t sibling;
+    uint64_t calls;
+    uint64_t cycles;        // Self cycles
+} ProfileNode;
+
+typedef struct {
+    int32_t node;
+    uint16_t slot;          // Stack address holding the return address
+} ProfileFrame;
+
+typedef struct Profiler {
+    MMU* mmu;
+    const uint8_t* rom;
+    size_t rom_size;
+    uint32_t banks;
+
+    ProfileEntry* low;      // 0x0000-0x3FFF and 0x8000-0xFFFF, by address
+    ProfileEntry** bank;    // 0x4000-0x7FFF per ROM bank, allocated on first use
+
+    ProfileNode* nodes;
+    int32_t node_count;
+    int32_t node_cap;
+
+    ProfileFrame stack[PROFILE_MAX_DEPTH];
+    int depth;              // Frames in use, stack[0] is the root
+    int overflow;           // Calls not pushed because the stack was full
+
+    uint64_t instructions;
+    uint64_t cycles;
+} Profiler;
+
+Profiler* profiler_create(MMU* mmu);
+void profiler_free(Profiler* prof);
+
+// CPU hooks. sp is the stack pointer before the instruction executed;
+// the CPU has already moved to the next pc.
+void profiler_step(Profiler* prof, uint16_t pc, uint8_t opcode, uint16_t sp, uint16_t next_pc, int cycles);
+void profiler_halt(Profiler* prof, uint16_t pc, int cycles);
+void profiler_interrupt(Profiler* prof, uint16_t vector, uint16_t sp, int cycles);
+
+// Output: <prefix>.txt report and <prefix>.folded collapsed stacks.
+// Returns 0, or -1 if a file could not be written.
+int profiler_write(Profiler* prof, const char* prefix);
+void profiler_report(Profiler* prof, FILE* out);
+void profiler_collapsed(Profiler* prof, FILE* out);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gameboy.h"
+
+// Rewind history in a fixed memory budget. After every frame the machine
+// state (gb_state_sections) is compared a word at a time with the previous
+// frame's and only the XOR of the changed words is kept, run-length coded.
+// Every keyframe_interval frames a whole snapshot is stored instead. Most
+// of the 64KB address space is untouched from one frame to the next, so a
+// delta is typically a few hundred bytes.
+//
+// Stepping back undoes the newest delta (XOR is its own inverse); stepping
+// over a keyframe rebuilds the frame before it from the previous keyframe.
+// The picture is regenerated by replaying the frame with its recorded
+// buttons. When the budget or the frame limit is hit, the oldest keyframe
+// and its deltas are dropped together.
+
+#define REWIND_BUDGET       (64u << 20)     // Bytes of encoded history
+#define REWIND_FRAMES       3600            // 60 s at ~60 fps
+#define REWIND_KEYFRAME     60              // Frames between whole snapshots
+
+typedef struct {
+    uint64_t offset;        // Position in the arena (monotonic, wraps modulo budget)
+    uint32_t size;          // Encoded bytes
+    uint8_t buttons;        // Joypad state during the frame, for replay
+    bool key;               // Whole snapshot rather than a delta
+} RewindRecord;
+
+typedef struct Rewind {
+    GameBoy* gb;
+    size_t words;           // Snapshot size in 64-bit words
+    uint64_t* current;      // Snapshot of the newest recorded frame
+    uint64_t* scratch;      // Rebuild buffer
+    uint8_t* encoded;       // Worst-case encode buffer
+
+    uint8_t* arena;
+    size_t budget;
+    uint64_t write;         // Next free arena position
+
+    RewindRecord* records;  // Ring, oldest at first
+    uint32_t capacity;
+    uint32_t first;
+    uint32_t count;
+
+    uint32_t keyframe_interval;
+    uint32_t since_key;     // Frames recorded since the last keyframe
+    uint64_t bytes;         // Encoded bytes currently held
+} Rewind;
+
+// NULL if out of memory or the budget can't hold two keyframes
+Rewind* rewind_create(GameBoy* gb, size_t budget, uint32_t frames, uint32_t keyframe_interval);
+void rewind_free(Rewind* rw);
+
+// Record the frame gb_run_frame just finished
+void rewind_capture(Rewind* rw);
+
+// Go back one frame, framebuffer included. Returns false once the oldest
+// recorded frame is reached.
+bool rewind_step(Rewind* rw);
+
+// Drop all history (after loading an unrelated state)
+void rewind_reset(Rewind* rw);
+
+static inline uint32_t rewind_frames(const Rewind* rw) { return rw->count; }
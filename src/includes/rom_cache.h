@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+// Read-only ROM image shared by every Cartridge loaded from the same file.
+// Images are mmap'd (PROT_READ, MAP_PRIVATE) once per process and
+// refcounted, so N instances of one ROM share the same physical pages.
+typedef struct RomImage {
+    const uint8_t* data;
+    size_t size;
+
+    // Cache key; size and mtime tell a file rewritten in place from the
+    // one mapped, which later acquires must not reuse
+    char* path;
+    dev_t dev;
+    ino_t ino;
+    off_t file_size;
+    struct timespec mtime;
+
+    int refs;
+    struct RomImage* next;
+} RomImage;
+
+// Error codes (shared with load_rom)
+#define ROM_OK          0
+#define ROM_ERR_OPEN   -1   // open/stat failed
+#define ROM_ERR_MAP    -2   // mmap failed or file is empty
+#define ROM_ERR_NOMEM  -3
+
+// Returns ROM_OK and a referenced image, or an error code.
+// Thread safe; the cache is process wide.
+int rom_cache_acquire(const char* path, RomImage** image);
+void rom_cache_release(RomImage* image);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ROM library index: one fixed-size record per ROM with its header fields,
+// checksum verdicts and content hash, so a launcher can list a library
+// without opening the ROM files. Built by tools/gameboy-index.
+//
+// File layout, little-endian, used in place through a read-only mapping:
+//   RomIndexHeader
+//   RomIndexEntry[count]   sorted by path
+//   char paths[paths_size] NUL-terminated, referenced by RomIndexEntry::path
+
+#define ROM_INDEX_MAGIC "GBINDEX1"
+
+// RomIndexEntry::flags
+#define ROM_INDEX_LOGO_OK   0x01    // Nintendo logo intact
+#define ROM_INDEX_HEADER_OK 0x02    // 0x14D matches
+#define ROM_INDEX_GLOBAL_OK 0x04    // 0x14E-0x14F matches
+
+typedef struct {
+    char magic[8];
+    uint32_t count;
+    uint32_t paths_size;
+} RomIndexHeader;
+
+typedef struct {
+    uint64_t hash;              // hash64 of the whole file (as in movies)
+    uint64_t size;              // File size
+    int64_t mtime;              // Modification time in ns; rescans reuse unchanged entries
+    uint32_t path;              // Offset into the path table
+    char title[16];             // 0x134-0x143, NUL padded
+    uint16_t new_licensee;      // 0x144-0x145
+    uint16_t global_checksum;   // 0x14E-0x14F
+    uint8_t sgb_flag;           // 0x146
+    uint8_t cartridge_type;     // 0x147
+    uint8_t rom_size;           // 0x148
+    uint8_t ram_size;           // 0x149
+    uint8_t destination;        // 0x14A
+    uint8_t old_licensee;       // 0x14B
+    uint8_t version;            // 0x14C
+    uint8_t header_checksum;    // 0x14D
+    uint8_t flags;              // ROM_INDEX_*
+    uint8_t reserved[7];
+} RomIndexEntry;
+
+typedef struct {
+    const RomIndexEntry* entries;
+    uint32_t count;
+    const char* paths;
+    size_t paths_size;
+
+    void* map;
+    size_t map_size;
+} RomIndex;
+
+// Map an index. NULL if the file is missing or malformed.
+RomIndex* rom_index_open(const char* path);
+void rom_index_close(RomIndex* index);
+
+static inline const char* rom_index_path(const RomIndex* index, const RomIndexEntry* entry) {
+    return index->paths + entry->path;
+}
+
+// Title as printable ASCII, other bytes shown as '?'
+void rom_index_title(const RomIndexEntry* entry, char title[17]);
+
+// Entry with exactly this path, or NULL (binary search)
+const RomIndexEntry* rom_index_find(const RomIndex* index, const char* path);
+
+// Clear entry and fill the header, checksum and hash fields from a whole
+// ROM image; path and mtime are left to the caller. Returns false if the
+// image is too small to have a header.
+bool rom_index_fill(RomIndexEntry* entry, const uint8_t* data, size_t size);
+
+// Write entries (already sorted by path) through a temporary file renamed
+// into place, so readers never see a partial index. Returns 0 or -1.
+int rom_index_write(const char* path, const RomIndexEntry* entries, uint32_t count,
+                    const char* paths, size_t paths_size);
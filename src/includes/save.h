@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mbc.h"
+
+// Battery-backed cart RAM kept in an mmap'd .sav file (RAM image, then the
+// MBC footer, e.g. the MBC3 clock). The MBC writes straight into the shared
+// mapping and only marks it dirty; save_frame hands dirty files to one
+// process-wide flusher thread that msyncs them, at most once per interval.
+
+#define SAVE_FLUSH_FRAMES 60    // Default: about once a second
+
+typedef struct SaveFile {
+    char* path;
+    int fd;
+    uint8_t* data;
+    size_t size;            // RAM + footer
+    MBC* mbc;
+
+    uint32_t interval;      // Frames between flushes
+    uint32_t frames;        // Since the last flush
+
+    // Guarded by the flusher lock
+    bool queued;
+    bool busy;              // msync in progress
+    struct SaveFile* next;
+} SaveFile;
+
+// Map path (created if missing) as mbc's cart RAM. NULL on failure.
+SaveFile* save_open(const char* path, MBC* mbc, uint32_t interval);
+
+// Call once per frame from the emulation thread
+void save_frame(SaveFile* save);
+
+// Flush synchronously, unmap and free
+void save_close(SaveFile* save);
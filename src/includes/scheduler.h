@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Event sources; each has at most one pending deadline
+typedef enum {
+    SCHED_STOP,         // End of the current gb_run_cycles slice
+    SCHED_TIMER,        // TIMA overflow
+    SCHED_PPU,          // Next PPU mode change
+    SCHED_DMA,          // OAM DMA finished
+    SCHED_SERIAL,       // Serial transfer finished
+    SCHED_LINK,         // Link cable: lockstep window end or a partner's byte landing
+    SCHED_EVENT_COUNT
+} SchedEvent;
+
+#define SCHED_NEVER UINT64_MAX
+
+// Indexed min-heap keyed on the 64-bit master cycle counter (CPU::cycles).
+// The CPU runs uninterrupted until `next`, the earliest pending deadline.
+typedef struct Scheduler {
+    uint64_t next;                      // Earliest deadline (SCHED_NEVER if none)
+    uint64_t when[SCHED_EVENT_COUNT];   // Deadline per event
+    uint8_t heap[SCHED_EVENT_COUNT];    // Event ids ordered by deadline
+    uint8_t slot[SCHED_EVENT_COUNT];    // Heap index per event, SCHED_IDLE if not pending
+    uint8_t size;
+} Scheduler;
+
+#define SCHED_IDLE 0xFF
+
+void sched_init(Scheduler* sched);
+
+// Post (or move) an event's deadline
+void sched_post(Scheduler* sched, SchedEvent event, uint64_t when);
+void sched_cancel(Scheduler* sched, SchedEvent event);
+
+// Pops the earliest event due at or before now; returns -1 if none is due.
+// *when receives the time it was scheduled for.
+int sched_pop_due(Scheduler* sched, uint64_t now, uint64_t* when);
+
+static inline bool sched_pending(Scheduler* sched, SchedEvent event) {
+    return sched->slot[event] != SCHED_IDLE;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 8 bits at 8192 Hz with the internal clock
+#define SERIAL_TRANSFER_CYCLES 4096
+
+// Serial port (0xFF01 SB / 0xFF02 SC). With no link partner every
+// transfer shifts in 0xFF; bytes shifted out are kept for the host. A link
+// cable (link.h) supplies the partner's byte instead.
+typedef struct Serial {
+    uint8_t sb;         // Transfer data
+    uint8_t sc;         // Transfer control
+
+    // Captured output
+    uint8_t* out;
+    size_t out_len;
+    size_t out_cap;
+} Serial;
+
+// Public interface
+Serial* serial_create(void);
+void serial_init(Serial* serial);
+void serial_free(Serial* serial);
+
+// Register access; serial_write_sc returns true when an internally clocked
+// transfer starts (the caller schedules serial_complete)
+uint8_t serial_read_sc(Serial* serial);
+bool serial_write_sc(Serial* serial, uint8_t value);
+
+// Finish the running transfer with the byte shifted in (the caller raises
+// the serial interrupt)
+void serial_complete(Serial* serial, uint8_t in);
+
+// A partner clocked byte in. Only a transfer waiting on the external clock
+// takes part: returns true and the byte shifted out through *out. Otherwise
+// *out is 0xFF, the idle line.
+bool serial_receive(Serial* serial, uint8_t in, uint8_t* out);
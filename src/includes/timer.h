@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include "scheduler.h"
+
+typedef struct MMU MMU;
+
+// DIV/TIMA are derived from the master clock instead of being ticked:
+// the 16-bit divider is (now - div_base), and TIMA is brought up to date
+// lazily. The only scheduled event is the next TIMA overflow.
+typedef struct Timer {
+    // Registers
+    uint8_t tima;   // Timer counter
+    uint8_t tma;    // Timer modulo
+    uint8_t tac;    // Timer control
+
+    // Internal state
+    uint64_t div_base;      // Master cycle at which the divider was 0
+    uint64_t synced;        // Master cycle TIMA is valid for
+
+    // Linked components
+    MMU* mmu;               // For interrupt requests
+    Scheduler* sched;
+} Timer;
+
+// Public interface
+// (timer_create is taken by POSIX <time.h>)
+Timer* gb_timer_create(void);
+void timer_init(Timer* timer, MMU* mmu, Scheduler* sched);
+void timer_free(Timer* timer);
+
+// Register access (0xFF04-0xFF07)
+uint8_t timer_read(Timer* timer, uint16_t address, uint64_t now);
+void timer_write(Timer* timer, uint16_t address, uint8_t value, uint64_t now);
+
+// SCHED_TIMER handler
+void timer_event(Timer* timer, uint64_t when);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+// Binary instruction trace. The CPU appends one fixed-size record per
+// instruction and per interrupt dispatch to a single-producer/single-consumer
+// ring; a background thread drains it to a file. Decode offline with
+// tools/gbtrace.
+//
+// Build with -DGB_NO_TRACE to compile the hook out of the CPU entirely;
+// otherwise it costs one predicted branch while no trace is open.
+
+#define TRACE_MAGIC      "GBTRACE2"     // 2: interrupt records
+#define TRACE_RING_SIZE  (1 << 16)      // Records, power of two
+
+// State before the instruction executes. Interrupt dispatch has its own
+// record (TRACE_INTERRUPT): pc is the address pushed, operand the vector,
+// opcode and length are 0.
+typedef struct {
+    uint64_t cycles;        // Master clock
+    uint16_t pc;
+    uint16_t sp;
+    uint16_t af, bc, de, hl;
+    uint8_t opcode;
+    uint8_t length;         // Opcode + immediate bytes
+    uint16_t operand;       // n/nn/e, or the CB opcode
+    uint8_t flags;          // TRACE_IME | TRACE_HALT_BUG | TRACE_INTERRUPT
+    uint8_t reserved[7];    // Zero
+} TraceRecord;
+
+// No padding: every byte is a member, so initialized records are fully
+// defined and gbtrace --diff can compare them with memcmp
+_Static_assert(sizeof(TraceRecord) == 32, "TraceRecord has padding");
+
+#define TRACE_IME       0x01
+#define TRACE_HALT_BUG  0x02
+#define TRACE_INTERRUPT 0x04
+
+// File header, followed by TraceRecords until EOF
+typedef struct {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t reserved;
+} TraceHeader;
+
+typedef struct Tracer {
+    TraceRecord* ring;
+    _Atomic uint64_t head;  // Next slot to write (CPU thread)
+    _Atomic uint64_t tail;  // Next slot to drain (writer thread)
+    _Atomic bool stop;
+
+    FILE* file;
+    pthread_t thread;
+    uint64_t stalls;        // Times the CPU waited for a full ring
+    bool failed;            // A write failed; the file is truncated (writer thread)
+} Tracer;
+
+Tracer* trace_open(const char* path);  // NULL if the file or thread fails
+
+// Drains everything, then frees. Returns 0, or -1 if any write failed
+// (disk full, I/O error): the file then ends early and must not be trusted.
+int trace_close(Tracer* trace);
+
+void trace_wait(Tracer* trace);         // Slow path: ring is full
+
+static inline void trace_write(Tracer* trace, const TraceRecord* record) {
+    uint64_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&trace->tail, memory_order_acquire) == TRACE_RING_SIZE) {
+        trace_wait(trace);
+    }
+    trace->ring[head & (TRACE_RING_SIZE - 1)] = *record;
+    atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
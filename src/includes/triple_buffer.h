@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free frame handoff between one producer (emulation) and one consumer
+// (presentation). Three buffers: the producer fills its back buffer and
+// swaps it with the middle one; the consumer swaps the middle one for its
+// front buffer when a newer frame is there. Neither side ever waits, the
+// consumer always gets the newest finished frame, and frames it was too
+// slow for are overwritten.
+
+#define TRIPLE_FRESH 0x04       // middle holds a frame the consumer hasn't taken
+
+typedef struct TripleBuffer {
+    void* buffers[3];
+    size_t size;                // Bytes per buffer
+    uint8_t back;               // Producer's
+    uint8_t front;              // Consumer's
+    _Atomic uint8_t middle;     // Buffer index | TRIPLE_FRESH
+} TripleBuffer;
+
+TripleBuffer* triple_buffer_create(size_t size);
+void triple_buffer_free(TripleBuffer* tb);
+
+// Producer: fill triple_buffer_back, then publish it
+static inline void* triple_buffer_back(TripleBuffer* tb) { return tb->buffers[tb->back]; }
+void triple_buffer_publish(TripleBuffer* tb);
+
+// Consumer: the newest published frame, or NULL if none since the last call.
+// Stays valid until the next call.
+const void* triple_buffer_take(TripleBuffer* tb);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+
+// Runs fn(ctx, index, worker) for every index in [0, count) on a pool of
+// worker threads. Each worker starts with a contiguous shard of indices and
+// steals half of the remaining shard of another worker when it runs dry.
+typedef void (*WorkFunc)(void* ctx, size_t index, int worker);
+
+// threads <= 0 uses one worker per online CPU. Returns 0, or -1 on
+// allocation failure. If no thread can be started the work runs inline.
+int workpool_run(size_t count, int threads, WorkFunc fn, void* ctx);
+
+// Number of online CPUs (at least 1)
+int workpool_cpu_count(void);
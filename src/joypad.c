@@ -0,0 +1,38 @@
+#include <stdlib.h>
+#include <string.h>
+#include "joypad.h"
+
+Joypad* joypad_create(void) {
+    Joypad* joypad = malloc(sizeof(Joypad));
+    if (joypad) memset(joypad, 0, sizeof(Joypad));
+    return joypad;
+}
+
+void joypad_init(Joypad* joypad) {
+    joypad->state = 0;
+    joypad->select = 0x30;  // Nothing selected
+}
+
+void joypad_free(Joypad* joypad) {
+    free(joypad);
+}
+
+bool joypad_set_state(Joypad* joypad, uint8_t state) {
+    uint8_t pressed = state & ~joypad->state;
+    joypad->state = state;
+    return pressed != 0;
+}
+
+uint8_t joypad_read(Joypad* joypad) {
+    uint8_t value = 0x0F;
+
+    // Selected groups pull their lines low for pressed buttons
+    if (!(joypad->select & 0x20)) value &= ~(joypad->state & 0x0F);         // A B Select Start
+    if (!(joypad->select & 0x10)) value &= ~((joypad->state >> 4) & 0x0F);  // Right Left Up Down
+
+    return 0xC0 | joypad->select | value;  // Bits 6-7 always 1
+}
+
+void joypad_write(Joypad* joypad, uint8_t value) {
+    joypad->select = value & 0x30;
+}
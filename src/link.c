@@ -0,0 +1,161 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "link.h"
+
+#define LINK_SPINS      4096    // Busy polls before yielding the core
+#define LINK_CHECK      1024    // Yields between checks that the partner is alive
+
+static bool pid_alive(int32_t pid) {
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+// Claim a free end, or one whose process has died
+static bool link_claim(LinkEnd* end, int32_t pid) {
+    int32_t owner = atomic_load(&end->pid);
+    if (owner != 0 && pid_alive(owner)) return false;
+    return atomic_compare_exchange_strong(&end->pid, &owner, pid);
+}
+
+Link* link_open(const char* name) {
+    Link* link = calloc(1, sizeof(Link));
+    if (!link) return NULL;
+    snprintf(link->name, sizeof(link->name), "/gameboy-link-%s", name);
+
+    int fd = shm_open(link->name, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        free(link);
+        return NULL;
+    }
+    // Both processes size it the same; a new segment reads as all zero
+    void* map = ftruncate(fd, sizeof(LinkShared)) == 0 ?
+                mmap(NULL, sizeof(LinkShared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        free(link);
+        return NULL;
+    }
+    link->shared = map;
+
+    int32_t pid = getpid();
+    int side = link_claim(&link->shared->ends[0], pid) ? 0 :
+               link_claim(&link->shared->ends[1], pid) ? 1 : -1;
+    if (side < 0) {
+        munmap(map, sizeof(LinkShared));
+        free(link);
+        return NULL;
+    }
+    link->out = &link->shared->ends[side];
+    link->in = &link->shared->ends[side ^ 1];
+
+    // Whatever a previous owner left in either ring is stale
+    atomic_store(&link->out->tail, atomic_load(&link->out->head));
+    atomic_store(&link->in->head, atomic_load(&link->in->tail));
+    atomic_init(&link->unplugged, false);
+    return link;
+}
+
+void link_close(Link* link) {
+    if (!link) return;
+    link_unplug(link);
+    if (atomic_load(&link->in->pid) == 0) shm_unlink(link->name);   // Last one out
+    munmap(link->shared, sizeof(LinkShared));
+    free(link);
+}
+
+void link_unplug(Link* link) {
+    atomic_store(&link->unplugged, true);
+    atomic_store(&link->out->pid, 0);
+}
+
+void link_attach(Link* link, uint64_t cycles) {
+    uint64_t start = atomic_load(&link->in->pid) ? atomic_load_explicit(&link->in->time, memory_order_acquire) : 0;
+    link->base = cycles - start;
+    atomic_store_explicit(&link->out->time, start, memory_order_release);
+}
+
+uint64_t link_partner_time(Link* link) {
+    if (atomic_load_explicit(&link->unplugged, memory_order_relaxed) ||
+        atomic_load_explicit(&link->in->pid, memory_order_relaxed) == 0) {
+        return SCHED_NEVER;
+    }
+    return atomic_load_explicit(&link->in->time, memory_order_acquire) + link->base;
+}
+
+void link_publish(Link* link, uint64_t cycles) {
+    atomic_store_explicit(&link->out->time, cycles - link->base, memory_order_release);
+}
+
+void link_poll(Link* link) {
+    if (atomic_load_explicit(&link->unplugged, memory_order_relaxed)) return;
+
+    // Still read after the partner unplugs: it sent everything in the ring
+    // before that, and can't send more
+    LinkEnd* in = link->in;
+    uint32_t head = atomic_load_explicit(&in->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&in->tail, memory_order_acquire);
+    while (head != tail && link->pending_count < LINK_RING) {
+        const LinkMessage* m = &in->ring[head % LINK_RING];
+        uint64_t due = m->time + link->base;
+        if (m->kind == LINK_START) due += SERIAL_TRANSFER_CYCLES;
+        link->pending[link->pending_count++] = (LinkPending){ due, m->kind, m->value };
+        head++;
+    }
+    atomic_store_explicit(&in->head, head, memory_order_release);
+}
+
+void link_send(Link* link, LinkKind kind, uint64_t cycles, uint8_t value) {
+    LinkEnd* out = link->out;
+    uint32_t tail = atomic_load_explicit(&out->tail, memory_order_relaxed);
+
+    // The window keeps a few messages in flight at most; a full ring means
+    // the partner is busy draining it
+    while (tail - atomic_load_explicit(&out->head, memory_order_acquire) == LINK_RING) {
+        if (link_partner_time(link) == SCHED_NEVER) return;
+        sched_yield();
+    }
+    if (link_partner_time(link) == SCHED_NEVER) return;
+
+    out->ring[tail % LINK_RING] = (LinkMessage){ cycles - link->base, kind, value };
+    atomic_store_explicit(&out->tail, tail + 1, memory_order_release);
+}
+
+bool link_take(Link* link, LinkKind kind, uint64_t cycles, LinkPending* out) {
+    for (uint32_t i = 0; i < link->pending_count; i++) {
+        LinkPending* p = &link->pending[i];
+        if (p->kind != kind) continue;
+        if (p->due > cycles) return false;      // Same kind arrives in time order
+        *out = *p;
+        link->pending_count--;
+        for (; i < link->pending_count; i++) link->pending[i] = link->pending[i + 1];
+        return true;
+    }
+    return false;
+}
+
+uint64_t link_next_due(Link* link, LinkKind kind) {
+    for (uint32_t i = 0; i < link->pending_count; i++) {
+        if (link->pending[i].kind == kind) return link->pending[i].due;
+    }
+    return SCHED_NEVER;
+}
+
+void link_wait(Link* link, uint64_t seen) {
+    // Partners normally run on other cores and move on within microseconds
+    for (uint32_t spins = 0;; spins++) {
+        if (link_partner_time(link) != seen) return;
+        if (spins < LINK_SPINS) continue;
+
+        sched_yield();
+        if (spins % LINK_CHECK == 0) {
+            // A partner that died without unplugging would hold us forever
+            int32_t pid = atomic_load(&link->in->pid);
+            if (pid != 0 && !pid_alive(pid)) atomic_compare_exchange_strong(&link->in->pid, &pid, 0);
+        }
+    }
+}
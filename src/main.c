@@ -1,62 +1,369 @@
+#include <inttypes.h>
 #include <stdio.h>
-#include "cartridge.h"
-#include "cpu.h"
-#include "disassemble.h"
-#include "mmu.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include "block_cache.h"
+#include "frontend.h"
+#include "gameboy.h"
+#include "idle.h"
+#include "movie.h"
+#include "rom_index.h"
+#include "trace.h"
+
+// game.gb -> game.sav, next to the ROM
+static char* save_path(const char* rom)
+{
+    size_t length = strlen(rom);
+    char* path = malloc(length + 5);
+    if (!path) return NULL;
+    memcpy(path, rom, length + 1);
+
+    char* dot = strrchr(path, '.');
+    char* slash = strrchr(path, '/');
+    if (dot && (!slash || dot > slash)) *dot = '\0';
+    strcat(path, ".sav");
+    return path;
+}
+
+// Run the core untraced, a frame at a time, and report throughput
+static void run_mips(GameBoy* gb, long instructions, const char* mode)
+{
+    struct timespec start, end;
+    CPU* cpu = gb->cpu;
+    uint64_t first = cpu->instructions;
+    uint64_t cycles = gb_cycles(gb);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (cpu->instructions - first < (uint64_t)instructions) {
+        gb_run_frame(gb);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    uint64_t executed = cpu->instructions - first;
+    double mips = executed / seconds / 1e6;
+    double realtime = ((gb_cycles(gb) - cycles) / seconds) / GB_CLOCK_HZ;
+
+    printf("%s: %" PRIu64 " instructions in %.3fs\n", mode, executed, seconds);
+    printf("  %.1f MIPS, %.1fx real-time\n", mips, realtime);
+    if (cpu->idle.skipped) {
+        printf("  %.1f%% of cycles skipped idle\n", 100.0 * cpu->idle.skipped / gb_cycles(gb));
+    }
+    if (cpu->blocks) {
+        printf("  %" PRIu64 " blocks built, %" PRIu64 " invalidations, %" PRIu64 " flushes\n",
+               cpu->blocks->builds, cpu->blocks->invalidations, cpu->blocks->flushes);
+    }
+}
+
+static bool same_state(GameBoy* a, GameBoy* b)
+{
+    CPU* x = a->cpu;
+    CPU* y = b->cpu;
+    return x->a == y->a && cpu_get_f(x) == cpu_get_f(y) && x->b == y->b && x->c == y->c &&
+           x->d == y->d && x->e == y->e && x->h == y->h && x->l == y->l &&
+           x->pc == y->pc && x->sp == y->sp && x->ime == y->ime && x->halted == y->halted &&
+           x->cycles == y->cycles && x->instructions == y->instructions &&
+           memcmp(a->mmu->memory, b->mmu->memory, sizeof(a->mmu->memory)) == 0 &&
+           memcmp(gb_framebuffer(a), gb_framebuffer(b), sizeof(a->ppu->framebuffer)) == 0;
+}
+
+// Run gb (idle skipping as configured) against a reference instance that
+// steps through everything, comparing the full state after every frame
+static int idle_check(GameBoy* gb, const char* rom, long frames)
+{
+    int error;
+    GameBoy* ref = gb_create(rom, &error);
+    if (!ref) {
+        printf("%s: %s\n", rom, gb_error_string(error));
+        return 1;
+    }
+    gb_set_idle(ref, CPU_IDLE_OFF);
+    if (gb->cpu->blocks) cpu_set_mode(ref->cpu, CPU_MODE_CACHED);
+
+    int result = 0;
+    for (long i = 0; i < frames; i++) {
+        gb_run_frame(gb);
+        gb_run_frame(ref);
+        if (!same_state(gb, ref)) {
+            CPU* x = gb->cpu;
+            CPU* y = ref->cpu;
+            printf("idle check: diverged in frame %ld\n", i);
+            printf("  skip: PC=$%04X AF=%02X%02X cycles %" PRIu64 " instructions %" PRIu64 "\n",
+                   x->pc, x->a, cpu_get_f(x), x->cycles, x->instructions);
+            printf("  step: PC=$%04X AF=%02X%02X cycles %" PRIu64 " instructions %" PRIu64 "\n",
+                   y->pc, y->a, cpu_get_f(y), y->cycles, y->instructions);
+            result = 1;
+            break;
+        }
+    }
+    if (!result) {
+        printf("idle check: %ld frames identical, %.1f%% of cycles skipped\n",
+               frames, 100.0 * gb->cpu->idle.skipped / gb_cycles(gb));
+    }
+    gb_destroy(ref);
+    return result;
+}
+
+// Pick a ROM from a library index by list number or title prefix; NULL
+// (after saying why) if nothing or more than one title matches
+static const RomIndexEntry* index_select(const RomIndex* index, const char* name)
+{
+    char* end;
+    unsigned long number = strtoul(name, &end, 10);
+    if (*end == '\0' && number >= 1 && number <= index->count) return &index->entries[number - 1];
+
+    const RomIndexEntry* match = NULL;
+    size_t length = strlen(name);
+    for (uint32_t i = 0; i < index->count; i++) {
+        const RomIndexEntry* e = &index->entries[i];
+        if (strncasecmp(e->title, name, length < 16 ? length : 16) != 0) continue;
+        if (match) {
+            printf("%s: more than one title matches\n", name);
+            return NULL;
+        }
+        match = e;
+    }
+    if (!match) printf("%s: no such title in the index\n", name);
+    return match;
+}
+
+static void index_list(const RomIndex* index)
+{
+    for (uint32_t i = 0; i < index->count; i++) {
+        const RomIndexEntry* e = &index->entries[i];
+        char title[17];
+        rom_index_title(e, title);
+        printf("%4" PRIu32 ". %-16s %s\n", i + 1, title, rom_index_path(index, e));
+    }
+}
 
 int main(int argc, char **argv)
 {
+    // --index <file> lists a library index (tools/gameboy-index) without
+    // opening any ROM; a number or title after it launches that ROM with
+    // the remaining options
+    if (argc >= 3 && strcmp(argv[1], "--index") == 0) {
+        RomIndex* index = rom_index_open(argv[2]);
+        if (!index) {
+            printf("%s: could not read index\n", argv[2]);
+            return 1;
+        }
+        if (argc == 3) {
+            index_list(index);
+            rom_index_close(index);
+            return 0;
+        }
+        const RomIndexEntry* entry = index_select(index, argv[3]);
+        char* rom = entry ? strdup(rom_index_path(index, entry)) : NULL;
+        rom_index_close(index);
+        if (!rom) return 1;
+        argc -= 2;
+        argv += 2;
+        argv[1] = rom;
+    }
+
     if (argc < 2) {
-        printf("Usage <path/to/rom>\n");
+        printf("Usage <path/to/rom> [--cpu=interp|cached] [--mips [instructions]]\n"
+               "                    [--frames n] [--trace file] [--profile prefix] [--no-save]\n"
+               "                    [--idle=off|halt|full] [--idle-overrides file] [--idle-check]\n"
+               "                    [--window] [--speed=unlimited|n] [--frameskip=n] [--scale=n] [--mute] [--rewind]\n"
+               "                    [--record movie] [--hud] [--link name]\n"
+               "      --index <file> [number|title [options]]\n");
         return 0;
     } 
 
-    Cartridge* cart = load_rom(argv[1]);
-    // TODO: !cart
-    
-    // Init memory managment unit
-    MMU* mmu = mmu_create();
-    if (mmu_init(mmu, cart) == -1) return 0;
-
-    // Init cpu
-    CPU* cpu = cpu_create();
-    cpu_init(cpu, mmu);
-
-    int total_instructions = 100;
-    int total_cycles = 0;
-
-    printf("PC OP CYCLES AF:BC:DE:HL\n\n");
-
-    // execute 1st 10 ins
-    for (int i = 0; i < total_instructions; i++) {
-        uint16_t current_pc = cpu->pc;
-        int cycles = cpu_step(cpu);
-        total_cycles += cycles;
-
-        // Update timer with cycles that passed
-        // timer_step(timer, cycles);
-
-        // get the current opcode that was just executed
-        uint8_t opcode = mmu_read(mmu, current_pc);
-        printf("$%04X $%02X (%d) (%02X%02X-%02X%02X-%02X%02X-%02X%02X)\t",
-                current_pc, opcode, cycles,
-                cpu->a, cpu->f, cpu->b, cpu->c,
-                cpu->d, cpu->e, cpu->h, cpu->l);
-
-        // disassemble opcode
-        d_asm_opcode(opcode);
-        printf("\n");
-
-        // Stop if CPU halted
-        if (cpu->halted) {
-            printf("\nCPU halted at instruction %d\n", i + 1);
-            break;
+    int error;
+    GameBoy* gb = gb_create(argv[1], &error);
+    if (!gb) {
+        printf("%s: %s\n", argv[1], gb_error_string(error));
+        return 1;
+    }
+    print_header(gb->cart);
+
+    const char* mode = "interpreter";
+    long mips = 0;
+    long frames = 60;
+    const char* trace = NULL;
+    const char* profile = NULL;
+    const char* record = NULL;
+    const char* link = NULL;
+    bool battery = true;
+    bool check = false;
+    bool window = false;
+    bool frames_set = false;
+    FrontendOptions view = { .speed = 1.0, .frameskip = 1, .scale = 3, .audio = true };
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--cpu=cached") == 0) {
+            if (cpu_set_mode(gb->cpu, CPU_MODE_CACHED) != 0) {
+                printf("out of memory\n");
+                gb_destroy(gb);
+                return 1;
+            }
+            mode = "block cache";
+        } else if (strcmp(argv[i], "--cpu=interp") == 0) {
+            cpu_set_mode(gb->cpu, CPU_MODE_INTERPRETER);
+            mode = "interpreter";
+        } else if (strcmp(argv[i], "--mips") == 0) {
+            mips = 50000000;
+            if (i + 1 < argc && argv[i + 1][0] != '-') mips = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = atol(argv[++i]);
+            frames_set = true;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record = argv[++i];
+        } else if (strcmp(argv[i], "--link") == 0 && i + 1 < argc) {
+            link = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile = argv[++i];
+        } else if (strcmp(argv[i], "--no-save") == 0) {
+            battery = false;
+        } else if (strncmp(argv[i], "--idle=", 7) == 0) {
+            int idle = idle_mode_parse(argv[i] + 7);
+            if (idle < 0) {
+                printf("%s: expected off, halt or full\n", argv[i]);
+                gb_destroy(gb);
+                return 1;
+            }
+            gb_set_idle(gb, idle);
+        } else if (strcmp(argv[i], "--idle-overrides") == 0 && i + 1 < argc) {
+            if (gb_idle_overrides(gb, argv[++i]) < 0) {
+                printf("%s: could not read overrides\n", argv[i]);
+                gb_destroy(gb);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--idle-check") == 0) {
+            check = true;
+            battery = false;
+        } else if (strcmp(argv[i], "--window") == 0) {
+            window = true;
+        } else if (strncmp(argv[i], "--speed=", 8) == 0) {
+            // Multiple of real time; unlimited runs without any throttling
+            view.speed = strcmp(argv[i] + 8, "unlimited") == 0 ? 0 : atof(argv[i] + 8);
+            window = true;
+        } else if (strncmp(argv[i], "--frameskip=", 12) == 0) {
+            long n = atol(argv[i] + 12);
+            view.frameskip = n > 0 ? (uint32_t)n : 1;
+        } else if (strcmp(argv[i], "--rewind") == 0) {
+            view.rewind = true;
+            window = true;
+        } else if (strcmp(argv[i], "--hud") == 0) {
+            view.hud = true;
+            window = true;
+        } else if (strcmp(argv[i], "--mute") == 0) {
+            view.audio = false;
+        } else if (strncmp(argv[i], "--scale=", 8) == 0) {
+            view.scale = atoi(argv[i] + 8);
+        }
+    }
+
+    if (battery) {
+        char* path = save_path(argv[1]);
+        if (!path || gb_save_open(gb, path) != 0) {
+            printf("%s: could not open save file\n", path ? path : argv[1]);
+        }
+        free(path);
+    }
+
+    // Recorded from power-on, after the battery RAM is in place
+    Movie* movie = NULL;
+    if (record && !check && mips == 0) {
+        movie = movie_create(gb);
+        if (!movie) {
+            printf("out of memory\n");
+            gb_destroy(gb);
+            return 1;
+        }
+    }
+
+    // Plugged in last, right before running; the partner's history can't
+    // be rewound with ours
+    if (link && !check && mips == 0) {
+        if (gb_link_open(gb, link) != 0) {
+            printf("%s: could not open link (both ends in use?)\n", link);
+            movie_free(movie);
+            gb_destroy(gb);
+            return 1;
+        }
+        if (view.rewind) printf("rewind: not available with --link\n");
+        view.rewind = false;
+    }
+
+    if (check) {
+        int result = idle_check(gb, argv[1], frames);
+        gb_destroy(gb);
+        return result;
+    }
+
+    if (mips > 0) {
+        run_mips(gb, mips, mode);
+        gb_destroy(gb);
+        return 0;
+    }
+
+    // Headless run; the per-instruction log now comes from --trace + gbtrace
+    if (trace && gb_trace_start(gb, trace) != 0) {
+        printf("%s: could not start trace\n", trace);
+        gb_destroy(gb);
+        return 1;
+    }
+    if (profile && gb_profile_start(gb) != 0) {
+        printf("out of memory\n");
+        gb_destroy(gb);
+        return 1;
+    }
+    if (window) {
+        view.frames = frames_set ? frames : 0;
+        view.movie = movie;
+        if (frontend_run(gb, &view) != 0) {
+            movie_free(movie);
+            gb_destroy(gb);
+            return 1;
+        }
+    } else {
+        // Headless: --frameskip only saves pixel work, timing is unchanged
+        gb_set_frameskip(gb, view.frameskip);
+        for (long i = 0; i < frames; i++) {
+            if (movie) movie_add_frame(movie, gb->joypad->state);
+            gb_run_frame(gb);
+        }
+    }
+
+    if (movie) {
+        if (movie_write(movie, record) == 0) printf("movie: %u frames in %s\n", movie->frames, record);
+        else printf("%s: could not write movie\n", record);
+        movie_free(movie);
+    }
+
+    CPU* cpu = gb->cpu;
+    printf("%" PRIu64 " instructions, %" PRIu64 " cycles\n", cpu->instructions, gb_cycles(gb));
+    printf("PC=$%04X SP=$%04X AF:BC:DE:HL (%02X%02X-%02X%02X-%02X%02X-%02X%02X)%s\n",
+           cpu->pc, cpu->sp, cpu->a, cpu_get_f(cpu), cpu->b, cpu->c,
+           cpu->d, cpu->e, cpu->h, cpu->l, cpu->halted ? " halted" : "");
+    if (cpu->idle.skipped) {
+        printf("idle: %.1f%% of cycles skipped\n", 100.0 * cpu->idle.skipped / gb_cycles(gb));
+    }
+    if (cpu->trace && cpu->trace->stalls) {
+        printf("trace: CPU waited on the writer %" PRIu64 " times\n", cpu->trace->stalls);
+    }
+    int result = 0;
+    if (trace && gb_trace_stop(gb) != 0) {
+        printf("%s: write error, trace is incomplete\n", trace);
+        result = 1;
+    }
+
+    if (profile) {
+        if (gb_profile_write(gb, profile) == 0) {
+            printf("profile: %s.txt, %s.folded\n", profile, profile);
+        } else {
+            printf("%s: could not write profile\n", profile);
         }
     }
 
     // Cleanup
-    cpu_free(cpu);
-    mmu_free(mmu);
-    cartridge_free(cart);
-    return 0;
+    gb_destroy(gb);
+    return result;
 }
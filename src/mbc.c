@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <string.h>
+#include "mbc.h"
+#include "mmu.h"
+
+MBC* mbc_alloc(Cartridge* cart, MMU* mmu, size_t ram_size, size_t type_size) {
+    MBC* mbc = calloc(1, sizeof(MBC));
+    if (!mbc) return NULL;
+
+    mbc->read_rom = mbc_read_rom;
+    mbc->read_ram = mbc_read_ram;
+    mbc->write_ram = mbc_write_ram;
+    mbc->cart = cart;
+    mbc->mmu = mmu;
+    mbc->battery = mbc_has_battery(cart->cartridge_type);
+
+    // Bank pointers must always cover 16KB, so a truncated last bank (or a
+    // ROM under 32KB) gets a padded copy instead of per-read bounds checks
+    size_t banks = (cart->size + MBC_ROM_BANK_SIZE - 1) / MBC_ROM_BANK_SIZE;
+    if (banks < 2) banks = 2;
+    mbc->rom_banks = banks;
+    if (banks * MBC_ROM_BANK_SIZE == cart->size) {
+        mbc->rom = cart->data;
+    } else {
+        mbc->rom_copy = malloc(banks * MBC_ROM_BANK_SIZE);
+        if (!mbc->rom_copy) {
+            mbc_free(mbc);
+            return NULL;
+        }
+        memset(mbc->rom_copy, 0xFF, banks * MBC_ROM_BANK_SIZE);
+        memcpy(mbc->rom_copy, cart->data, cart->size);
+        mbc->rom = mbc->rom_copy;
+    }
+
+    if (ram_size) {
+        mbc->ram_data = calloc(1, ram_size);
+        mbc->ram_size = ram_size;
+    }
+    if (type_size) {
+        mbc->type_data = calloc(1, type_size);
+        mbc->type_size = type_size;
+    }
+    if ((ram_size && !mbc->ram_data) || (type_size && !mbc->type_data)) {
+        mbc_free(mbc);
+        return NULL;
+    }
+    return mbc;
+}
+
+void mbc_free(MBC* mbc) {
+    if (!mbc) return;
+    free(mbc->type_data);
+    free(mbc->rom_copy);
+    if (!mbc->ram_file) free(mbc->ram_data);
+    free(mbc);
+}
+
+size_t mbc_ram_size(uint8_t code) {
+    switch (code) {
+        case 0x01: return 0x800;
+        case 0x02: return 0x2000;
+        case 0x03: return 0x8000;
+        case 0x04: return 0x20000;
+        case 0x05: return 0x10000;
+        default: return 0;
+    }
+}
+
+bool mbc_has_battery(uint8_t type) {
+    switch (type) {
+        case 0x03: case 0x06: case 0x09:
+        case 0x0F: case 0x10: case 0x13:
+        case 0x1B: case 0x1E:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void mbc_remap_ram(MBC* mbc) {
+    // RAM smaller than a bank (2KB) is mirrored across the window
+    uint8_t* read = mbc->ram_bank;
+    uint8_t* write = mbc->ram_protect ? NULL : read;
+    uint32_t chunk = read && mbc->ram_size < MBC_RAM_BANK_SIZE ? mbc->ram_size : MBC_RAM_BANK_SIZE;
+    for (uint32_t offset = 0; offset < MBC_RAM_BANK_SIZE; offset += chunk) {
+        mmu_map_pages(mbc->mmu, 0xA000 + offset, chunk, read, write);
+    }
+}
+
+void mbc_set_ram(MBC* mbc, uint8_t* data) {
+    size_t bank = mbc->ram_bank ? (size_t)(mbc->ram_bank - mbc->ram_data) : 0;
+    if (!mbc->ram_file) free(mbc->ram_data);
+    mbc->ram_data = data;
+    mbc->ram_file = true;
+    mbc->ram_protect = true;
+    if (mbc->ram_bank) {
+        mbc->ram_bank = data + bank;
+        mbc_remap_ram(mbc);
+    }
+}
+
+void mbc_protect_ram(MBC* mbc) {
+    mbc->ram_protect = true;
+    if (mbc->ram_bank) mbc_remap_ram(mbc);
+}
+
+void mbc_map_rom(MBC* mbc, uint32_t low, uint32_t high) {
+    const uint8_t* rom_low = mbc->rom + (size_t)(low % mbc->rom_banks) * MBC_ROM_BANK_SIZE;
+    const uint8_t* rom_high = mbc->rom + (size_t)(high % mbc->rom_banks) * MBC_ROM_BANK_SIZE;
+
+    // Remapping bumps code_gen, so leave unchanged banks alone
+    if (rom_low != mbc->rom_low) {
+        mbc->rom_low = rom_low;
+        mmu_map_rom(mbc->mmu, 0x0000, rom_low);
+    }
+    if (rom_high != mbc->rom_high) {
+        mbc->rom_high = rom_high;
+        mmu_map_rom(mbc->mmu, 0x4000, rom_high);
+    }
+}
+
+void mbc_map_ram(MBC* mbc, bool enabled, uint32_t bank) {
+    uint8_t* ram_bank = NULL;
+    if (enabled && mbc->ram_size) {
+        uint32_t banks = mbc->ram_size / MBC_RAM_BANK_SIZE;
+        ram_bank = mbc->ram_data + (banks ? bank % banks : 0) * MBC_RAM_BANK_SIZE;
+    }
+    if (ram_bank == mbc->ram_bank) return;
+    mbc->ram_bank = ram_bank;
+    mbc_remap_ram(mbc);
+}
+
+uint8_t mbc_read_rom(MBC* mbc, uint16_t address) {
+    if (address < 0x4000) return mbc->rom_low[address];
+    return mbc->rom_high[address - 0x4000];
+}
+
+// Only reached while the window is unmapped; kept general for callers
+// that bypass the page tables
+uint8_t mbc_read_ram(MBC* mbc, uint16_t address) {
+    if (mbc->ram_bank) return mbc->ram_bank[(address - 0xA000) % mbc->ram_size];
+    return 0xFF;
+}
+
+// Also the first write to protected battery RAM: mark it dirty and map the
+// window writable until the next flush
+void mbc_write_ram(MBC* mbc, uint16_t address, uint8_t value) {
+    if (!mbc->ram_bank) return;
+    mbc->ram_bank[(address - 0xA000) % mbc->ram_size] = value;
+    if (mbc->ram_protect) {
+        mbc->ram_dirty = true;
+        mbc->ram_protect = false;
+        mbc_remap_ram(mbc);
+    }
+}
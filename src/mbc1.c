@@ -0,0 +1,59 @@
+#include <string.h>
+#include "mbc.h"
+#include "mmu.h"
+
+// MBC1: 5-bit ROM bank register, 2-bit secondary register used as ROM bank
+// bits 5-6 or as the RAM bank depending on the mode. Multicarts (MBC1M)
+// wire the secondary register to bits 4-5 instead.
+typedef struct {
+    uint8_t ram_enable;
+    uint8_t bank1;      // 2000-3FFF, 5 bits
+    uint8_t bank2;      // 4000-5FFF, 2 bits
+    uint8_t mode;       // 6000-7FFF: 1 = bank2 also applies to 0000-3FFF and RAM
+    uint8_t shift;      // 5, or 4 on multicarts
+} MBC1;
+
+MBC* mbc1_create(Cartridge* cart, MMU* mmu);
+void mbc1_write_rom(MBC* mbc, uint16_t address, uint8_t value);
+
+// Multicarts are 1MB with a second Nintendo logo at the start of game 1 (bank 0x10)
+static bool mbc1_is_multicart(Cartridge* cart) {
+    return cart->size == 0x100000 &&
+           memcmp(cart->data + 0x40104, nintendo_logo, sizeof(nintendo_logo)) == 0;
+}
+
+static void mbc1_update(MBC* mbc) {
+    MBC1* regs = mbc->type_data;
+    uint8_t low = regs->mode ? regs->bank2 << regs->shift : 0;
+    uint8_t bank1 = regs->bank1 ? regs->bank1 : 1;      // zero check is on all 5 bits
+    if (regs->shift == 4) bank1 &= 0x0F;
+    uint8_t high = (regs->bank2 << regs->shift) | bank1;
+
+    mbc_map_rom(mbc, low, high);
+    mbc_map_ram(mbc, regs->ram_enable, regs->mode ? regs->bank2 : 0);
+}
+
+MBC* mbc1_create(Cartridge* cart, MMU* mmu) {
+    size_t ram_size = cart->cartridge_type == 0x01 ? 0 : mbc_ram_size(cart->ram_size);
+    MBC* mbc = mbc_alloc(cart, mmu, ram_size, sizeof(MBC1));
+    if (!mbc) return NULL;
+
+    mbc->write_rom = mbc1_write_rom;
+
+    MBC1* regs = mbc->type_data;
+    regs->bank1 = 1;
+    regs->shift = mbc1_is_multicart(cart) ? 4 : 5;
+    mbc1_update(mbc);
+    return mbc;
+}
+
+void mbc1_write_rom(MBC* mbc, uint16_t address, uint8_t value) {
+    MBC1* regs = mbc->type_data;
+    switch (address >> 13) {
+        case 0: regs->ram_enable = (value & 0x0F) == 0x0A; break;
+        case 1: regs->bank1 = value & 0x1F; break;
+        case 2: regs->bank2 = value & 0x03; break;
+        case 3: regs->mode = value & 0x01; break;
+    }
+    mbc1_update(mbc);
+}
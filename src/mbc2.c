@@ -0,0 +1,56 @@
+#include "mbc.h"
+#include "mmu.h"
+
+// MBC2: 4-bit ROM bank and 512 x 4-bit built-in RAM, mirrored across
+// A000-BFFF. The nibble RAM stays on the slow path (upper bits read as 1).
+#define MBC2_RAM_SIZE 0x200
+
+typedef struct {
+    uint8_t ram_enable;
+    uint8_t rom_bank;
+} MBC2;
+
+MBC* mbc2_create(Cartridge* cart, MMU* mmu);
+void mbc2_write_rom(MBC* mbc, uint16_t address, uint8_t value);
+uint8_t mbc2_read_ram(MBC* mbc, uint16_t address);
+void mbc2_write_ram(MBC* mbc, uint16_t address, uint8_t value);
+
+MBC* mbc2_create(Cartridge* cart, MMU* mmu) {
+    MBC* mbc = mbc_alloc(cart, mmu, MBC2_RAM_SIZE, sizeof(MBC2));
+    if (!mbc) return NULL;
+
+    mbc->write_rom = mbc2_write_rom;
+    mbc->read_ram = mbc2_read_ram;
+    mbc->write_ram = mbc2_write_ram;
+
+    MBC2* regs = mbc->type_data;
+    regs->rom_bank = 1;
+    mbc_map_rom(mbc, 0, 1);
+    return mbc;
+}
+
+void mbc2_write_rom(MBC* mbc, uint16_t address, uint8_t value) {
+    MBC2* regs = mbc->type_data;
+    if (address >= 0x4000) return;
+
+    // Address bit 8 selects the register
+    if (address & 0x0100) {
+        regs->rom_bank = (value & 0x0F) ? (value & 0x0F) : 1;
+        mbc_map_rom(mbc, 0, regs->rom_bank);
+    } else {
+        regs->ram_enable = (value & 0x0F) == 0x0A;
+    }
+}
+
+uint8_t mbc2_read_ram(MBC* mbc, uint16_t address) {
+    MBC2* regs = mbc->type_data;
+    if (!regs->ram_enable) return 0xFF;
+    return mbc->ram_data[address & (MBC2_RAM_SIZE - 1)] | 0xF0;
+}
+
+void mbc2_write_ram(MBC* mbc, uint16_t address, uint8_t value) {
+    MBC2* regs = mbc->type_data;
+    if (!regs->ram_enable) return;
+    mbc->ram_data[address & (MBC2_RAM_SIZE - 1)] = value & 0x0F;
+    mbc->ram_dirty = true;
+}
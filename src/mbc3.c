@@ -0,0 +1,171 @@
+#include <time.h>
+#include "cpu.h"
+#include "mbc.h"
+#include "mmu.h"
+
+// MBC3: 7-bit ROM bank, 4 RAM banks, and on timer carts a real-time clock
+// mapped at A000-BFFF in place of RAM. The clock runs on emulated time
+// (the master clock), so runs stay reproducible.
+#define MBC3_CYCLES_PER_SECOND 4194304
+
+// .sav footer in the common VBA/BGB layout: live and latched registers as
+// little-endian 32-bit words, then a 64-bit UNIX timestamp. The timestamp is
+// written for other emulators; on load the clock resumes where it stopped.
+#define MBC3_FOOTER_SIZE 48
+
+enum { RTC_S, RTC_M, RTC_H, RTC_DL, RTC_DH };
+
+#define RTC_DH_DAY8   0x01
+#define RTC_DH_HALT   0x40
+#define RTC_DH_CARRY  0x80
+
+static const uint8_t rtc_masks[5] = { 0x3F, 0x3F, 0x1F, 0xFF, 0xC1 };
+
+typedef struct {
+    uint8_t ram_enable;
+    uint8_t rom_bank;
+    uint8_t select;         // 4000-5FFF: 00-03 RAM bank, 08-0C RTC register
+    uint8_t latch;          // Last value written to 6000-7FFF
+    bool has_rtc;
+    uint8_t rtc[5];         // Live S, M, H, DL, DH
+    uint8_t latched[5];     // Snapshot visible to reads
+    uint64_t rtc_cycles;    // Master clock the live registers are current to
+} MBC3;
+
+MBC* mbc3_create(Cartridge* cart, MMU* mmu);
+void mbc3_write_rom(MBC* mbc, uint16_t address, uint8_t value);
+uint8_t mbc3_read_ram(MBC* mbc, uint16_t address);
+void mbc3_write_ram(MBC* mbc, uint16_t address, uint8_t value);
+void mbc3_save_footer(MBC* mbc, uint8_t* footer);
+void mbc3_load_footer(MBC* mbc, const uint8_t* footer);
+
+// Bring the live registers up to the current master clock
+static void mbc3_rtc_sync(MBC* mbc) {
+    MBC3* regs = mbc->type_data;
+    uint64_t now = mbc->mmu->cpu->cycles;
+    if (regs->rtc[RTC_DH] & RTC_DH_HALT) {
+        regs->rtc_cycles = now;
+        return;
+    }
+
+    uint64_t seconds = (now - regs->rtc_cycles) / MBC3_CYCLES_PER_SECOND;
+    if (!seconds) return;
+    regs->rtc_cycles += seconds * MBC3_CYCLES_PER_SECOND;
+
+    uint64_t s = regs->rtc[RTC_S] + seconds;
+    uint64_t m = regs->rtc[RTC_M] + s / 60;
+    uint64_t h = regs->rtc[RTC_H] + m / 60;
+    uint64_t days = (((regs->rtc[RTC_DH] & RTC_DH_DAY8) << 8) | regs->rtc[RTC_DL]) + h / 24;
+
+    regs->rtc[RTC_S] = s % 60;
+    regs->rtc[RTC_M] = m % 60;
+    regs->rtc[RTC_H] = h % 24;
+    regs->rtc[RTC_DL] = days & 0xFF;
+    regs->rtc[RTC_DH] = (regs->rtc[RTC_DH] & ~RTC_DH_DAY8) | ((days >> 8) & RTC_DH_DAY8);
+    if (days > 0x1FF) regs->rtc[RTC_DH] |= RTC_DH_CARRY;
+}
+
+static void mbc3_update(MBC* mbc) {
+    MBC3* regs = mbc->type_data;
+    mbc_map_rom(mbc, 0, regs->rom_bank ? regs->rom_bank : 1);
+    mbc_map_ram(mbc, regs->ram_enable && regs->select < 0x04, regs->select);
+}
+
+MBC* mbc3_create(Cartridge* cart, MMU* mmu) {
+    uint8_t type = cart->cartridge_type;
+    bool has_ram = type == 0x10 || type == 0x12 || type == 0x13;
+    MBC* mbc = mbc_alloc(cart, mmu, has_ram ? mbc_ram_size(cart->ram_size) : 0, sizeof(MBC3));
+    if (!mbc) return NULL;
+
+    mbc->write_rom = mbc3_write_rom;
+    mbc->read_ram = mbc3_read_ram;
+    mbc->write_ram = mbc3_write_ram;
+
+    MBC3* regs = mbc->type_data;
+    regs->rom_bank = 1;
+    regs->latch = 0xFF;
+    regs->has_rtc = type == 0x0F || type == 0x10;
+    regs->rtc_cycles = mmu->cpu->cycles;
+    if (regs->has_rtc) {
+        mbc->save_footer = mbc3_save_footer;
+        mbc->load_footer = mbc3_load_footer;
+        mbc->footer_size = MBC3_FOOTER_SIZE;
+    }
+    mbc3_update(mbc);
+    return mbc;
+}
+
+void mbc3_write_rom(MBC* mbc, uint16_t address, uint8_t value) {
+    MBC3* regs = mbc->type_data;
+    switch (address >> 13) {
+        case 0:
+            regs->ram_enable = (value & 0x0F) == 0x0A;
+            break;
+        case 1:
+            regs->rom_bank = value & 0x7F;
+            break;
+        case 2:
+            regs->select = value & 0x0F;
+            break;
+        case 3:
+            // Writing 00 then 01 copies the live clock into the latch
+            if (regs->has_rtc && regs->latch == 0x00 && value == 0x01) {
+                mbc3_rtc_sync(mbc);
+                for (int i = 0; i < 5; i++) regs->latched[i] = regs->rtc[i];
+            }
+            regs->latch = value;
+            return;
+    }
+    mbc3_update(mbc);
+}
+
+// Reached for RTC registers and while RAM is disabled
+uint8_t mbc3_read_ram(MBC* mbc, uint16_t address) {
+    MBC3* regs = mbc->type_data;
+    if (regs->ram_enable && regs->has_rtc && regs->select >= 0x08 && regs->select <= 0x0C) {
+        return regs->latched[regs->select - 0x08];
+    }
+    return mbc_read_ram(mbc, address);
+}
+
+void mbc3_write_ram(MBC* mbc, uint16_t address, uint8_t value) {
+    MBC3* regs = mbc->type_data;
+    if (regs->ram_enable && regs->has_rtc && regs->select >= 0x08 && regs->select <= 0x0C) {
+        int index = regs->select - 0x08;
+        mbc3_rtc_sync(mbc);
+        if (index == RTC_S) regs->rtc_cycles = mbc->mmu->cpu->cycles;   // Restarts the second
+        regs->rtc[index] = value & rtc_masks[index];
+        mbc->ram_dirty = true;
+        return;
+    }
+    mbc_write_ram(mbc, address, value);
+}
+
+static void put_le(uint8_t* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) out[i] = value >> (i * 8);
+}
+
+static uint64_t get_le(const uint8_t* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) value |= (uint64_t)in[i] << (i * 8);
+    return value;
+}
+
+void mbc3_save_footer(MBC* mbc, uint8_t* footer) {
+    MBC3* regs = mbc->type_data;
+    mbc3_rtc_sync(mbc);
+    for (int i = 0; i < 5; i++) {
+        put_le(footer + i * 4, regs->rtc[i], 4);
+        put_le(footer + 20 + i * 4, regs->latched[i], 4);
+    }
+    put_le(footer + 40, (uint64_t)time(NULL), 8);
+}
+
+void mbc3_load_footer(MBC* mbc, const uint8_t* footer) {
+    MBC3* regs = mbc->type_data;
+    for (int i = 0; i < 5; i++) {
+        regs->rtc[i] = get_le(footer + i * 4, 4) & rtc_masks[i];
+        regs->latched[i] = get_le(footer + 20 + i * 4, 4) & rtc_masks[i];
+    }
+    regs->rtc_cycles = mbc->mmu->cpu->cycles;
+}
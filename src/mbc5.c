@@ -0,0 +1,51 @@
+#include "mbc.h"
+#include "mmu.h"
+
+// MBC5: 9-bit ROM bank (bank 0 selectable at 4000-7FFF) and 4-bit RAM bank.
+// On rumble carts RAM bank bit 3 drives the motor instead.
+typedef struct {
+    uint8_t ram_enable;
+    uint16_t rom_bank;
+    uint8_t ram_bank;
+    uint8_t ram_mask;   // 0x07 with rumble, else 0x0F
+} MBC5;
+
+MBC* mbc5_create(Cartridge* cart, MMU* mmu);
+void mbc5_write_rom(MBC* mbc, uint16_t address, uint8_t value);
+
+MBC* mbc5_create(Cartridge* cart, MMU* mmu) {
+    uint8_t type = cart->cartridge_type;
+    bool has_ram = type == 0x1A || type == 0x1B || type == 0x1D || type == 0x1E;
+    MBC* mbc = mbc_alloc(cart, mmu, has_ram ? mbc_ram_size(cart->ram_size) : 0, sizeof(MBC5));
+    if (!mbc) return NULL;
+
+    mbc->write_rom = mbc5_write_rom;
+
+    MBC5* regs = mbc->type_data;
+    regs->rom_bank = 1;
+    regs->ram_mask = type >= 0x1C ? 0x07 : 0x0F;
+    mbc_map_rom(mbc, 0, 1);
+    return mbc;
+}
+
+void mbc5_write_rom(MBC* mbc, uint16_t address, uint8_t value) {
+    MBC5* regs = mbc->type_data;
+    switch (address >> 12) {
+        case 0: case 1:
+            regs->ram_enable = (value & 0x0F) == 0x0A;
+            break;
+        case 2:
+            regs->rom_bank = (regs->rom_bank & 0x100) | value;
+            break;
+        case 3:
+            regs->rom_bank = (regs->rom_bank & 0xFF) | ((value & 0x01) << 8);
+            break;
+        case 4: case 5:
+            regs->ram_bank = value & regs->ram_mask;
+            break;
+        default:
+            return;
+    }
+    mbc_map_rom(mbc, 0, regs->rom_bank);
+    mbc_map_ram(mbc, regs->ram_enable, regs->ram_bank);
+}
@@ -1,7 +1,8 @@
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
 
+#include "block_cache.h"
+#include "cpu.h"
 #include "mmu.h"
 
 MMU* mmu_create(void) {
@@ -17,13 +18,9 @@ int mmu_init(MMU* mmu, Cartridge* cart) {
     memset(mmu->memory, 0, sizeof(mmu->memory));
 
     // Set up some default register values
-    mmu->memory[0xFF05] = 0x00;  // TIMA
-    mmu->memory[0xFF06] = 0x00;  // TMA
-    mmu->memory[0xFF07] = 0x00;  // TAC
-    mmu->memory[0xFF40] = 0x91;  // LCDC
+    // (timer and LCDC/STAT/LY/LYC are owned by Timer and PPU)
     mmu->memory[0xFF42] = 0x00;  // SCY
     mmu->memory[0xFF43] = 0x00;  // SCX
-    mmu->memory[0xFF45] = 0x00;  // LYC
     mmu->memory[0xFF47] = 0xFC;  // BGP
     mmu->memory[0xFF48] = 0xFF;  // OBP0
     mmu->memory[0xFF49] = 0xFF;  // OBP1
@@ -31,39 +28,152 @@ int mmu_init(MMU* mmu, Cartridge* cart) {
     mmu->memory[0xFF4B] = 0x00;  // WX
     mmu->memory[0xFFFF] = 0x00;  // IE
 
+    // Internal memory is plain RAM; ROM, cart RAM and I/O start unmapped
+    memset(mmu->read_page, 0, sizeof(mmu->read_page));
+    memset(mmu->write_page, 0, sizeof(mmu->write_page));
+    mmu_map_pages(mmu, 0x8000, 0x2000, &mmu->memory[0x8000], &mmu->memory[0x8000]); // VRAM
+    mmu_map_pages(mmu, 0xC000, 0x2000, &mmu->memory[0xC000], &mmu->memory[0xC000]); // WRAM
+    mmu_map_pages(mmu, 0xE000, 0x1E00, &mmu->memory[0xC000], &mmu->memory[0xC000]); // Echo RAM
+    mmu_map_pages(mmu, 0xFE00, 0x0100, &mmu->memory[0xFE00], &mmu->memory[0xFE00]); // OAM
+
     // Create appropriate MBC based on cartridge type
     switch(cart->cartridge_type) {
         case 0x00:  // ROM ONLY
-            mmu->mbc = mbc_none_create(cart);
-            printf("Cartridge Type (type 0x00)\n");
-            return 0;
+        case 0x08:  // ROM + RAM
+        case 0x09:  // ROM + RAM + BATTERY
+            mmu->mbc = mbc_none_create(cart, mmu);
             break;
             
         case 0x01:  // MBC1
         case 0x02:  // MBC1 + RAM
         case 0x03:  // MBC1 + RAM + BATTERY
-            // mmu->mbc = mbc1_create(cart);  // Implement later
-            printf("Cartridge Type NOT Implemented(type 0x%02X)\n",cart->cartridge_type);
-            mmu->mbc = mbc_none_create(cart);
-            return 0;
+            mmu->mbc = mbc1_create(cart, mmu);
+            break;
+
+        case 0x05:  // MBC2
+        case 0x06:  // MBC2 + BATTERY
+            mmu->mbc = mbc2_create(cart, mmu);
+            break;
+
+        case 0x0F:  // MBC3 + TIMER + BATTERY
+        case 0x10:  // MBC3 + TIMER + RAM + BATTERY
+        case 0x11:  // MBC3
+        case 0x12:  // MBC3 + RAM
+        case 0x13:  // MBC3 + RAM + BATTERY
+            mmu->mbc = mbc3_create(cart, mmu);
+            break;
+
+        case 0x19: case 0x1A: case 0x1B:    // MBC5 (+ RAM + BATTERY)
+        case 0x1C: case 0x1D: case 0x1E:    // MBC5 + RUMBLE (+ RAM + BATTERY)
+            mmu->mbc = mbc5_create(cart, mmu);
             break;
             
         default:
-            printf("Cartridge Type NOT Implemented(type 0x%02X)\n",cart->cartridge_type);
+            // Cartridge type not implemented
             return -1;
-            break;
     }
+    return mmu->mbc ? 0 : -1;
 }
 
 void mmu_free(MMU* mmu) {
-    if (mmu->mbc) {
-        free(mmu->mbc->ram_data);
-        free(mmu->mbc);
-    }
+    mbc_free(mmu->mbc);
     free(mmu);
 }
 
-uint8_t mmu_read(MMU* mmu, uint16_t address) {
+void mmu_map_pages(MMU* mmu, uint16_t address, uint32_t size, const uint8_t* read, uint8_t* write) {
+    unsigned first = address >> MMU_PAGE_SHIFT;
+    unsigned count = size >> MMU_PAGE_SHIFT;
+
+    for (unsigned i = 0; i < count; i++) {
+        unsigned offset = i << MMU_PAGE_SHIFT;
+        mmu->read_page[first + i] = read ? read + offset : NULL;
+        mmu->write_page[first + i] = write ? write + offset : NULL;
+    }
+    mmu->code_gen++;
+}
+
+void mmu_map_rom(MMU* mmu, uint16_t address, const uint8_t* bank) {
+    const uint8_t** pages = &mmu->read_page[address >> MMU_PAGE_SHIFT];
+    for (unsigned i = 0; i < MBC_ROM_BANK_SIZE >> MMU_PAGE_SHIFT; i++) {
+        pages[i] = bank + (i << MMU_PAGE_SHIFT);
+    }
+    mmu->code_gen++;
+}
+
+static inline uint64_t mmu_now(MMU* mmu) {
+    return mmu->cpu->cycles;
+}
+
+static void mmu_start_dma(MMU* mmu, uint8_t source) {
+    uint16_t base = source << 8;
+    for (int i = 0; i < 0xA0; i++) {
+        mmu->memory[0xFE00 + i] = mmu_read(mmu, base + i);
+    }
+    mmu->dma_active = true;
+    sched_post(mmu->sched, SCHED_DMA, mmu_now(mmu) + MMU_DMA_CYCLES);
+}
+
+void mmu_dma_event(MMU* mmu) {
+    mmu->dma_active = false;
+}
+
+void mmu_serial_event(MMU* mmu, uint8_t in) {
+    serial_complete(mmu->serial, in);
+    mmu->memory[0xFF0F] |= INT_SERIAL;
+}
+
+static uint8_t mmu_read_io(MMU* mmu, uint16_t address) {
+    if (address >= 0xFF10 && address <= 0xFF3F) {
+        return apu_read(mmu->apu, address, mmu_now(mmu));
+    }
+    switch (address) {
+        case 0xFF00: return joypad_read(mmu->joypad);
+        case 0xFF01: return mmu->serial->sb;
+        case 0xFF02: return serial_read_sc(mmu->serial);
+        case 0xFF04: case 0xFF05: case 0xFF06: case 0xFF07:
+            return timer_read(mmu->timer, address, mmu_now(mmu));
+        case 0xFF0F: return mmu->memory[address] | 0xE0;
+        case 0xFF40: case 0xFF41: case 0xFF44: case 0xFF45:
+            return ppu_read(mmu->ppu, address);
+        default: return mmu->memory[address];
+    }
+}
+
+static void mmu_write_io(MMU* mmu, uint16_t address, uint8_t value) {
+    if (address >= 0xFF10 && address <= 0xFF3F) {
+        apu_write(mmu->apu, address, value, mmu_now(mmu));
+        return;
+    }
+    switch (address) {
+        case 0xFF00:
+            joypad_write(mmu->joypad, value);
+            break;
+        case 0xFF01:
+            mmu->serial->sb = value;
+            break;
+        case 0xFF02:
+            if (serial_write_sc(mmu->serial, value)) {
+                sched_post(mmu->sched, SCHED_SERIAL, mmu_now(mmu) + SERIAL_TRANSFER_CYCLES);
+                if (mmu->link) link_send(mmu->link, LINK_START, mmu_now(mmu), mmu->serial->sb);
+            }
+            break;
+        case 0xFF04: case 0xFF05: case 0xFF06: case 0xFF07:
+            timer_write(mmu->timer, address, value, mmu_now(mmu));
+            break;
+        case 0xFF40: case 0xFF41: case 0xFF44: case 0xFF45:
+            ppu_write(mmu->ppu, address, value, mmu_now(mmu));
+            break;
+        case 0xFF46:
+            mmu->memory[address] = value;
+            mmu_start_dma(mmu, value);
+            break;
+        default:
+            mmu->memory[address] = value;
+            break;
+    }
+}
+
+uint8_t mmu_read_slow(MMU* mmu, uint16_t address) {
     // Handle different memory areas
     if (address < 0x8000) {
         // ROM area - delegate to MBC
@@ -74,12 +184,12 @@ uint8_t mmu_read(MMU* mmu, uint16_t address) {
         return mmu->mbc->read_ram(mmu->mbc, address);
     } 
     else {
-        // Internal memory (VRAM, WRAM, OAM, IO, HRAM)
-        return mmu->memory[address];
+        // I/O registers, HRAM, IE
+        return mmu_read_io(mmu, address);
     }
 }
 
-void mmu_write(MMU* mmu, uint16_t address, uint8_t value) {
+void mmu_write_slow(MMU* mmu, uint16_t address, uint8_t value) {
     // Handle ROM area writes (for banking)
     if (address < 0x8000) {
         // Delegate to MBC (may change banking)
@@ -90,20 +200,16 @@ void mmu_write(MMU* mmu, uint16_t address, uint8_t value) {
         // External RAM writes
         mmu->mbc->write_ram(mmu->mbc, address, value);
         return;
-    } 
-    else {
-        // Internal memory writes
+    }
+    else if (address < 0xFE00) {
+        // VRAM/WRAM page write-protected because it holds cached code
+        if (address >= 0xE000) address -= 0x2000;   // Echo RAM
+        if (mmu->blocks) block_cache_write(mmu->blocks, address);
         mmu->memory[address] = value;
     }
-}
-
-uint16_t mmu_read16(MMU* mmu, uint16_t address) {
-    uint8_t low = mmu_read(mmu, address);
-    uint8_t high = mmu_read(mmu, address + 1);
-    return (high << 8) | low;
-}
-
-void mmu_write16(MMU* mmu, uint16_t address, uint16_t value) {
-    mmu_write(mmu, address, value & 0xFF);
-    mmu_write(mmu, address + 1, value >> 8);
+    else {
+        // I/O registers, HRAM, IE
+        if (mmu->blocks && address >= 0xFF80) block_cache_write(mmu->blocks, address);
+        mmu_write_io(mmu, address, value);
+    }
 }
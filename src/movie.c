@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash.h"
+#include "movie.h"
+
+static uint64_t rom_hash(GameBoy* gb) {
+    return hash64(gb->cart->data, gb->cart->size, 0);
+}
+
+Movie* movie_create(GameBoy* gb) {
+    Movie* movie = calloc(1, sizeof(Movie));
+    if (!movie) return NULL;
+    movie->rom_hash = rom_hash(gb);
+
+    // Battery RAM is the one input a power-on doesn't reset
+    MBC* mbc = gb->mmu->mbc;
+    if (mbc->battery) {
+        movie->battery_size = mbc->ram_size + mbc->footer_size;
+        movie->battery = malloc(movie->battery_size ? movie->battery_size : 1);
+        if (!movie->battery) {
+            movie_free(movie);
+            return NULL;
+        }
+        memcpy(movie->battery, mbc->ram_data, mbc->ram_size);
+        if (mbc->save_footer) mbc->save_footer(mbc, movie->battery + mbc->ram_size);
+    }
+    return movie;
+}
+
+void movie_free(Movie* movie) {
+    if (!movie) return;
+    free(movie->battery);
+    free(movie->buttons);
+    free(movie);
+}
+
+int movie_add_frame(Movie* movie, uint8_t buttons) {
+    if (movie->frames == movie->capacity) {
+        uint32_t capacity = movie->capacity ? movie->capacity * 2 : 4096;
+        uint8_t* grown = realloc(movie->buttons, capacity);
+        if (!grown) return -1;
+        movie->buttons = grown;
+        movie->capacity = capacity;
+    }
+    movie->buttons[movie->frames++] = buttons;
+    return 0;
+}
+
+void movie_truncate(Movie* movie, uint32_t frames) {
+    if (frames < movie->frames) movie->frames = frames;
+}
+
+int movie_write(const Movie* movie, const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return -1;
+
+    MovieHeader header = {
+        .rom_hash = movie->rom_hash,
+        .frames = movie->frames,
+        .battery_size = (uint32_t)movie->battery_size,
+    };
+    memcpy(header.magic, MOVIE_MAGIC, sizeof(header.magic));
+    fwrite(&header, sizeof(header), 1, f);
+    if (movie->battery_size) fwrite(movie->battery, 1, movie->battery_size, f);
+
+    // Held buttons change a few times a second at most, so runs are short
+    for (uint32_t i = 0; i < movie->frames;) {
+        uint8_t buttons = movie->buttons[i];
+        uint32_t run = 1;
+        while (i + run < movie->frames && movie->buttons[i + run] == buttons) run++;
+        i += run;
+
+        fputc(buttons, f);
+        while (run >= 0x80) {
+            fputc((run & 0x7F) | 0x80, f);
+            run >>= 7;
+        }
+        fputc(run, f);
+    }
+
+    bool ok = !ferror(f);
+    if (fclose(f) != 0) ok = false;
+    return ok ? 0 : -1;
+}
+
+int movie_read(const char* path, Movie** out) {
+    *out = NULL;
+    FILE* f = fopen(path, "rb");
+    if (!f) return MOVIE_ERR_OPEN;
+
+    MovieHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        memcmp(header.magic, MOVIE_MAGIC, sizeof(header.magic)) != 0) {
+        fclose(f);
+        return MOVIE_ERR_OPEN;
+    }
+
+    Movie* movie = calloc(1, sizeof(Movie));
+    if (movie) {
+        movie->rom_hash = header.rom_hash;
+        movie->battery_size = header.battery_size;
+        movie->battery = malloc(header.battery_size ? header.battery_size : 1);
+        movie->buttons = malloc(header.frames ? header.frames : 1);
+        movie->capacity = header.frames;
+    }
+    if (!movie || !movie->battery || !movie->buttons) {
+        movie_free(movie);
+        fclose(f);
+        return MOVIE_ERR_NOMEM;
+    }
+
+    int result = MOVIE_OK;
+    if (fread(movie->battery, 1, movie->battery_size, f) != movie->battery_size) result = MOVIE_ERR_OPEN;
+    while (result == MOVIE_OK && movie->frames < header.frames) {
+        int buttons = fgetc(f);
+        uint32_t run = 0;
+        int shift = 0, byte;
+        do {
+            byte = fgetc(f);
+            run |= (uint32_t)(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte != EOF && (byte & 0x80) && shift < 32);
+
+        if (buttons == EOF || byte == EOF || run == 0 || run > header.frames - movie->frames) {
+            result = MOVIE_ERR_OPEN;
+            break;
+        }
+        memset(movie->buttons + movie->frames, buttons, run);
+        movie->frames += run;
+    }
+    fclose(f);
+
+    if (result != MOVIE_OK) {
+        movie_free(movie);
+        return result;
+    }
+    *out = movie;
+    return MOVIE_OK;
+}
+
+int movie_start(const Movie* movie, GameBoy* gb) {
+    if (movie->rom_hash != rom_hash(gb)) return MOVIE_ERR_ROM;
+
+    MBC* mbc = gb->mmu->mbc;
+    if (!movie->battery_size) return MOVIE_OK;
+    if (!mbc->battery || movie->battery_size != mbc->ram_size + mbc->footer_size) return MOVIE_ERR_BATTERY;
+
+    memcpy(mbc->ram_data, movie->battery, mbc->ram_size);
+    if (mbc->load_footer) mbc->load_footer(mbc, movie->battery + mbc->ram_size);
+    return MOVIE_OK;
+}
+
+const char* movie_error_string(int error) {
+    switch (error) {
+        case MOVIE_OK:          return "ok";
+        case MOVIE_ERR_OPEN:    return "not a readable movie file";
+        case MOVIE_ERR_NOMEM:   return "out of memory";
+        case MOVIE_ERR_ROM:     return "recorded with a different ROM";
+        case MOVIE_ERR_BATTERY: return "battery RAM doesn't match the cartridge";
+        default:                return "unknown error";
+    }
+}
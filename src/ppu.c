@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+#include "mmu.h"
+#include "ppu.h"
+
+PPU* ppu_create(void) {
+    PPU* ppu = malloc(sizeof(PPU));
+    if (ppu) memset(ppu, 0, sizeof(PPU));
+    return ppu;
+}
+
+void ppu_init(PPU* ppu, MMU* mmu, Scheduler* sched) {
+    ppu->mmu = mmu;
+    ppu->sched = sched;
+    ppu->lcdc = 0x91;
+    ppu->stat = 0x00;
+    ppu->lyc = 0x00;
+    ppu->ly = 0;
+    ppu->mode = PPU_MODE_OAM;
+    ppu->stat_line = false;
+    ppu->render_mode = PPU_RENDER_SCANLINE;
+    ppu->render_period = 1;
+    ppu->frame = 0;
+    ppu->render = true;
+    ppu_render_init(ppu);
+    ppu_clear(ppu);
+
+    // LCD is on after boot: start a frame at cycle 0
+    sched_post(sched, SCHED_PPU, PPU_OAM_CYCLES);
+}
+
+void ppu_free(PPU* ppu) {
+    free(ppu);
+}
+
+// Re-evaluate the STAT interrupt line and fire on a rising edge
+static void ppu_update_stat(PPU* ppu) {
+    bool line = false;
+    if ((ppu->stat & 0x40) && ppu->ly == ppu->lyc) line = true;
+    switch (ppu->mode) {
+        case PPU_MODE_HBLANK: if (ppu->stat & 0x08) line = true; break;
+        case PPU_MODE_VBLANK: if (ppu->stat & 0x10) line = true; break;
+        case PPU_MODE_OAM:    if (ppu->stat & 0x20) line = true; break;
+        default: break;
+    }
+
+    if (line && !ppu->stat_line) {
+        ppu->mmu->memory[0xFF0F] |= INT_STAT;
+    }
+    ppu->stat_line = line;
+}
+
+uint8_t ppu_read(PPU* ppu, uint16_t address) {
+    switch (address) {
+        case 0xFF40: return ppu->lcdc;
+        case 0xFF41: {
+            uint8_t mode = (ppu->lcdc & 0x80) ? ppu->mode : 0;
+            uint8_t coincidence = (ppu->ly == ppu->lyc) ? 0x04 : 0;
+            return 0x80 | ppu->stat | coincidence | mode;
+        }
+        case 0xFF44: return ppu->ly;
+        default:     return ppu->lyc;
+    }
+}
+
+void ppu_write(PPU* ppu, uint16_t address, uint8_t value, uint64_t now) {
+    switch (address) {
+        case 0xFF40: {
+            bool was_on = ppu->lcdc & 0x80;
+            ppu->lcdc = value;
+            if (was_on && !(value & 0x80)) {
+                // LCD off: LY resets and the PPU goes idle
+                sched_cancel(ppu->sched, SCHED_PPU);
+                ppu->ly = 0;
+                ppu->mode = PPU_MODE_HBLANK;
+                ppu_clear(ppu);
+            } else if (!was_on && (value & 0x80)) {
+                // LCD on: restart at the top of a frame
+                ppu->ly = 0;
+                ppu->mode = PPU_MODE_OAM;
+                ppu->window_line = 0;
+                ppu->window_active = false;
+                ppu->frame = 0;
+                ppu->render = true;
+                sched_post(ppu->sched, SCHED_PPU, now + PPU_OAM_CYCLES);
+            }
+            break;
+        }
+        case 0xFF41:
+            ppu->stat = value & 0x78;
+            break;
+        case 0xFF44:
+            return;     // LY is read-only
+        default:
+            ppu->lyc = value;
+            break;
+    }
+    if (ppu->lcdc & 0x80) ppu_update_stat(ppu);
+}
+
+void ppu_event(PPU* ppu, uint64_t when) {
+    switch (ppu->mode) {
+        case PPU_MODE_OAM:
+            ppu->mode = PPU_MODE_TRANSFER;
+            if (!ppu->render) {
+                // Same mode 3 length, one event, no pixels
+                ppu_skip_line(ppu);
+                ppu->x = PPU_WIDTH;
+                sched_post(ppu->sched, SCHED_PPU, when + PPU_TRANSFER_CYCLES);
+                break;
+            }
+            ppu_scan_oam(ppu);
+            if (ppu->render_mode == PPU_RENDER_FIFO) {
+                ppu->x = 0;
+                sched_post(ppu->sched, SCHED_PPU, when + PPU_FIFO_DELAY);
+            } else {
+                ppu_render_line(ppu);
+                ppu->x = PPU_WIDTH;
+                sched_post(ppu->sched, SCHED_PPU, when + PPU_TRANSFER_CYCLES);
+            }
+            break;
+
+        case PPU_MODE_TRANSFER:
+            if (ppu->render_mode == PPU_RENDER_FIFO && ppu->x < PPU_WIDTH) {
+                // 8 pixels per step; the last step lands on the end of mode 3
+                ppu_render_span(ppu, ppu->x, ppu->x + 8);
+                ppu->x += 8;
+                sched_post(ppu->sched, SCHED_PPU, when + 8);
+                return;
+            }
+            if (ppu->window_active) {
+                ppu->window_line++;
+                ppu->window_active = false;
+            }
+            ppu->mode = PPU_MODE_HBLANK;
+            sched_post(ppu->sched, SCHED_PPU, when + PPU_HBLANK_CYCLES);
+            break;
+
+        case PPU_MODE_HBLANK:
+            ppu->ly++;
+            if (ppu->ly == PPU_VBLANK_LINE) {
+                ppu->mode = PPU_MODE_VBLANK;
+                ppu->mmu->memory[0xFF0F] |= INT_VBLANK;
+                if (ppu->render) {
+                    // Frames end on fixed cycle counts, not here, so the
+                    // finished picture is kept apart from the next one
+                    memcpy(ppu->picture, ppu->framebuffer, sizeof(ppu->picture));
+                    ppu->frames_drawn++;
+                }
+                sched_post(ppu->sched, SCHED_PPU, when + PPU_LINE_CYCLES);
+            } else {
+                ppu->mode = PPU_MODE_OAM;
+                sched_post(ppu->sched, SCHED_PPU, when + PPU_OAM_CYCLES);
+            }
+            break;
+
+        case PPU_MODE_VBLANK:
+            ppu->ly++;
+            if (ppu->ly == PPU_LINES) {
+                ppu->ly = 0;
+                ppu->window_line = 0;
+                ppu->frame++;
+                ppu->render = ppu->frame % ppu->render_period == 0;
+                ppu->mode = PPU_MODE_OAM;
+                sched_post(ppu->sched, SCHED_PPU, when + PPU_OAM_CYCLES);
+            } else {
+                sched_post(ppu->sched, SCHED_PPU, when + PPU_LINE_CYCLES);
+            }
+            break;
+    }
+    ppu_update_stat(ppu);
+}
@@ -0,0 +1,323 @@
+#include <string.h>
+#include "mmu.h"
+#include "ppu.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PPU_X86 1
+#endif
+
+// Register addresses read straight from MMU::memory
+#define REG_SCY   0xFF42
+#define REG_SCX   0xFF43
+#define REG_BGP   0xFF47
+#define REG_OBP0  0xFF48
+#define REG_OBP1  0xFF49
+#define REG_WY    0xFF4A
+#define REG_WX    0xFF4B
+
+// Sprite attribute bits
+#define OBJ_PALETTE   0x10
+#define OBJ_XFLIP     0x20
+#define OBJ_YFLIP     0x40
+#define OBJ_BEHIND    0x80
+
+void ppu_render_init(PPU* ppu) {
+    // DMG shades, lightest first
+    ppu->colors[0] = 0xFFFFFFFF;
+    ppu->colors[1] = 0xFFAAAAAA;
+    ppu->colors[2] = 0xFF555555;
+    ppu->colors[3] = 0xFF000000;
+    ppu->window_line = 0;
+    ppu->window_active = false;
+    ppu->sprite_count = 0;
+    ppu->x = 0;
+
+#ifdef PPU_X86
+    ppu->simd = __builtin_cpu_supports("ssse3");
+#else
+    ppu->simd = false;
+#endif
+}
+
+void ppu_clear(PPU* ppu) {
+    for (int i = 0; i < PPU_WIDTH * PPU_HEIGHT; i++) {
+        ppu->framebuffer[i] = ppu->colors[0];
+        ppu->picture[i] = ppu->colors[0];
+    }
+}
+
+// Row 'row' of a BG/window tile, honouring the LCDC tile data select
+static inline const uint8_t* bg_tile_row(const uint8_t* mem, uint8_t lcdc, uint8_t tile, int row) {
+    uint16_t base = (lcdc & 0x10) ? 0x8000 + tile * 16 : 0x9000 + (int8_t)tile * 16;
+    return &mem[base + row * 2];
+}
+
+static inline uint8_t reverse_bits(uint8_t b) {
+    b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+    b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+    b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+    return b;
+}
+
+// Spread the 8 bits of a tile byte into 8 bytes, leftmost pixel (bit 7) first
+static inline uint64_t spread_bits(uint8_t b) {
+    uint64_t x = ((b * 0x8040201008040201ULL) >> 7) & 0x0101010101010101ULL;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    x = __builtin_bswap64(x);
+#endif
+    return x;
+}
+
+// 2bpp row (low plane, high plane) -> 8 colour indices
+static inline void decode_row(uint8_t lo, uint8_t hi, uint8_t* out) {
+    uint64_t pixels = spread_bits(lo) | spread_bits(hi) << 1;
+    memcpy(out, &pixels, 8);
+}
+
+// Two tile rows -> 16 colour indices
+static inline void decode_pair(const uint8_t* a, const uint8_t* b, uint8_t* out) {
+#ifdef __SSE2__
+    // Broadcast each plane byte across its tile's half, test one bit per lane
+    const __m128i bit = _mm_set1_epi64x(0x0102040810204080LL);
+    __m128i lo = _mm_unpacklo_epi64(_mm_set1_epi8(a[0]), _mm_set1_epi8(b[0]));
+    __m128i hi = _mm_unpacklo_epi64(_mm_set1_epi8(a[1]), _mm_set1_epi8(b[1]));
+    lo = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(lo, bit), bit), _mm_set1_epi8(1));
+    hi = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(hi, bit), bit), _mm_set1_epi8(2));
+    _mm_storeu_si128((__m128i*)out, _mm_or_si128(lo, hi));
+#else
+    decode_row(a[0], a[1], out);
+    decode_row(b[0], b[1], out + 8);
+#endif
+}
+
+// Decode 'count' tiles of one tile map row starting at column 'col'.
+// Writes count rounded up to even tiles.
+static void fetch_tiles(const uint8_t* mem, uint8_t lcdc, uint16_t map_row, int col, int row, int count, uint8_t* out) {
+    for (int i = 0; i < count; i += 2) {
+        const uint8_t* a = bg_tile_row(mem, lcdc, mem[map_row + ((col + i) & 31)], row);
+        const uint8_t* b = bg_tile_row(mem, lcdc, mem[map_row + ((col + i + 1) & 31)], row);
+        decode_pair(a, b, out + i * 8);
+    }
+}
+
+static inline bool window_visible(PPU* ppu, const uint8_t* mem) {
+    return (ppu->lcdc & 0x21) == 0x21 && ppu->ly >= mem[REG_WY] && mem[REG_WX] <= 166;
+}
+
+void ppu_skip_line(PPU* ppu) {
+    if (window_visible(ppu, ppu->mmu->memory)) ppu->window_active = true;
+}
+
+// Palette lookup for a line: BG/window colour indices 0-3 go through BGP,
+// sprite pixels are coded 4-7 (OBP0) or 8-11 (OBP1), so one table lookup
+// shades a line of both. Codes past 11 are not produced.
+#define OBJ_CODE(obj)   (((obj)[3] & OBJ_PALETTE) ? 8 : 4)
+
+static inline void palette_table(const uint8_t* mem, uint8_t table[16]) {
+    const uint8_t palettes[3] = { mem[REG_BGP], mem[REG_OBP0], mem[REG_OBP1] };
+    memset(table, 0, 16);
+    for (int i = 0; i < 12; i++) table[i] = (palettes[i >> 2] >> ((i & 3) * 2)) & 3;
+}
+
+#ifdef PPU_X86
+// count is rounded up to 16; both buffers must have room for that
+__attribute__((target("ssse3")))
+static void apply_palette_ssse3(const uint8_t* code, const uint8_t table[16], uint8_t* shade, int count) {
+    const __m128i lookup = _mm_loadu_si128((const __m128i*)table);
+    for (int x = 0; x < count; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)&code[x]);
+        _mm_storeu_si128((__m128i*)&shade[x], _mm_shuffle_epi8(lookup, v));
+    }
+}
+#endif
+
+static inline void apply_palette(PPU* ppu, const uint8_t* code, const uint8_t table[16], uint8_t* shade, int count) {
+#ifdef PPU_X86
+    if (ppu->simd) {
+        apply_palette_ssse3(code, table, shade, count);
+        return;
+    }
+#endif
+    (void)ppu;
+    for (int x = 0; x < count; x++) shade[x] = table[code[x]];
+}
+
+#ifdef PPU_X86
+// Four shades -> four ARGB pixels: byte k of pixel i comes from colors[s_i] byte k
+__attribute__((target("ssse3")))
+static inline __m128i shades_to_argb4(__m128i colors, __m128i shades) {
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+    const __m128i lane = _mm_setr_epi8(0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3);
+    __m128i index = _mm_shuffle_epi8(shades, spread);
+    index = _mm_add_epi8(_mm_slli_epi16(index, 2), lane);
+    return _mm_shuffle_epi8(colors, index);
+}
+
+__attribute__((target("ssse3")))
+static void output_line_ssse3(const uint8_t* shade, const uint32_t* colors, uint32_t* out) {
+    const __m128i table = _mm_loadu_si128((const __m128i*)colors);
+    for (int x = 0; x < PPU_WIDTH; x += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i*)&shade[x]);
+        _mm_storeu_si128((__m128i*)&out[x + 0], shades_to_argb4(table, s));
+        _mm_storeu_si128((__m128i*)&out[x + 4], shades_to_argb4(table, _mm_srli_si128(s, 4)));
+        _mm_storeu_si128((__m128i*)&out[x + 8], shades_to_argb4(table, _mm_srli_si128(s, 8)));
+        _mm_storeu_si128((__m128i*)&out[x + 12], shades_to_argb4(table, _mm_srli_si128(s, 12)));
+    }
+}
+#endif
+
+void ppu_scan_oam(PPU* ppu) {
+    const uint8_t* oam = &ppu->mmu->memory[0xFE00];
+    int height = (ppu->lcdc & 0x04) ? 16 : 8;
+    int count = 0;
+
+    // First 10 sprites in OAM order that cover this line, kept sorted by X
+    // (lower X wins; OAM order breaks ties)
+    for (int i = 0; i < 40 && count < PPU_MAX_SPRITES; i++) {
+        int y = oam[i * 4] - 16;
+        if (ppu->ly < y || ppu->ly >= y + height) continue;
+
+        int pos = count++;
+        while (pos > 0 && oam[ppu->sprites[pos - 1] * 4 + 1] > oam[i * 4 + 1]) {
+            ppu->sprites[pos] = ppu->sprites[pos - 1];
+            pos--;
+        }
+        ppu->sprites[pos] = i;
+    }
+    ppu->sprite_count = count;
+}
+
+// The 8 colour indices of a sprite on the current line, flips applied
+static void sprite_row(PPU* ppu, const uint8_t* obj, uint8_t* out) {
+    const uint8_t* mem = ppu->mmu->memory;
+    int height = (ppu->lcdc & 0x04) ? 16 : 8;
+    int row = ppu->ly - (obj[0] - 16);
+    uint8_t tile = obj[2];
+
+    if (obj[3] & OBJ_YFLIP) row = height - 1 - row;
+    if (height == 16) tile &= 0xFE;
+
+    const uint8_t* data = &mem[0x8000 + tile * 16 + row * 2];
+    uint8_t lo = data[0], hi = data[1];
+    if (obj[3] & OBJ_XFLIP) {
+        lo = reverse_bits(lo);
+        hi = reverse_bits(hi);
+    }
+    decode_row(lo, hi, out);
+}
+
+void ppu_render_line(PPU* ppu) {
+    const uint8_t* mem = ppu->mmu->memory;
+    uint8_t lcdc = ppu->lcdc;
+    uint8_t code[PPU_WIDTH];            // BG/window colour indices, then sprite codes
+    uint8_t shade[PPU_WIDTH];
+    uint8_t tiles[PPU_WIDTH + 16];      // 22 decoded tiles
+
+    // Background
+    if (lcdc & 0x01) {
+        uint8_t scx = mem[REG_SCX];
+        uint8_t y = ppu->ly + mem[REG_SCY];
+        uint16_t map = (lcdc & 0x08) ? 0x9C00 : 0x9800;
+        fetch_tiles(mem, lcdc, map + (y >> 3) * 32, scx >> 3, y & 7, 21, tiles);
+        memcpy(code, tiles + (scx & 7), PPU_WIDTH);
+    } else {
+        memset(code, 0, PPU_WIDTH);
+    }
+
+    // Window overwrites the BG from WX-7 to the right edge
+    if (window_visible(ppu, mem)) {
+        int start = mem[REG_WX] - 7;
+        int skip = start < 0 ? -start : 0;
+        uint16_t map = (lcdc & 0x40) ? 0x9C00 : 0x9800;
+        uint8_t wl = ppu->window_line;
+        fetch_tiles(mem, lcdc, map + (wl >> 3) * 32, 0, wl & 7, (PPU_WIDTH - start + 7) / 8, tiles);
+        memcpy(code + start + skip, tiles + skip, PPU_WIDTH - start - skip);
+        ppu->window_active = true;
+    }
+
+    // Sprites in priority order; the first opaque pixel at each X wins
+    if (lcdc & 0x02) {
+        uint8_t taken[PPU_WIDTH];
+        memset(taken, 0, sizeof(taken));
+        for (int i = 0; i < ppu->sprite_count; i++) {
+            const uint8_t* obj = &mem[0xFE00 + ppu->sprites[i] * 4];
+            uint8_t base = OBJ_CODE(obj);
+            uint8_t pixels[8];
+            sprite_row(ppu, obj, pixels);
+
+            for (int p = 0; p < 8; p++) {
+                int x = obj[1] - 8 + p;
+                if (x < 0 || x >= PPU_WIDTH || !pixels[p] || taken[x]) continue;
+                taken[x] = 1;
+                if ((obj[3] & OBJ_BEHIND) && code[x]) continue;    // Still the BG index
+                code[x] = base | pixels[p];
+            }
+        }
+    }
+
+    // One palette lookup for BG, window and sprites, then shades -> ARGB
+    uint8_t table[16];
+    palette_table(mem, table);
+    apply_palette(ppu, code, table, shade, PPU_WIDTH);
+
+    uint32_t* out = &ppu->framebuffer[ppu->ly * PPU_WIDTH];
+#ifdef PPU_X86
+    if (ppu->simd) {
+        output_line_ssse3(shade, ppu->colors, out);
+        return;
+    }
+#endif
+    for (int x = 0; x < PPU_WIDTH; x++) out[x] = ppu->colors[shade[x]];
+}
+
+// Colour index of one BG/window pixel
+static inline uint8_t bg_pixel(const uint8_t* mem, uint8_t lcdc, uint16_t map, uint8_t px, uint8_t py) {
+    uint8_t tile = mem[map + (py >> 3) * 32 + (px >> 3)];
+    const uint8_t* data = bg_tile_row(mem, lcdc, tile, py & 7);
+    int bit = 7 - (px & 7);
+    return ((data[0] >> bit) & 1) | (((data[1] >> bit) & 1) << 1);
+}
+
+void ppu_render_span(PPU* ppu, int x0, int x1) {
+    const uint8_t* mem = ppu->mmu->memory;
+    uint8_t lcdc = ppu->lcdc;
+    uint8_t scx = mem[REG_SCX], scy = mem[REG_SCY];
+    bool window = window_visible(ppu, mem);
+    int window_x = mem[REG_WX] - 7;
+    uint32_t* out = &ppu->framebuffer[ppu->ly * PPU_WIDTH];
+    uint8_t code[PPU_WIDTH + 16];       // Room for the lookup's last 16 bytes
+    uint8_t shade[PPU_WIDTH + 16];
+
+    for (int x = x0; x < x1; x++) {
+        uint8_t index = 0;
+        if (window && x >= window_x) {
+            uint16_t map = (lcdc & 0x40) ? 0x9C00 : 0x9800;
+            index = bg_pixel(mem, lcdc, map, x - window_x, ppu->window_line);
+            ppu->window_active = true;
+        } else if (lcdc & 0x01) {
+            uint16_t map = (lcdc & 0x08) ? 0x9C00 : 0x9800;
+            index = bg_pixel(mem, lcdc, map, x + scx, ppu->ly + scy);
+        }
+        code[x - x0] = index;
+
+        if (lcdc & 0x02) {
+            for (int i = 0; i < ppu->sprite_count; i++) {
+                const uint8_t* obj = &mem[0xFE00 + ppu->sprites[i] * 4];
+                int p = x - (obj[1] - 8);
+                if (p < 0 || p >= 8) continue;
+
+                uint8_t pixels[8];
+                sprite_row(ppu, obj, pixels);
+                if (!pixels[p]) continue;
+                if (!(obj[3] & OBJ_BEHIND) || !index) code[x - x0] = OBJ_CODE(obj) | pixels[p];
+                break;
+            }
+        }
+    }
+
+    uint8_t table[16];
+    palette_table(mem, table);
+    apply_palette(ppu, code, table, shade, x1 - x0);
+    for (int x = x0; x < x1; x++) out[x] = ppu->colors[shade[x - x0]];
+}
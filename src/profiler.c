@@ -0,0 +1,555 @@
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include "disassemble.h"
+#include "profiler.h"
+
+#define PROFILE_ROOT     0xFFFFFFFFu    // Node key for code outside any call
+#define REPORT_LOOPS     20
+#define REPORT_LISTINGS  8              // Loops shown with their disassembly
+#define REPORT_BLOCKS    20
+#define REPORT_EDGES     20
+#define LOOP_MAX_BYTES   0x200          // Longer backward branches are not loops
+
+// Control flow classes, for the shadow stack and block boundaries
+enum {
+    OP_PLAIN = 0,
+    OP_CALL,        // CALL, CALL cc, RST
+    OP_RET,         // RET, RET cc, RETI
+    OP_JUMP,        // JR, JP (cc), JP HL
+    OP_STOP,        // HALT, STOP
+};
+
+static int op_class(uint8_t opcode) {
+    switch (opcode) {
+    case 0xCD: case 0xC4: case 0xCC: case 0xD4: case 0xDC:
+        return OP_CALL;
+    case 0xC9: case 0xD9: case 0xC0: case 0xC8: case 0xD0: case 0xD8:
+        return OP_RET;
+    case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+    case 0xC3: case 0xC2: case 0xCA: case 0xD2: case 0xDA: case 0xE9:
+        return OP_JUMP;
+    case 0x76: case 0x10:
+        return OP_STOP;
+    }
+    return (opcode & 0xC7) == 0xC7 ? OP_CALL : OP_PLAIN;
+}
+
+Profiler* profiler_create(MMU* mmu) {
+    Profiler* prof = calloc(1, sizeof(Profiler));
+    if (!prof) return NULL;
+
+    prof->mmu = mmu;
+    prof->rom = mmu->cart->data;
+    prof->rom_size = mmu->cart->size;
+    prof->banks = (prof->rom_size + D_ASM_BANK_SIZE - 1) / D_ASM_BANK_SIZE;
+    if (prof->banks < 2) prof->banks = 2;
+
+    prof->low = calloc(0x10000, sizeof(ProfileEntry));
+    prof->bank = calloc(prof->banks, sizeof(ProfileEntry*));
+    prof->node_cap = 256;
+    prof->nodes = malloc(prof->node_cap * sizeof(ProfileNode));
+    if (!prof->low || !prof->bank || !prof->nodes) {
+        profiler_free(prof);
+        return NULL;
+    }
+
+    prof->nodes[0] = (ProfileNode){ .function = PROFILE_ROOT, .parent = -1, .child = -1, .sibling = -1 };
+    prof->node_count = 1;
+    prof->stack[0] = (ProfileFrame){ .node = 0, .slot = 0xFFFF };
+    prof->depth = 1;
+    return prof;
+}
+
+void profiler_free(Profiler* prof) {
+    if (!prof) return;
+    if (prof->bank) {
+        for (uint32_t i = 0; i < prof->banks; i++) free(prof->bank[i]);
+    }
+    free(prof->bank);
+    free(prof->low);
+    free(prof->nodes);
+    free(prof);
+}
+
+// Switchable-bank addresses are told apart by where the page table points
+static ProfileKey profiler_key(Profiler* prof, uint16_t pc) {
+    if ((pc & 0xC000) != 0x4000) return pc;
+    const uint8_t* page = prof->mmu->read_page[pc >> MMU_PAGE_SHIFT];
+    uint32_t bank = 1;
+    if (page && page >= prof->rom && page < prof->rom + prof->rom_size) {
+        bank = (page - prof->rom) / D_ASM_BANK_SIZE;
+    }
+    return PROFILE_KEY(bank, pc);
+}
+
+static ProfileEntry* profiler_entry(Profiler* prof, ProfileKey key) {
+    uint16_t pc = PROFILE_PC(key);
+    uint32_t bank = PROFILE_BANK(key);
+    if ((pc & 0xC000) != 0x4000 || bank >= prof->banks) return &prof->low[pc];
+
+    if (!prof->bank[bank]) {
+        prof->bank[bank] = calloc(D_ASM_BANK_SIZE, sizeof(ProfileEntry));
+        if (!prof->bank[bank]) return &prof->low[pc];
+    }
+    return &prof->bank[bank][pc - 0x4000];
+}
+
+// Without an entry table the lookup is for the report only
+static const ProfileEntry* profiler_find(Profiler* prof, ProfileKey key) {
+    uint16_t pc = PROFILE_PC(key);
+    uint32_t bank = PROFILE_BANK(key);
+    if ((pc & 0xC000) != 0x4000 || bank >= prof->banks) return &prof->low[pc];
+    return prof->bank[bank] ? &prof->bank[bank][pc - 0x4000] : NULL;
+}
+
+// Find or add the child of parent for function; folds into parent when full
+static int32_t profiler_child(Profiler* prof, int32_t parent, ProfileKey function) {
+    for (int32_t i = prof->nodes[parent].child; i >= 0; i = prof->nodes[i].sibling) {
+        if (prof->nodes[i].function == function) return i;
+    }
+
+    if (prof->node_count == prof->node_cap) {
+        ProfileNode* nodes = realloc(prof->nodes, prof->node_cap * 2 * sizeof(ProfileNode));
+        if (!nodes) return parent;
+        prof->nodes = nodes;
+        prof->node_cap *= 2;
+    }
+
+    int32_t index = prof->node_count++;
+    prof->nodes[index] = (ProfileNode){
+        .function = function,
+        .parent = parent,
+        .child = -1,
+        .sibling = prof->nodes[parent].child,
+    };
+    prof->nodes[parent].child = index;
+    return index;
+}
+
+static void profiler_push(Profiler* prof, uint16_t target, uint16_t slot) {
+    if (prof->depth == PROFILE_MAX_DEPTH) {
+        prof->overflow++;
+        return;
+    }
+    int32_t node = profiler_child(prof, prof->stack[prof->depth - 1].node, profiler_key(prof, target));
+    prof->nodes[node].calls++;
+    prof->stack[prof->depth++] = (ProfileFrame){ .node = node, .slot = slot };
+}
+
+// A RET consumes the return address at sp. Frames below that slot had their
+// return address discarded (POP + JP tricks) and are unwound as well; a RET
+// through an address the code pushed itself matches no frame and is a jump.
+static void profiler_pop(Profiler* prof, uint16_t sp) {
+    while (prof->depth > 1 && prof->stack[prof->depth - 1].slot < sp) prof->depth--;
+    if (prof->depth > 1 && prof->stack[prof->depth - 1].slot == sp) prof->depth--;
+}
+
+void profiler_step(Profiler* prof, uint16_t pc, uint8_t opcode, uint16_t sp, uint16_t next_pc, int cycles) {
+    ProfileEntry* entry = profiler_entry(prof, profiler_key(prof, pc));
+    entry->instructions++;
+    entry->cycles += cycles;
+    prof->nodes[prof->stack[prof->depth - 1].node].cycles += cycles;
+    prof->instructions++;
+    prof->cycles += cycles;
+
+    int kind = op_class(opcode);
+    if (kind == OP_PLAIN) return;
+
+    uint16_t fallthrough = pc + d_asm_length(opcode);
+    if (next_pc == fallthrough) return;     // Not taken
+
+    if (kind == OP_CALL) {
+        profiler_push(prof, next_pc, sp - 2);
+    } else if (kind == OP_RET) {
+        profiler_pop(prof, sp);
+    } else if (kind == OP_JUMP && next_pc <= pc && pc - next_pc < LOOP_MAX_BYTES) {
+        entry->back_taken++;
+    }
+}
+
+void profiler_halt(Profiler* prof, uint16_t pc, int cycles) {
+    profiler_entry(prof, profiler_key(prof, pc))->halt_cycles += cycles;
+    prof->nodes[prof->stack[prof->depth - 1].node].cycles += cycles;
+    prof->cycles += cycles;
+}
+
+void profiler_interrupt(Profiler* prof, uint16_t vector, uint16_t sp, int cycles) {
+    profiler_push(prof, vector, sp - 2);
+    prof->nodes[prof->stack[prof->depth - 1].node].cycles += cycles;
+    prof->cycles += cycles;
+}
+
+// Report
+
+// Readable bytes at key: the ROM bank it was profiled in, or RAM as it is now
+static size_t profiler_code(Profiler* prof, ProfileKey key, const uint8_t** code) {
+    uint16_t pc = PROFILE_PC(key);
+    if (pc >= 0x8000) {
+        const uint8_t* page = prof->mmu->read_page[pc >> MMU_PAGE_SHIFT];
+        *code = page ? page + (pc & (MMU_PAGE_SIZE - 1)) : &prof->mmu->memory[pc];
+        return MMU_PAGE_SIZE - (pc & (MMU_PAGE_SIZE - 1));
+    }
+
+    size_t offset = pc < 0x4000 ? pc : PROFILE_BANK(key) * D_ASM_BANK_SIZE + (pc - 0x4000);
+    size_t end = (offset / D_ASM_BANK_SIZE + 1) * D_ASM_BANK_SIZE;
+    if (end > prof->rom_size) end = prof->rom_size;
+    if (offset >= end) return 0;
+    *code = prof->rom + offset;
+    return end - offset;
+}
+
+static void profiler_name(ProfileKey key, char* buf, size_t size) {
+    static const char* const vectors[] = { "int_vblank", "int_stat", "int_timer", "int_serial", "int_joypad" };
+    uint16_t pc = PROFILE_PC(key);
+    uint32_t bank = PROFILE_BANK(key);
+    if (key == PROFILE_ROOT) snprintf(buf, size, "entry");
+    else if (pc < 0x40 && !(pc & 7)) snprintf(buf, size, "rst_%02X", pc);
+    else if (pc >= 0x40 && pc <= 0x60 && !(pc & 7)) snprintf(buf, size, "%s", vectors[(pc - 0x40) >> 3]);
+    else snprintf(buf, size, "sub_%02X_%04X", bank, pc);
+}
+
+static double percent(uint64_t part, uint64_t total) {
+    return total ? 100.0 * part / total : 0.0;
+}
+
+typedef struct {
+    ProfileKey start;
+    uint16_t end;           // Last instruction (loops) or first byte past (blocks)
+    uint64_t count;         // Iterations or executions
+    uint64_t cycles;
+    const char* kind;
+} Span;
+
+static int span_by_cycles(const void* a, const void* b) {
+    const Span* x = a;
+    const Span* y = b;
+    return (x->cycles < y->cycles) - (x->cycles > y->cycles);
+}
+
+// Idle-wait patterns: HALT in the body, or a short loop that only reads
+static const char* loop_kind(const uint8_t* code, size_t avail) {
+    int instructions = 0;
+    bool stores = false;
+    bool loads = false;
+    const char* polls = NULL;
+
+    for (size_t i = 0; i < avail; i += d_asm_length(code[i])) {
+        uint8_t op = code[i];
+        uint8_t n = i + 1 < avail ? code[i + 1] : 0;
+        instructions++;
+
+        if (op == 0x76) return "halt";
+        if ((op == 0xF0 && (n == 0x44 || n == 0x41 || n == 0x0F)) ||
+            (op == 0xFA && i + 2 < avail && code[i + 2] == 0xFF && (n == 0x44 || n == 0x41 || n == 0x0F))) {
+            polls = n == 0x44 ? "wait rLY" : n == 0x41 ? "wait rSTAT" : "wait rIF";
+        }
+
+        if (op == 0x02 || op == 0x12 || op == 0x22 || op == 0x32 || op == 0x34 || op == 0x35 ||
+            op == 0x36 || op == 0xE0 || op == 0xE2 || op == 0xEA || (op >= 0x70 && op <= 0x77) ||
+            op_class(op) == OP_CALL) {
+            stores = true;
+        }
+        if (op == 0x0A || op == 0x1A || op == 0x2A || op == 0x3A || op == 0xF0 || op == 0xF2 ||
+            op == 0xFA || (op >= 0x40 && op < 0xC0 && (op & 7) == 6) ||
+            (op == 0xCB && (n & 0xC7) == 0x46)) {
+            loads = true;
+        }
+    }
+
+    if (polls) return polls;
+    if (loads && !stores && instructions <= 6) return "poll";
+    return "";
+}
+
+static size_t collect_loops(Profiler* prof, const ProfileEntry* entries, uint32_t bank,
+                            uint32_t first, uint32_t last, Span** spans, size_t* count, size_t* cap) {
+    for (uint32_t a = first; a < last; a++) {
+        if (!entries[a - first].back_taken) continue;
+
+        ProfileKey key = PROFILE_KEY(bank, a);
+        const uint8_t* code;
+        size_t avail = profiler_code(prof, key, &code);
+        if (!avail) continue;
+
+        uint16_t target;
+        if (code[0] == 0xE9 || (size_t)d_asm_length(code[0]) > avail) continue;
+        if (d_asm_length(code[0]) == 2) target = a + 2 + (int8_t)code[1];
+        else target = code[1] | (code[2] << 8);
+        if (target > a || target < first) continue;
+
+        uint64_t cycles = 0;
+        for (uint32_t i = target; i <= a; i++) cycles += entries[i - first].cycles;
+
+        const uint8_t* body;
+        size_t body_size = profiler_code(prof, PROFILE_KEY(bank, target), &body);
+        size_t length = a + d_asm_length(code[0]) - target;
+        if (body_size > length) body_size = length;
+
+        if (*count == *cap) {
+            size_t grown = *cap ? *cap * 2 : 64;
+            Span* more = realloc(*spans, grown * sizeof(Span));
+            if (!more) return *count;
+            *spans = more;
+            *cap = grown;
+        }
+        (*spans)[(*count)++] = (Span){
+            .start = PROFILE_KEY(bank, target),
+            .end = a,
+            .count = entries[a - first].back_taken,
+            .cycles = cycles,
+            .kind = loop_kind(body, body_size),
+        };
+    }
+    return *count;
+}
+
+// Straight-line runs of instructions that all executed equally often
+static size_t collect_blocks(Profiler* prof, const ProfileEntry* entries, uint32_t bank,
+                             uint32_t first, uint32_t last, Span** spans, size_t* count, size_t* cap) {
+    uint32_t a = first;
+    while (a < last) {
+        const ProfileEntry* head = &entries[a - first];
+        if (!head->instructions) {
+            a++;
+            continue;
+        }
+
+        ProfileKey key = PROFILE_KEY(bank, a);
+        const uint8_t* code;
+        size_t avail = profiler_code(prof, key, &code);
+        uint64_t cycles = 0;
+        uint32_t pc = a;
+        size_t offset = 0;
+        while (pc < last && offset < avail) {
+            const ProfileEntry* e = &entries[pc - first];
+            if (e->instructions != head->instructions) break;
+            cycles += e->cycles;
+            uint8_t op = code[offset];
+            int length = d_asm_length(op);
+            pc += length;
+            offset += length;
+            if (op_class(op) != OP_PLAIN) break;
+        }
+        if (pc == a) pc++;
+
+        if (*count == *cap) {
+            size_t grown = *cap ? *cap * 2 : 256;
+            Span* more = realloc(*spans, grown * sizeof(Span));
+            if (!more) return *count;
+            *spans = more;
+            *cap = grown;
+        }
+        (*spans)[(*count)++] = (Span){
+            .start = key,
+            .end = pc,
+            .count = head->instructions,
+            .cycles = cycles,
+            .kind = "",
+        };
+        a = pc;
+    }
+    return *count;
+}
+
+// Runs collect over every profiled region
+static void collect(Profiler* prof, Span** spans, size_t* count, size_t* cap,
+                    size_t (*fn)(Profiler*, const ProfileEntry*, uint32_t, uint32_t, uint32_t,
+                                 Span**, size_t*, size_t*)) {
+    fn(prof, prof->low, 0, 0x0000, 0x4000, spans, count, cap);
+    for (uint32_t bank = 0; bank < prof->banks; bank++) {
+        if (prof->bank[bank]) fn(prof, prof->bank[bank], bank, 0x4000, 0x8000, spans, count, cap);
+    }
+    fn(prof, prof->low + 0x8000, 0, 0x8000, 0x10000, spans, count, cap);
+}
+
+static void list_loop(Profiler* prof, const Span* loop, FILE* out) {
+    const uint8_t* code;
+    size_t avail = profiler_code(prof, loop->start, &code);
+    uint16_t pc = PROFILE_PC(loop->start);
+    uint32_t bank = PROFILE_BANK(loop->start);
+
+    size_t offset = 0;
+    while (offset < avail && pc <= loop->end) {
+        char text[D_ASM_TEXT_SIZE];
+        int length = d_asm_format(code + offset, avail - offset, pc, text, sizeof(text), NULL, NULL);
+        const ProfileEntry* e = profiler_find(prof, PROFILE_KEY(bank, pc));
+        fprintf(out, "        %02X:%04X  %12" PRIu64 "  %s\n", bank, pc, e ? e->cycles : 0, text);
+        pc += length;
+        offset += length;
+    }
+}
+
+typedef struct {
+    ProfileKey caller, callee;
+    uint64_t calls;
+    uint64_t cycles;        // Inclusive
+} Edge;
+
+static int edge_by_pair(const void* a, const void* b) {
+    const Edge* x = a;
+    const Edge* y = b;
+    if (x->caller != y->caller) return x->caller < y->caller ? -1 : 1;
+    if (x->callee != y->callee) return x->callee < y->callee ? -1 : 1;
+    return 0;
+}
+
+static int edge_by_cycles(const void* a, const void* b) {
+    const Edge* x = a;
+    const Edge* y = b;
+    return (x->cycles < y->cycles) - (x->cycles > y->cycles);
+}
+
+static void report_edges(Profiler* prof, FILE* out) {
+    int32_t count = prof->node_count;
+    uint64_t* inclusive = malloc(count * sizeof(uint64_t));
+    Edge* edges = malloc(count * sizeof(Edge));
+    if (!inclusive || !edges) {
+        free(inclusive);
+        free(edges);
+        return;
+    }
+
+    // Children always come after their parent
+    for (int32_t i = 0; i < count; i++) inclusive[i] = prof->nodes[i].cycles;
+    for (int32_t i = count - 1; i > 0; i--) inclusive[prof->nodes[i].parent] += inclusive[i];
+
+    int32_t n = 0;
+    for (int32_t i = 1; i < count; i++) {
+        const ProfileNode* node = &prof->nodes[i];
+        edges[n++] = (Edge){ prof->nodes[node->parent].function, node->function, node->calls, inclusive[i] };
+    }
+    qsort(edges, n, sizeof(Edge), edge_by_pair);
+
+    int32_t merged = 0;
+    for (int32_t i = 0; i < n; i++) {
+        if (merged && edge_by_pair(&edges[merged - 1], &edges[i]) == 0) {
+            edges[merged - 1].calls += edges[i].calls;
+            edges[merged - 1].cycles += edges[i].cycles;
+        } else {
+            edges[merged++] = edges[i];
+        }
+    }
+    qsort(edges, merged, sizeof(Edge), edge_by_cycles);
+
+    fprintf(out, "\nCall edges (inclusive cycles)\n");
+    for (int32_t i = 0; i < merged && i < REPORT_EDGES; i++) {
+        char caller[32], callee[32];
+        profiler_name(edges[i].caller, caller, sizeof(caller));
+        profiler_name(edges[i].callee, callee, sizeof(callee));
+        fprintf(out, "  %-14s -> %-14s %10" PRIu64 " calls %14" PRIu64 "  %5.1f%%\n",
+                caller, callee, edges[i].calls, edges[i].cycles,
+                percent(edges[i].cycles, prof->cycles));
+    }
+    if (prof->overflow) {
+        fprintf(out, "  (%d calls past depth %d not tracked)\n", prof->overflow, PROFILE_MAX_DEPTH);
+    }
+
+    free(inclusive);
+    free(edges);
+}
+
+void profiler_report(Profiler* prof, FILE* out) {
+    uint64_t halted = 0;
+    for (uint32_t a = 0; a < 0x10000; a++) halted += prof->low[a].halt_cycles;
+    for (uint32_t b = 0; b < prof->banks; b++) {
+        if (!prof->bank[b]) continue;
+        for (uint32_t a = 0; a < D_ASM_BANK_SIZE; a++) halted += prof->bank[b][a].halt_cycles;
+    }
+
+    fprintf(out, "%" PRIu64 " instructions, %" PRIu64 " cycles, %.1f%% halted\n",
+            prof->instructions, prof->cycles, percent(halted, prof->cycles));
+
+    Span* spans = NULL;
+    size_t count = 0, cap = 0;
+
+    // Hot loops, by the cycles spent in their body (callees excluded)
+    collect(prof, &spans, &count, &cap, collect_loops);
+    qsort(spans, count, sizeof(Span), span_by_cycles);
+    fprintf(out, "\nHot loops (body cycles, excluding calls)\n");
+    for (size_t i = 0; i < count && i < REPORT_LOOPS; i++) {
+        const Span* s = &spans[i];
+        fprintf(out, "  %02X:%04X-%04X %12" PRIu64 " iterations %14" PRIu64 "  %5.1f%%  %s\n",
+                PROFILE_BANK(s->start), PROFILE_PC(s->start), s->end, s->count, s->cycles,
+                percent(s->cycles, prof->cycles), s->kind);
+        if (i < REPORT_LISTINGS) list_loop(prof, s, out);
+    }
+
+    // Time spent halted, per HALT
+    fprintf(out, "\nHALT\n");
+    for (uint32_t a = 0; a < 0x10000; a++) {
+        const ProfileEntry* e = &prof->low[a];
+        if (!e->halt_cycles) continue;
+        fprintf(out, "  00:%04X %14" PRIu64 "  %5.1f%%\n", a, e->halt_cycles, percent(e->halt_cycles, prof->cycles));
+    }
+    for (uint32_t b = 0; b < prof->banks; b++) {
+        if (!prof->bank[b]) continue;
+        for (uint32_t a = 0; a < D_ASM_BANK_SIZE; a++) {
+            const ProfileEntry* e = &prof->bank[b][a];
+            if (!e->halt_cycles) continue;
+            fprintf(out, "  %02X:%04X %14" PRIu64 "  %5.1f%%\n", b, 0x4000 + a, e->halt_cycles,
+                    percent(e->halt_cycles, prof->cycles));
+        }
+    }
+
+    // Hot basic blocks
+    count = 0;
+    collect(prof, &spans, &count, &cap, collect_blocks);
+    qsort(spans, count, sizeof(Span), span_by_cycles);
+    fprintf(out, "\nHot blocks\n");
+    for (size_t i = 0; i < count && i < REPORT_BLOCKS; i++) {
+        const Span* s = &spans[i];
+        fprintf(out, "  %02X:%04X-%04X %12" PRIu64 " runs %14" PRIu64 "  %5.1f%%\n",
+                PROFILE_BANK(s->start), PROFILE_PC(s->start), (uint16_t)(s->end - 1), s->count,
+                s->cycles, percent(s->cycles, prof->cycles));
+    }
+    free(spans);
+
+    report_edges(prof, out);
+}
+
+// One "a;b;c cycles" line per call path with self time
+void profiler_collapsed(Profiler* prof, FILE* out) {
+    int32_t path[PROFILE_MAX_DEPTH + 1];
+    for (int32_t i = 0; i < prof->node_count; i++) {
+        if (!prof->nodes[i].cycles) continue;
+
+        int depth = 0;
+        for (int32_t n = i; n >= 0 && depth <= PROFILE_MAX_DEPTH; n = prof->nodes[n].parent) path[depth++] = n;
+
+        while (depth--) {
+            char name[32];
+            profiler_name(prof->nodes[path[depth]].function, name, sizeof(name));
+            fprintf(out, "%s%c", name, depth ? ';' : ' ');
+        }
+        fprintf(out, "%" PRIu64 "\n", prof->nodes[i].cycles);
+    }
+}
+
+int profiler_write(Profiler* prof, const char* prefix) {
+    size_t length = strlen(prefix) + 8;
+    char* path = malloc(length);
+    if (!path) return -1;
+
+    int result = 0;
+    snprintf(path, length, "%s.txt", prefix);
+    FILE* out = fopen(path, "w");
+    if (out) {
+        profiler_report(prof, out);
+        fclose(out);
+    } else {
+        result = -1;
+    }
+
+    snprintf(path, length, "%s.folded", prefix);
+    out = fopen(path, "w");
+    if (out) {
+        profiler_collapsed(prof, out);
+        fclose(out);
+    } else {
+        result = -1;
+    }
+
+    free(path);
+    return result;
+}
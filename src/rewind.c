@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <string.h>
+#include "rewind.h"
+
+// Encoded frame: repeated (skip words, literal words, literal XOR words),
+// counts as LEB128 varints. Words equal to the reference are skipped; a
+// keyframe is encoded against all zeros.
+
+static uint8_t* put_varint(uint8_t* p, size_t value) {
+    while (value >= 0x80) {
+        *p++ = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+static const uint8_t* get_varint(const uint8_t* p, size_t* value) {
+    size_t result = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+        result |= (size_t)(*p++ & 0x7F) << shift;
+        shift += 7;
+    }
+    *value = result | ((size_t)*p++ << shift);
+    return p;
+}
+
+static inline bool same_line(const uint64_t* a, const uint64_t* b) {
+    uint64_t diff = 0;
+    for (int k = 0; k < 8; k++) diff |= a[k] ^ b[k];
+    return diff == 0;
+}
+
+// Runs continue across sections: the skip count is carried over
+typedef struct {
+    uint8_t* out;
+    size_t skip;
+} Encoder;
+
+// Encode live against ref and bring ref up to date. A keyframe is encoded
+// against zeros.
+static void encode_section(Encoder* e, const uint64_t* live, uint64_t* ref, size_t words, bool key) {
+    uint8_t* p = e->out;
+    size_t i = 0;
+
+    while (i < words) {
+        size_t start = i;
+        if (key) {
+            while (i < words && live[i] == 0) i++;
+        } else {
+            // Unchanged stretches are the common case: compare a cache line at a time
+            while (i + 8 <= words && same_line(live + i, ref + i)) i += 8;
+            while (i < words && live[i] == ref[i]) i++;
+        }
+        e->skip += i - start;
+        if (i == words) break;
+
+        size_t literal = i;
+        if (key) while (i < words && live[i] != 0) i++;
+        else while (i < words && live[i] != ref[i]) i++;
+        p = put_varint(p, e->skip);
+        p = put_varint(p, i - literal);
+        e->skip = 0;
+        for (size_t k = literal; k < i; k++) {
+            uint64_t word = key ? live[k] : live[k] ^ ref[k];
+            memcpy(p, &word, sizeof(word));
+            p += sizeof(word);
+            ref[k] = live[k];
+        }
+    }
+    if (key && words) memcpy(ref, live, words * sizeof(uint64_t));
+    e->out = p;
+}
+
+// Encode the machine against rw->current into rw->encoded; returns the size
+static size_t encode(Rewind* rw, const GB_StateSection* sections, bool key) {
+    Encoder e = { rw->encoded, 0 };
+    uint64_t* ref = rw->current;
+    for (int i = 0; i < GB_STATE_SECTIONS; i++) {
+        encode_section(&e, sections[i].words, ref, sections[i].count, key);
+        ref += sections[i].count;
+    }
+    return e.out - rw->encoded;
+}
+
+static void xor_apply(uint64_t* state, const uint8_t* in, size_t size) {
+    const uint8_t* end = in + size;
+    size_t i = 0;
+
+    while (in < end) {
+        size_t skip, literal;
+        in = get_varint(in, &skip);
+        in = get_varint(in, &literal);
+        i += skip;
+        while (literal--) {
+            uint64_t word;
+            memcpy(&word, in, sizeof(word));
+            state[i++] ^= word;
+            in += sizeof(word);
+        }
+    }
+}
+
+static RewindRecord* record_at(Rewind* rw, uint32_t n) {
+    return &rw->records[(rw->first + n) % rw->capacity];
+}
+
+static const uint8_t* record_data(Rewind* rw, const RewindRecord* record) {
+    return rw->arena + record->offset % rw->budget;
+}
+
+Rewind* rewind_create(GameBoy* gb, size_t budget, uint32_t frames, uint32_t keyframe_interval) {
+    Rewind* rw = calloc(1, sizeof(Rewind));
+    if (!rw) return NULL;
+
+    size_t size = gb_state_size(gb);
+    rw->gb = gb;
+    rw->words = size / sizeof(uint64_t);
+    rw->budget = budget;
+    rw->capacity = frames ? frames : 1;
+    rw->keyframe_interval = keyframe_interval ? keyframe_interval : 1;
+
+    // Worst case: every word changed, or single-word runs (two 1-byte varints each)
+    size_t worst = rw->words * (sizeof(uint64_t) + 2) + 20;
+    rw->current = malloc(size);
+    rw->scratch = malloc(size);
+    rw->encoded = malloc(worst);
+    rw->arena = malloc(budget);
+    rw->records = calloc(rw->capacity, sizeof(RewindRecord));
+    if (!rw->current || !rw->scratch || !rw->encoded || !rw->arena || !rw->records ||
+        budget < 2 * worst) {
+        rewind_free(rw);
+        return NULL;
+    }
+    return rw;
+}
+
+void rewind_free(Rewind* rw) {
+    if (!rw) return;
+    free(rw->current);
+    free(rw->scratch);
+    free(rw->encoded);
+    free(rw->arena);
+    free(rw->records);
+    free(rw);
+}
+
+void rewind_reset(Rewind* rw) {
+    rw->first = 0;
+    rw->count = 0;
+    rw->write = 0;
+    rw->bytes = 0;
+    rw->since_key = 0;
+}
+
+// Drop the oldest keyframe and the deltas that depend on it
+static void drop_oldest(Rewind* rw) {
+    do {
+        rw->bytes -= record_at(rw, 0)->size;
+        rw->first = (rw->first + 1) % rw->capacity;
+        rw->count--;
+    } while (rw->count && !record_at(rw, 0)->key);
+}
+
+// Append rw->encoded; false if a delta would be left without its keyframe
+static bool store(Rewind* rw, size_t size, bool key, uint8_t buttons) {
+    uint64_t position = rw->write;
+    size_t at = position % rw->budget;
+    if (at + size > rw->budget) position += rw->budget - at;   // Never split a record
+    uint64_t end = position + size;
+
+    while (rw->count && (rw->count == rw->capacity || end - record_at(rw, 0)->offset > rw->budget)) {
+        drop_oldest(rw);
+    }
+    if (!key && rw->count == 0) return false;
+
+    memcpy(rw->arena + position % rw->budget, rw->encoded, size);
+    RewindRecord* record = record_at(rw, rw->count++);
+    record->offset = position;
+    record->size = (uint32_t)size;
+    record->buttons = buttons;
+    record->key = key;
+    rw->write = end;
+    rw->bytes += size;
+    rw->since_key = key ? 1 : rw->since_key + 1;
+    return true;
+}
+
+void rewind_capture(Rewind* rw) {
+    // Compared in place: the address space is never copied
+    GB_StateSection sections[GB_STATE_SECTIONS];
+    gb_state_sections(rw->gb, sections);
+    uint8_t buttons = rw->gb->joypad->state;
+
+    bool key = rw->count == 0 || rw->since_key >= rw->keyframe_interval;
+    size_t size = encode(rw, sections, key);
+    if (!store(rw, size, key, buttons)) {
+        // Everything was evicted: start over from a keyframe
+        size = encode(rw, sections, true);
+        store(rw, size, true, buttons);
+    }
+}
+
+// Rebuild record n's state from the keyframe at or before it
+static void rebuild(Rewind* rw, uint32_t n, uint64_t* state) {
+    uint32_t key = n;
+    while (!record_at(rw, key)->key) key--;
+
+    memset(state, 0, rw->words * sizeof(uint64_t));
+    for (uint32_t i = key; i <= n; i++) {
+        RewindRecord* record = record_at(rw, i);
+        xor_apply(state, record_data(rw, record), record->size);
+    }
+}
+
+// state holds record n's frame; turn it into record n-1's
+static void undo(Rewind* rw, uint32_t n, uint64_t* state) {
+    RewindRecord* record = record_at(rw, n);
+    if (record->key) rebuild(rw, n - 1, state);
+    else xor_apply(state, record_data(rw, record), record->size);
+}
+
+bool rewind_step(Rewind* rw) {
+    if (rw->count < 2) return false;
+
+    // Pop the newest frame; current becomes the one before it
+    uint32_t newest = rw->count - 1;
+    RewindRecord* popped = record_at(rw, newest);
+    undo(rw, newest, rw->current);
+    rw->write = popped->offset;
+    rw->bytes -= popped->size;
+    rw->count--;
+
+    rw->since_key = 0;
+    for (uint32_t i = rw->count; i-- > 0;) {
+        rw->since_key++;
+        if (record_at(rw, i)->key) break;
+    }
+
+    // Replay that frame from the one before it, so the framebuffer matches
+    GameBoy* gb = rw->gb;
+    if (rw->count < 2) {
+        gb_state_load(gb, (const uint8_t*)rw->current);
+        return true;
+    }
+    memcpy(rw->scratch, rw->current, rw->words * sizeof(uint64_t));
+    undo(rw, rw->count - 1, rw->scratch);
+    gb_state_load(gb, (const uint8_t*)rw->scratch);
+    gb_set_buttons(gb, record_at(rw, rw->count - 1)->buttons);
+    gb->ppu->render = true;
+    gb_run_frame(gb);
+    return true;
+}
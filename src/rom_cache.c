@@ -0,0 +1,122 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "rom_cache.h"
+
+// Process-wide list of mapped images. Few distinct ROMs are live at once,
+// so a linked list under one mutex is enough.
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static RomImage* cache_head = NULL;
+
+static bool same_file(const RomImage* image, const char* path, const struct stat* st) {
+    return image->dev == st->st_dev && image->ino == st->st_ino &&
+           image->file_size == st->st_size &&
+           image->mtime.tv_sec == st->st_mtim.tv_sec && image->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+           strcmp(image->path, path) == 0;
+}
+
+// Takes a reference on a cached image of this file; caller holds cache_lock
+static RomImage* cache_find(const char* path, const struct stat* st) {
+    for (RomImage* image = cache_head; image; image = image->next) {
+        if (same_file(image, path, st)) {
+            image->refs++;
+            return image;
+        }
+    }
+    return NULL;
+}
+
+static RomImage* cache_lookup(const char* path, const struct stat* st) {
+    pthread_mutex_lock(&cache_lock);
+    RomImage* image = cache_find(path, st);
+    pthread_mutex_unlock(&cache_lock);
+    return image;
+}
+
+static void image_free(RomImage* image) {
+    munmap((void*)image->data, image->size);
+    free(image->path);
+    free(image);
+}
+
+// File system work happens outside cache_lock, so a slow open or mmap only
+// holds up its own caller; the lock covers the list alone
+int rom_cache_acquire(const char* path, RomImage** out) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return ROM_ERR_OPEN;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return ROM_ERR_OPEN;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return ROM_ERR_MAP;
+    }
+
+    RomImage* image = cache_lookup(path, &st);
+    if (image) {
+        close(fd);
+        *out = image;
+        return ROM_OK;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping keeps the file referenced
+    if (data == MAP_FAILED) return ROM_ERR_MAP;
+
+    image = calloc(1, sizeof(RomImage));
+    char* key = strdup(path);
+    if (!image || !key) {
+        munmap(data, st.st_size);
+        free(image);
+        free(key);
+        return ROM_ERR_NOMEM;
+    }
+    image->data = data;
+    image->size = st.st_size;
+    image->path = key;
+    image->dev = st.st_dev;
+    image->ino = st.st_ino;
+    image->file_size = st.st_size;
+    image->mtime = st.st_mtim;
+    image->refs = 1;
+
+    // A concurrent acquire may have mapped the same file meanwhile: use
+    // its image and drop ours
+    pthread_mutex_lock(&cache_lock);
+    RomImage* winner = cache_find(path, &st);
+    if (!winner) {
+        image->next = cache_head;
+        cache_head = image;
+    }
+    pthread_mutex_unlock(&cache_lock);
+
+    if (winner) {
+        image_free(image);
+        image = winner;
+    }
+    *out = image;
+    return ROM_OK;
+}
+
+void rom_cache_release(RomImage* image) {
+    if (!image) return;
+
+    pthread_mutex_lock(&cache_lock);
+    if (--image->refs == 0) {
+        RomImage** link = &cache_head;
+        while (*link != image) link = &(*link)->next;
+        *link = image->next;
+    } else {
+        image = NULL;   // Still referenced
+    }
+    pthread_mutex_unlock(&cache_lock);
+    if (image) image_free(image);
+}
@@ -0,0 +1,131 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cartridge.h"
+#include "hash.h"
+#include "rom_index.h"
+
+RomIndex* rom_index_open(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RomIndexHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    // Everything is checked up front so lookups can trust the offsets
+    const RomIndexHeader* header = map;
+    size_t size = st.st_size;
+    size_t entries = (size_t)header->count * sizeof(RomIndexEntry);
+    RomIndex* index = NULL;
+    if (memcmp(header->magic, ROM_INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+        sizeof(RomIndexHeader) + entries + header->paths_size == size &&
+        (header->paths_size == 0 || ((const char*)map)[size - 1] == '\0')) {
+        index = calloc(1, sizeof(RomIndex));
+    }
+    if (!index) {
+        munmap(map, size);
+        return NULL;
+    }
+    index->entries = (const RomIndexEntry*)(header + 1);
+    index->count = header->count;
+    index->paths = (const char*)index->entries + entries;
+    index->paths_size = header->paths_size;
+    index->map = map;
+    index->map_size = size;
+
+    for (uint32_t i = 0; i < index->count; i++) {
+        if (index->entries[i].path >= index->paths_size) {
+            rom_index_close(index);
+            return NULL;
+        }
+    }
+    return index;
+}
+
+void rom_index_close(RomIndex* index) {
+    if (!index) return;
+    munmap(index->map, index->map_size);
+    free(index);
+}
+
+void rom_index_title(const RomIndexEntry* entry, char title[17]) {
+    int i = 0;
+    for (; i < 16 && entry->title[i]; i++) {
+        char c = entry->title[i];
+        title[i] = c >= 0x20 && c < 0x7F ? c : '?';
+    }
+    title[i] = '\0';
+}
+
+const RomIndexEntry* rom_index_find(const RomIndex* index, const char* path) {
+    uint32_t low = 0, high = index->count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        int order = strcmp(rom_index_path(index, &index->entries[mid]), path);
+        if (order == 0) return &index->entries[mid];
+        if (order < 0) low = mid + 1;
+        else high = mid;
+    }
+    return NULL;
+}
+
+bool rom_index_fill(RomIndexEntry* entry, const uint8_t* data, size_t size) {
+    memset(entry, 0, sizeof(*entry));
+    if (size < 0x150) return false;
+
+    Cartridge cart = { .data = data, .size = size };
+    parse_gb_header(&cart);
+
+    memcpy(entry->title, cart.title, sizeof(entry->title));    // cart starts zeroed, so this pads
+    entry->new_licensee = cart.new_licensee;
+    entry->global_checksum = cart.global_checksum;
+    entry->sgb_flag = cart.sgb_flag;
+    entry->cartridge_type = cart.cartridge_type;
+    entry->rom_size = cart.rom_size;
+    entry->ram_size = cart.ram_size;
+    entry->destination = cart.destination;
+    entry->old_licensee = cart.old_licensee;
+    entry->version = cart.version;
+    entry->header_checksum = cart.header_checksum;
+    entry->flags = (cart.logo_ok ? ROM_INDEX_LOGO_OK : 0) |
+                   (cart.header_ok ? ROM_INDEX_HEADER_OK : 0) |
+                   (cart_global_checksum(data, size) == cart.global_checksum ? ROM_INDEX_GLOBAL_OK : 0);
+    entry->hash = hash64(data, size, 0);
+    entry->size = size;
+    return true;
+}
+
+int rom_index_write(const char* path, const RomIndexEntry* entries, uint32_t count,
+                    const char* paths, size_t paths_size) {
+    size_t length = strlen(path);
+    char* temp = malloc(length + 5);
+    if (!temp) return -1;
+    memcpy(temp, path, length);
+    memcpy(temp + length, ".tmp", 5);
+
+    RomIndexHeader header = { .count = count, .paths_size = (uint32_t)paths_size };
+    memcpy(header.magic, ROM_INDEX_MAGIC, sizeof(header.magic));
+
+    FILE* f = fopen(temp, "wb");
+    bool ok = f != NULL;
+    if (ok) {
+        ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+             fwrite(entries, sizeof(RomIndexEntry), count, f) == count &&
+             fwrite(paths, 1, paths_size, f) == paths_size;
+        ok = fclose(f) == 0 && ok;
+    }
+    ok = ok && rename(temp, path) == 0;
+    if (!ok) remove(temp);
+    free(temp);
+    return ok ? 0 : -1;
+}
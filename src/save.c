@@ -0,0 +1,131 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "save.h"
+
+// One flusher for the whole process; hundreds of instances share it
+static pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t flush_done = PTHREAD_COND_INITIALIZER;
+static SaveFile* flush_head = NULL;
+static bool flush_started = false;
+
+static void* flusher_main(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&flush_lock);
+    for (;;) {
+        while (!flush_head) pthread_cond_wait(&flush_wake, &flush_lock);
+
+        SaveFile* save = flush_head;
+        flush_head = save->next;
+        save->queued = false;
+        save->busy = true;
+        pthread_mutex_unlock(&flush_lock);
+
+        msync(save->data, save->size, MS_SYNC);
+
+        pthread_mutex_lock(&flush_lock);
+        save->busy = false;
+        pthread_cond_broadcast(&flush_done);
+    }
+    return NULL;
+}
+
+static void flusher_queue(SaveFile* save) {
+    pthread_mutex_lock(&flush_lock);
+    if (!flush_started) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, flusher_main, NULL) == 0) {
+            pthread_detach(thread);
+            flush_started = true;
+        }
+    }
+    if (!flush_started) {
+        // No thread: flush inline rather than lose the save
+        pthread_mutex_unlock(&flush_lock);
+        msync(save->data, save->size, MS_SYNC);
+        return;
+    }
+    if (!save->queued) {
+        save->queued = true;
+        save->next = flush_head;
+        flush_head = save;
+        pthread_cond_signal(&flush_wake);
+    }
+    pthread_mutex_unlock(&flush_lock);
+}
+
+SaveFile* save_open(const char* path, MBC* mbc, uint32_t interval) {
+    SaveFile* save = calloc(1, sizeof(SaveFile));
+    if (!save) return NULL;
+    save->path = strdup(path);
+    save->mbc = mbc;
+    save->interval = interval ? interval : 1;
+    save->size = mbc->ram_size + mbc->footer_size;
+    save->fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    struct stat st;
+    if (!save->path || save->fd < 0 || fstat(save->fd, &st) != 0 ||
+        ((size_t)st.st_size < save->size && ftruncate(save->fd, save->size) != 0)) {
+        save->data = NULL;
+        save_close(save);
+        return NULL;
+    }
+
+    // An existing file without a footer (or from another emulator) keeps
+    // its RAM; the missing footer reads as zeros
+    bool has_footer = mbc->footer_size && (size_t)st.st_size >= save->size;
+    save->data = mmap(NULL, save->size, PROT_READ | PROT_WRITE, MAP_SHARED, save->fd, 0);
+    if (save->data == MAP_FAILED) {
+        save->data = NULL;
+        save_close(save);
+        return NULL;
+    }
+
+    if (has_footer && mbc->load_footer) mbc->load_footer(mbc, save->data + mbc->ram_size);
+    mbc_set_ram(mbc, save->data);
+    return save;
+}
+
+void save_frame(SaveFile* save) {
+    MBC* mbc = save->mbc;
+    if (++save->frames < save->interval || !mbc->ram_dirty) return;
+
+    // Re-arm dirty tracking before the flush, so writes from here on are
+    // seen as a new change
+    if (mbc->save_footer) mbc->save_footer(mbc, save->data + mbc->ram_size);
+    mbc->ram_dirty = false;
+    mbc_protect_ram(mbc);
+    save->frames = 0;
+    flusher_queue(save);
+}
+
+void save_close(SaveFile* save) {
+    if (!save) return;
+
+    // Take the file off the flusher before unmapping it
+    pthread_mutex_lock(&flush_lock);
+    for (SaveFile** link = &flush_head; *link; link = &(*link)->next) {
+        if (*link == save) {
+            *link = save->next;
+            save->queued = false;
+            break;
+        }
+    }
+    while (save->busy) pthread_cond_wait(&flush_done, &flush_lock);
+    pthread_mutex_unlock(&flush_lock);
+
+    if (save->data) {
+        MBC* mbc = save->mbc;
+        if (mbc->save_footer) mbc->save_footer(mbc, save->data + mbc->ram_size);
+        msync(save->data, save->size, MS_SYNC);
+        munmap(save->data, save->size);
+    }
+    if (save->fd >= 0) close(save->fd);
+    free(save->path);
+    free(save);
+}
@@ -0,0 +1,87 @@
+#include <string.h>
+#include "scheduler.h"
+
+static inline bool sched_less(Scheduler* sched, int a, int b) {
+    return sched->when[sched->heap[a]] < sched->when[sched->heap[b]];
+}
+
+static inline void sched_swap(Scheduler* sched, int a, int b) {
+    uint8_t ea = sched->heap[a];
+    uint8_t eb = sched->heap[b];
+    sched->heap[a] = eb;
+    sched->heap[b] = ea;
+    sched->slot[eb] = a;
+    sched->slot[ea] = b;
+}
+
+static void sched_sift_up(Scheduler* sched, int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!sched_less(sched, i, parent)) break;
+        sched_swap(sched, i, parent);
+        i = parent;
+    }
+}
+
+static void sched_sift_down(Scheduler* sched, int i) {
+    for (;;) {
+        int left = 2 * i + 1;
+        int right = left + 1;
+        int smallest = i;
+        if (left < sched->size && sched_less(sched, left, smallest)) smallest = left;
+        if (right < sched->size && sched_less(sched, right, smallest)) smallest = right;
+        if (smallest == i) break;
+        sched_swap(sched, i, smallest);
+        i = smallest;
+    }
+}
+
+static inline void sched_update_next(Scheduler* sched) {
+    sched->next = sched->size ? sched->when[sched->heap[0]] : SCHED_NEVER;
+}
+
+void sched_init(Scheduler* sched) {
+    memset(sched, 0, sizeof(Scheduler));
+    memset(sched->slot, SCHED_IDLE, sizeof(sched->slot));
+    sched->next = SCHED_NEVER;
+}
+
+void sched_post(Scheduler* sched, SchedEvent event, uint64_t when) {
+    int i = sched->slot[event];
+    if (i == SCHED_IDLE) {
+        i = sched->size++;
+        sched->heap[i] = event;
+        sched->slot[event] = i;
+        sched->when[event] = when;
+        sched_sift_up(sched, i);
+    } else {
+        uint64_t old = sched->when[event];
+        sched->when[event] = when;
+        if (when < old) sched_sift_up(sched, i);
+        else sched_sift_down(sched, i);
+    }
+    sched_update_next(sched);
+}
+
+void sched_cancel(Scheduler* sched, SchedEvent event) {
+    int i = sched->slot[event];
+    if (i == SCHED_IDLE) return;
+
+    int last = --sched->size;
+    if (i != last) {
+        sched_swap(sched, i, last);
+        sched_sift_down(sched, i);
+        sched_sift_up(sched, i);
+    }
+    sched->slot[event] = SCHED_IDLE;
+    sched_update_next(sched);
+}
+
+int sched_pop_due(Scheduler* sched, uint64_t now, uint64_t* when) {
+    if (sched->next > now) return -1;
+
+    int event = sched->heap[0];
+    *when = sched->when[event];
+    sched_cancel(sched, event);
+    return event;
+}
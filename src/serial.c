@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <string.h>
+#include "serial.h"
+
+Serial* serial_create(void) {
+    Serial* serial = malloc(sizeof(Serial));
+    if (serial) memset(serial, 0, sizeof(Serial));
+    return serial;
+}
+
+void serial_init(Serial* serial) {
+    serial->sb = 0x00;
+    serial->sc = 0x7E;
+    serial->out_len = 0;
+}
+
+void serial_free(Serial* serial) {
+    if (!serial) return;
+    free(serial->out);
+    free(serial);
+}
+
+static void serial_capture(Serial* serial, uint8_t value) {
+    if (serial->out_len == serial->out_cap) {
+        size_t cap = serial->out_cap ? serial->out_cap * 2 : 256;
+        uint8_t* out = realloc(serial->out, cap);
+        if (!out) return;   // Drop output rather than fail the emulation
+        serial->out = out;
+        serial->out_cap = cap;
+    }
+    serial->out[serial->out_len++] = value;
+}
+
+uint8_t serial_read_sc(Serial* serial) {
+    return serial->sc | 0x7E;   // Unused bits read as 1
+}
+
+bool serial_write_sc(Serial* serial, uint8_t value) {
+    serial->sc = value;
+
+    // Only the internal clock drives a transfer without a partner
+    if ((value & 0x81) != 0x81) return false;
+
+    serial_capture(serial, serial->sb);
+    return true;
+}
+
+void serial_complete(Serial* serial, uint8_t in) {
+    serial->sb = in;
+    serial->sc &= 0x7F;
+}
+
+bool serial_receive(Serial* serial, uint8_t in, uint8_t* out) {
+    if ((serial->sc & 0x81) != 0x80) {
+        *out = 0xFF;
+        return false;
+    }
+    *out = serial->sb;
+    serial->sb = in;
+    serial->sc &= 0x7F;
+    return true;
+}
@@ -0,0 +1,280 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "block_cache.h"
+#include "gameboy.h"
+#include "hash.h"
+
+// Everything that changes while the machine runs, outside the big arrays.
+// Configuration (CPU mode, idle mode, render mode, frame skip) and host
+// resources (trace, profile, audio output, save file) are not part of it.
+typedef struct {
+    uint32_t frame_count;
+
+    // CPU
+    uint8_t a, f, b, c, d, e, h, l;
+    uint16_t pc, sp;
+    bool ime, ime_scheduled, halted, halt_bug;
+    uint64_t cycles;
+    uint64_t instructions;
+
+    Scheduler sched;
+
+    // Timer
+    uint8_t tima, tma, tac;
+    uint64_t div_base;
+    uint64_t synced;
+
+    // PPU
+    PPU_Mode mode;
+    uint8_t ly, lcdc, stat, lyc, x, window_line, sprite_count;
+    bool stat_line, window_active;
+    uint8_t sprites[PPU_MAX_SPRITES];
+    uint32_t frame;
+
+    // APU
+    APU_Channel ch[4];
+    uint8_t apu_regs[0x30];
+    bool power;
+    uint8_t sequencer_step;
+    uint64_t apu_time;
+    uint64_t sequencer_next;
+
+    // Joypad, serial, DMA
+    uint8_t buttons, joypad_select;
+    uint8_t sb, sc;
+    bool dma_active;
+
+    // MBC bank mapping (the registers are in type_data)
+    uint32_t rom_low, rom_high, ram_bank;
+    bool ram_enabled;
+} GB_StateHeader;
+
+// Sections in order, each a whole number of 8-byte words so snapshots can
+// be compared a word at a time. Cart RAM sizes are multiples of 512.
+#define STATE_ALIGN(n)  (((n) + 7) & ~(size_t)7)
+
+int gb_state_init(GameBoy* gb) {
+    MBC* mbc = gb->mmu->mbc;
+    gb->state_stage = calloc(1, STATE_ALIGN(sizeof(GB_StateHeader)) + STATE_ALIGN(mbc->type_size));
+    return gb->state_stage ? 0 : -1;
+}
+
+size_t gb_state_size(GameBoy* gb) {
+    MBC* mbc = gb->mmu->mbc;
+    return STATE_ALIGN(sizeof(GB_StateHeader)) + sizeof(gb->mmu->memory) +
+           STATE_ALIGN(mbc->ram_size) + STATE_ALIGN(mbc->type_size);
+}
+
+static void state_header(GameBoy* gb, GB_StateHeader* s) {
+    CPU* cpu = gb->cpu;
+    PPU* ppu = gb->ppu;
+    APU* apu = gb->apu;
+    MBC* mbc = gb->mmu->mbc;
+
+    // Padding must be zero too, or identical states would differ
+    memset(s, 0, STATE_ALIGN(sizeof(GB_StateHeader)));
+
+    s->frame_count = gb->frame_count;
+    s->a = cpu->a; s->f = cpu_get_f(cpu); s->b = cpu->b; s->c = cpu->c;
+    s->d = cpu->d; s->e = cpu->e; s->h = cpu->h; s->l = cpu->l;
+    s->pc = cpu->pc;
+    s->sp = cpu->sp;
+    s->ime = cpu->ime;
+    s->ime_scheduled = cpu->ime_scheduled;
+    s->halted = cpu->halted;
+    s->halt_bug = cpu->halt_bug;
+    s->cycles = cpu->cycles;
+    s->instructions = cpu->instructions;
+
+    s->sched = gb->sched;
+
+    s->tima = gb->timer->tima;
+    s->tma = gb->timer->tma;
+    s->tac = gb->timer->tac;
+    s->div_base = gb->timer->div_base;
+    s->synced = gb->timer->synced;
+
+    s->mode = ppu->mode;
+    s->ly = ppu->ly;
+    s->lcdc = ppu->lcdc;
+    s->stat = ppu->stat;
+    s->lyc = ppu->lyc;
+    s->x = ppu->x;
+    s->window_line = ppu->window_line;
+    s->sprite_count = ppu->sprite_count;
+    s->stat_line = ppu->stat_line;
+    s->window_active = ppu->window_active;
+    memcpy(s->sprites, ppu->sprites, sizeof(s->sprites));
+    s->frame = ppu->frame;
+
+    memcpy(s->ch, apu->ch, sizeof(s->ch));
+    for (int i = 0; i < 4; i++) {
+        s->ch[i].output[0] = 0;     // Mixer state of the audio output
+        s->ch[i].output[1] = 0;
+    }
+    memcpy(s->apu_regs, apu->regs, sizeof(s->apu_regs));
+    s->power = apu->power;
+    s->sequencer_step = apu->sequencer_step;
+    s->apu_time = apu->time;
+    s->sequencer_next = apu->sequencer_next;
+
+    s->buttons = gb->joypad->state;
+    s->joypad_select = gb->joypad->select;
+    s->sb = gb->serial->sb;
+    s->sc = gb->serial->sc;
+    s->dma_active = gb->mmu->dma_active;
+
+    s->rom_low = (mbc->rom_low - mbc->rom) / MBC_ROM_BANK_SIZE;
+    s->rom_high = (mbc->rom_high - mbc->rom) / MBC_ROM_BANK_SIZE;
+    s->ram_enabled = mbc->ram_bank != NULL;
+    s->ram_bank = mbc->ram_bank ? (mbc->ram_bank - mbc->ram_data) / MBC_RAM_BANK_SIZE : 0;
+}
+
+void gb_state_sections(GameBoy* gb, GB_StateSection sections[GB_STATE_SECTIONS]) {
+    MBC* mbc = gb->mmu->mbc;
+    uint8_t* header = gb->state_stage;
+    uint8_t* registers = header + STATE_ALIGN(sizeof(GB_StateHeader));
+
+    state_header(gb, (GB_StateHeader*)header);
+    if (mbc->type_size) memcpy(registers, mbc->type_data, mbc->type_size);    // Tail stays zero
+
+    sections[0] = (GB_StateSection){ (const uint64_t*)header, STATE_ALIGN(sizeof(GB_StateHeader)) / 8 };
+    sections[1] = (GB_StateSection){ (const uint64_t*)gb->mmu->memory, sizeof(gb->mmu->memory) / 8 };
+    sections[2] = (GB_StateSection){ (const uint64_t*)mbc->ram_data, mbc->ram_size / 8 };
+    sections[3] = (GB_StateSection){ (const uint64_t*)registers, STATE_ALIGN(mbc->type_size) / 8 };
+}
+
+void gb_state_save(GameBoy* gb, uint8_t* out) {
+    GB_StateSection sections[GB_STATE_SECTIONS];
+    gb_state_sections(gb, sections);
+    for (int i = 0; i < GB_STATE_SECTIONS; i++) {
+        if (sections[i].count) memcpy(out, sections[i].words, sections[i].count * 8);
+        out += sections[i].count * 8;
+    }
+}
+
+void gb_state_load(GameBoy* gb, const uint8_t* in) {
+    CPU* cpu = gb->cpu;
+    PPU* ppu = gb->ppu;
+    APU* apu = gb->apu;
+    MMU* mmu = gb->mmu;
+    MBC* mbc = mmu->mbc;
+    const GB_StateHeader* s = (const GB_StateHeader*)in;
+
+    gb->frame_count = s->frame_count;
+
+    cpu->a = s->a; cpu_set_f(cpu, s->f); cpu->b = s->b; cpu->c = s->c;
+    cpu->d = s->d; cpu->e = s->e; cpu->h = s->h; cpu->l = s->l;
+    cpu->pc = s->pc;
+    cpu->sp = s->sp;
+    cpu->ime = s->ime;
+    cpu->ime_scheduled = s->ime_scheduled;
+    cpu->halted = s->halted;
+    cpu->halt_bug = s->halt_bug;
+    cpu->cycles = s->cycles;
+    cpu->instructions = s->instructions;
+    cpu->idle.armed = false;
+
+    gb->sched = s->sched;
+
+    gb->timer->tima = s->tima;
+    gb->timer->tma = s->tma;
+    gb->timer->tac = s->tac;
+    gb->timer->div_base = s->div_base;
+    gb->timer->synced = s->synced;
+
+    ppu->mode = s->mode;
+    ppu->ly = s->ly;
+    ppu->lcdc = s->lcdc;
+    ppu->stat = s->stat;
+    ppu->lyc = s->lyc;
+    ppu->x = s->x;
+    ppu->window_line = s->window_line;
+    ppu->sprite_count = s->sprite_count;
+    ppu->stat_line = s->stat_line;
+    ppu->window_active = s->window_active;
+    memcpy(ppu->sprites, s->sprites, sizeof(ppu->sprites));
+    ppu->frame = s->frame;
+    ppu->render = ppu->frame % ppu->render_period == 0;
+
+    for (int i = 0; i < 4; i++) {
+        APU_Channel* c = &apu->ch[i];
+        int left = c->output[0], right = c->output[1];
+        *c = s->ch[i];
+        c->output[0] = left;
+        c->output[1] = right;
+    }
+    memcpy(apu->regs, s->apu_regs, sizeof(apu->regs));
+    apu->power = s->power;
+    apu->sequencer_step = s->sequencer_step;
+    apu->time = s->apu_time;
+    apu->sequencer_next = s->sequencer_next;
+    apu_restart_output(apu);
+
+    gb->joypad->state = s->buttons;
+    gb->joypad->select = s->joypad_select;
+    gb->serial->sb = s->sb;
+    gb->serial->sc = s->sc;
+    mmu->dma_active = s->dma_active;
+
+    in += STATE_ALIGN(sizeof(GB_StateHeader));
+    memcpy(mmu->memory, in, sizeof(mmu->memory));
+    in += sizeof(mmu->memory);
+    if (mbc->ram_size) {
+        memcpy(mbc->ram_data, in, mbc->ram_size);
+        if (mbc->battery) mbc->ram_dirty = true;
+    }
+    in += STATE_ALIGN(mbc->ram_size);
+    if (mbc->type_size) memcpy(mbc->type_data, in, mbc->type_size);
+
+    mbc_map_rom(mbc, s->rom_low, s->rom_high);
+    mbc_map_ram(mbc, s->ram_enabled, s->ram_bank);
+
+    // Cached code and idle verdicts describe the old memory
+    if (cpu->blocks) block_cache_flush(cpu->blocks);
+    mmu->code_gen++;
+}
+
+// Guest-visible values only: counters the CPU keeps for the host (retired
+// instructions, idle bookkeeping) and lazily synced timestamps differ
+// between CPU and idle modes without the game being able to tell.
+typedef struct {
+    uint64_t cycles;
+    uint8_t a, f, b, c, d, e, h, l;
+    uint16_t pc, sp;
+    uint8_t ime, halted;
+    uint8_t div, tima, tma, tac;
+    uint8_t ly, stat, lcdc, buttons;
+    uint32_t rom_low, rom_high;
+} GB_HashedState;
+
+uint64_t gb_state_hash(GameBoy* gb) {
+    CPU* cpu = gb->cpu;
+    MBC* mbc = gb->mmu->mbc;
+    GB_HashedState s;
+    memset(&s, 0, sizeof(s));
+
+    s.cycles = cpu->cycles;
+    s.a = cpu->a; s.f = cpu_get_f(cpu); s.b = cpu->b; s.c = cpu->c;
+    s.d = cpu->d; s.e = cpu->e; s.h = cpu->h; s.l = cpu->l;
+    s.pc = cpu->pc;
+    s.sp = cpu->sp;
+    s.ime = cpu->ime;
+    s.halted = cpu->halted;
+    s.div = timer_read(gb->timer, 0xFF04, cpu->cycles);
+    s.tima = timer_read(gb->timer, 0xFF05, cpu->cycles);
+    s.tma = gb->timer->tma;
+    s.tac = gb->timer->tac;
+    s.ly = gb->ppu->ly;
+    s.stat = gb->ppu->stat;
+    s.lcdc = gb->ppu->lcdc;
+    s.buttons = gb->joypad->state;
+    s.rom_low = (mbc->rom_low - mbc->rom) / MBC_ROM_BANK_SIZE;
+    s.rom_high = (mbc->rom_high - mbc->rom) / MBC_ROM_BANK_SIZE;
+
+    uint64_t hash = hash64(&s, sizeof(s), 0);
+    hash = hash64(gb->mmu->memory, sizeof(gb->mmu->memory), hash);
+    if (mbc->ram_size) hash = hash64(mbc->ram_data, mbc->ram_size, hash);
+    return hash64(gb_framebuffer(gb), PPU_WIDTH * PPU_HEIGHT * sizeof(uint32_t), hash);
+}
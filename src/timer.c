@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+#include "mmu.h"
+#include "timer.h"
+
+// Divider bit whose falling edge clocks TIMA, per TAC frequency
+static const uint8_t tac_shift[4] = { 10, 4, 6, 8 };   // 4096, 262144, 65536, 16384 Hz
+
+Timer* gb_timer_create(void) {
+    Timer* timer = malloc(sizeof(Timer));
+    if (timer) memset(timer, 0, sizeof(Timer));
+    return timer;
+}
+
+void timer_init(Timer* timer, MMU* mmu, Scheduler* sched) {
+    timer->mmu = mmu;
+    timer->sched = sched;
+    timer->tima = 0x00;
+    timer->tma = 0x00;
+    timer->tac = 0x00;
+    // DIV reads 0xAB right after the boot ROM
+    timer->div_base = (uint64_t)0 - 0xABCC;
+    timer->synced = 0;
+}
+
+void timer_free(Timer* timer) {
+    free(timer);
+}
+
+static inline int timer_shift(Timer* timer) {
+    return tac_shift[timer->tac & 0x03];
+}
+
+// Apply every TIMA increment between the last sync and now
+static void timer_sync(Timer* timer, uint64_t now) {
+    if (timer->tac & 0x04) {
+        int shift = timer_shift(timer);
+        uint64_t ticks = ((now - timer->div_base) >> shift) - ((timer->synced - timer->div_base) >> shift);
+
+        while (ticks) {
+            uint64_t to_overflow = 0x100 - timer->tima;
+            if (ticks < to_overflow) {
+                timer->tima += ticks;
+                break;
+            }
+            ticks -= to_overflow;
+            timer->tima = timer->tma;
+            timer->mmu->memory[0xFF0F] |= INT_TIMER;
+        }
+    }
+    timer->synced = now;
+}
+
+// Post the next overflow (TIMA must be synced to now)
+static void timer_reschedule(Timer* timer, uint64_t now) {
+    if (!(timer->tac & 0x04)) {
+        sched_cancel(timer->sched, SCHED_TIMER);
+        return;
+    }
+
+    int shift = timer_shift(timer);
+    uint64_t ticks = 0x100 - timer->tima;
+    uint64_t edge = (((now - timer->div_base) >> shift) + ticks) << shift;
+    sched_post(timer->sched, SCHED_TIMER, timer->div_base + edge);
+}
+
+uint8_t timer_read(Timer* timer, uint16_t address, uint64_t now) {
+    switch (address) {
+        case 0xFF04: return (uint8_t)((now - timer->div_base) >> 8);
+        case 0xFF05: timer_sync(timer, now); return timer->tima;
+        case 0xFF06: return timer->tma;
+        default:     return timer->tac | 0xF8;
+    }
+}
+
+void timer_write(Timer* timer, uint16_t address, uint8_t value, uint64_t now) {
+    timer_sync(timer, now);
+
+    switch (address) {
+        case 0xFF04:
+            // Resetting the divider while the selected bit is high is a falling edge
+            if ((timer->tac & 0x04) && ((now - timer->div_base) >> (timer_shift(timer) - 1)) & 1) {
+                if (++timer->tima == 0) {
+                    timer->tima = timer->tma;
+                    timer->mmu->memory[0xFF0F] |= INT_TIMER;
+                }
+            }
+            timer->div_base = now;
+            break;
+        case 0xFF05:
+            timer->tima = value;
+            break;
+        case 0xFF06:
+            timer->tma = value;
+            break;
+        default:
+            timer->tac = value & 0x07;
+            break;
+    }
+    timer_reschedule(timer, now);
+}
+
+void timer_event(Timer* timer, uint64_t when) {
+    timer_sync(timer, when);
+    timer_reschedule(timer, when);
+}
@@ -0,0 +1,82 @@
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trace.h"
+
+// Writer thread: copy out whatever is in the ring, sleep briefly when idle
+static void* trace_thread(void* arg) {
+    Tracer* trace = arg;
+    struct timespec idle = { 0, 1000000 };  // 1ms
+
+    for (;;) {
+        bool stop = atomic_load_explicit(&trace->stop, memory_order_acquire);
+        uint64_t tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+        uint64_t head = atomic_load_explicit(&trace->head, memory_order_acquire);
+
+        if (head == tail) {
+            if (stop) break;
+            nanosleep(&idle, NULL);
+            continue;
+        }
+
+        // Up to the end of the ring; the wrapped part goes next round
+        uint64_t start = tail & (TRACE_RING_SIZE - 1);
+        uint64_t count = head - tail;
+        if (count > TRACE_RING_SIZE - start) count = TRACE_RING_SIZE - start;
+
+        // After a failed write the rest is dropped, but still drained so
+        // the CPU never waits on a dead file
+        if (!trace->failed &&
+            fwrite(&trace->ring[start], sizeof(TraceRecord), count, trace->file) != count) {
+            trace->failed = true;
+        }
+        atomic_store_explicit(&trace->tail, tail + count, memory_order_release);
+    }
+    return NULL;
+}
+
+Tracer* trace_open(const char* path) {
+    Tracer* trace = calloc(1, sizeof(Tracer));
+    if (!trace) return NULL;
+
+    trace->ring = malloc(TRACE_RING_SIZE * sizeof(TraceRecord));
+    trace->file = fopen(path, "wb");
+    atomic_init(&trace->head, 0);
+    atomic_init(&trace->tail, 0);
+    atomic_init(&trace->stop, false);
+
+    if (trace->ring && trace->file) {
+        TraceHeader header = { .record_size = sizeof(TraceRecord) };
+        memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+        if (fwrite(&header, sizeof(header), 1, trace->file) == 1 &&
+            pthread_create(&trace->thread, NULL, trace_thread, trace) == 0) {
+            return trace;
+        }
+    }
+
+    if (trace->file) fclose(trace->file);
+    free(trace->ring);
+    free(trace);
+    return NULL;
+}
+
+int trace_close(Tracer* trace) {
+    if (!trace) return 0;
+    atomic_store_explicit(&trace->stop, true, memory_order_release);
+    pthread_join(trace->thread, NULL);
+    bool failed = trace->failed;
+    if (fclose(trace->file) != 0) failed = true;    // Buffered tail
+    free(trace->ring);
+    free(trace);
+    return failed ? -1 : 0;
+}
+
+void trace_wait(Tracer* trace) {
+    // Never drop records: a trace with holes is useless for diffing
+    trace->stalls++;
+    uint64_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    while (head - atomic_load_explicit(&trace->tail, memory_order_acquire) == TRACE_RING_SIZE) {
+        sched_yield();
+    }
+}
@@ -0,0 +1,38 @@
+#include <stdlib.h>
+#include "triple_buffer.h"
+
+TripleBuffer* triple_buffer_create(size_t size) {
+    TripleBuffer* tb = calloc(1, sizeof(TripleBuffer));
+    if (!tb) return NULL;
+    for (int i = 0; i < 3; i++) {
+        tb->buffers[i] = calloc(1, size);
+        if (!tb->buffers[i]) {
+            triple_buffer_free(tb);
+            return NULL;
+        }
+    }
+    tb->size = size;
+    tb->back = 0;
+    tb->front = 1;
+    atomic_init(&tb->middle, 2);
+    return tb;
+}
+
+void triple_buffer_free(TripleBuffer* tb) {
+    if (!tb) return;
+    for (int i = 0; i < 3; i++) free(tb->buffers[i]);
+    free(tb);
+}
+
+void triple_buffer_publish(TripleBuffer* tb) {
+    // Release: the pixels are visible before the index is
+    uint8_t old = atomic_exchange_explicit(&tb->middle, tb->back | TRIPLE_FRESH, memory_order_acq_rel);
+    tb->back = old & 3;
+}
+
+const void* triple_buffer_take(TripleBuffer* tb) {
+    if (!(atomic_load_explicit(&tb->middle, memory_order_relaxed) & TRIPLE_FRESH)) return NULL;
+    uint8_t old = atomic_exchange_explicit(&tb->middle, tb->front, memory_order_acq_rel);
+    tb->front = old & 3;
+    return tb->buffers[tb->front];
+}
@@ -0,0 +1,136 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "workpool.h"
+
+// One shard of pending task indices: the owner takes from the front,
+// thieves split off the back half
+typedef struct {
+    pthread_mutex_t lock;
+    size_t begin;
+    size_t end;
+} WorkShard;
+
+typedef struct {
+    WorkShard* shards;
+    int worker_count;
+    WorkFunc fn;
+    void* ctx;
+} WorkPool;
+
+typedef struct {
+    WorkPool* pool;
+    int id;
+} WorkerArg;
+
+int workpool_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static int shard_pop(WorkShard* shard, size_t* index) {
+    int ok = 0;
+    pthread_mutex_lock(&shard->lock);
+    if (shard->begin < shard->end) {
+        *index = shard->begin++;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return ok;
+}
+
+// Move the back half of victim's remaining range into thief
+static int shard_steal(WorkShard* victim, WorkShard* thief) {
+    size_t begin = 0, end = 0;
+
+    pthread_mutex_lock(&victim->lock);
+    size_t remaining = victim->end - victim->begin;
+    if (remaining > 0) {
+        size_t take = (remaining + 1) / 2;
+        end = victim->end;
+        begin = end - take;
+        victim->end = begin;
+    }
+    pthread_mutex_unlock(&victim->lock);
+
+    if (begin == end) return 0;
+
+    pthread_mutex_lock(&thief->lock);
+    thief->begin = begin;
+    thief->end = end;
+    pthread_mutex_unlock(&thief->lock);
+    return 1;
+}
+
+static void* worker_main(void* p) {
+    WorkerArg* arg = p;
+    WorkPool* pool = arg->pool;
+    WorkShard* own = &pool->shards[arg->id];
+    size_t index;
+
+    for (;;) {
+        while (shard_pop(own, &index)) {
+            pool->fn(pool->ctx, index, arg->id);
+        }
+
+        // Own shard empty: scan the others starting after ourselves
+        int stolen = 0;
+        for (int i = 1; i < pool->worker_count && !stolen; i++) {
+            WorkShard* victim = &pool->shards[(arg->id + i) % pool->worker_count];
+            stolen = shard_steal(victim, own);
+        }
+        if (!stolen) break;     // Nothing left anywhere
+    }
+    return NULL;
+}
+
+int workpool_run(size_t count, int threads, WorkFunc fn, void* ctx) {
+    if (threads <= 0) threads = workpool_cpu_count();
+    if ((size_t)threads > count) threads = count ? (int)count : 1;
+
+    WorkPool pool = { .worker_count = threads, .fn = fn, .ctx = ctx };
+    pool.shards = calloc(threads, sizeof(WorkShard));
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    WorkerArg* args = calloc(threads, sizeof(WorkerArg));
+    if (!pool.shards || !tids || !args) {
+        free(pool.shards);
+        free(tids);
+        free(args);
+        return -1;
+    }
+
+    // Initial sharding: contiguous, evenly sized ranges
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_init(&pool.shards[i].lock, NULL);
+        pool.shards[i].begin = count * i / threads;
+        pool.shards[i].end = count * (i + 1) / threads;
+    }
+
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        args[i].pool = &pool;
+        args[i].id = i;
+        if (pthread_create(&tids[i], NULL, worker_main, &args[i]) != 0) break;
+        started++;
+    }
+
+    // Threads that failed to start leave their shard to be stolen;
+    // with none running, do the work inline
+    if (started == 0) {
+        args[0].pool = &pool;
+        args[0].id = 0;
+        pool.worker_count = threads;
+        worker_main(&args[0]);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_destroy(&pool.shards[i].lock);
+    }
+    free(pool.shards);
+    free(tids);
+    free(args);
+    return 0;
+}
@@ -0,0 +1,401 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "gameboy.h"
+#include "hash.h"
+#include "idle.h"
+#include "workpool.h"
+
+// Runs many headless instances over a worker pool and writes one JSON line
+// per run to a single summary file, in task order.
+
+typedef struct {
+    uint32_t frame;
+    uint8_t buttons;
+} InputEvent;
+
+typedef struct {
+    // Input
+    char* rom;
+    char* inputs;       // Input script, may be NULL
+
+    // Result
+    int error;
+    bool bad_inputs;    // Input script could not be read or followed
+    char input_error[128];
+    uint32_t frames;
+    uint64_t cycles;
+    uint16_t af, bc, de, hl, sp, pc;
+    bool ime, halted;
+    uint64_t fb_hash;
+    uint8_t* serial;
+    size_t serial_len;
+} BatchTask;
+
+typedef struct {
+    BatchTask* tasks;
+    size_t count;
+    size_t cap;
+    uint32_t max_frames;
+    uint64_t max_cycles;
+    PPU_RenderMode render_mode;
+    CPU_Mode cpu_mode;
+    CPU_IdleMode idle_mode;
+    const char* idle_overrides;     // Per-title idle settings, may be NULL
+} Batch;
+
+static void usage(void)
+{
+    printf("Usage: gameboy-batch [options] (--manifest <file> | --rom <rom> [--inputs <script>...])\n"
+           "  -j <n>             worker threads (default: one per CPU)\n"
+           "  --frames <n>       stop each run after n frames (default 600 without --cycles)\n"
+           "  --cycles <n>       stop each run after n cycles (with --frames, whichever is first)\n"
+           "  --cpu <mode>       interp (default) or cached\n"
+           "  --ppu <mode>       scanline (default) or fifo\n"
+           "  --idle <mode>      off, halt or full (default): skip HALT / poll loops\n"
+           "  --idle-overrides <file>  per-title idle modes (see src/includes/idle.h)\n"
+           "  -o <file>          summary file (default: stdout)\n"
+           "Manifest lines:      <rom> [input-script]\n"
+           "Input script lines:  <frame> <buttons>, buttons '-' or a+b+select+start+right+left+up+down,\n"
+           "                     frames in order; a bad line fails the run\n");
+}
+
+static int batch_add(Batch* batch, const char* rom, const char* inputs)
+{
+    if (batch->count == batch->cap) {
+        size_t cap = batch->cap ? batch->cap * 2 : 64;
+        BatchTask* tasks = realloc(batch->tasks, cap * sizeof(BatchTask));
+        if (!tasks) return -1;
+        batch->tasks = tasks;
+        batch->cap = cap;
+    }
+    BatchTask* task = &batch->tasks[batch->count++];
+    memset(task, 0, sizeof(BatchTask));
+    task->rom = strdup(rom);
+    task->inputs = inputs ? strdup(inputs) : NULL;
+    return 0;
+}
+
+static int load_manifest(Batch* batch, const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        char* rom = strtok(line, " \t\r\n");
+        if (!rom || rom[0] == '#') continue;
+        char* inputs = strtok(NULL, " \t\r\n");
+        if (batch_add(batch, rom, inputs) != 0) {
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+// Buttons held, or -1 with the offending name in *bad
+static int parse_buttons(char* text, const char** bad)
+{
+    static const char* names[8] = { "a", "b", "select", "start", "right", "left", "up", "down" };
+    if (strcmp(text, "-") == 0) return 0;
+    int buttons = 0;
+
+    char* save;
+    for (char* name = strtok_r(text, "+,", &save); name; name = strtok_r(NULL, "+,", &save)) {
+        int i = 0;
+        while (i < 8 && strcasecmp(name, names[i]) != 0) i++;
+        if (i == 8) {
+            *bad = name;
+            return -1;
+        }
+        buttons |= 1 << i;
+    }
+    return buttons;
+}
+
+static int grow_events(InputEvent** events, int* cap)
+{
+    int grown_cap = *cap ? *cap * 2 : 32;
+    InputEvent* grown = realloc(*events, grown_cap * sizeof(InputEvent));
+    if (!grown) return -1;
+    *events = grown;
+    *cap = grown_cap;
+    return 0;
+}
+
+// Returns the number of events, or -1 with the reason in error: a script
+// that can't be followed exactly would make a silently wrong run
+static int load_inputs(const char* path, InputEvent** events, char* error, size_t error_size)
+{
+    *events = NULL;
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        snprintf(error, error_size, "could not read input script");
+        return -1;
+    }
+
+    int count = 0, cap = 0, number = 0;
+    bool ok = true;
+    char line[256];
+    while (ok && fgets(line, sizeof(line), f)) {
+        number++;
+        char* save;
+        char* frame = strtok_r(line, " \t\r\n", &save);
+        if (!frame || frame[0] == '#') continue;
+        char* buttons = strtok_r(NULL, " \t\r\n", &save);
+
+        char* end;
+        unsigned long value = strtoul(frame, &end, 10);
+        uint32_t last = count ? (*events)[count - 1].frame : 0;
+        const char* bad = NULL;
+        int held = buttons ? parse_buttons(buttons, &bad) : 0;
+        ok = false;
+        if (*end != '\0' || frame[0] == '-' || value > UINT32_MAX) {
+            snprintf(error, error_size, "input line %d: bad frame number '%s'", number, frame);
+        } else if (value < last) {
+            snprintf(error, error_size, "input line %d: frame %lu comes after frame %" PRIu32, number, value, last);
+        } else if (held < 0) {
+            snprintf(error, error_size, "input line %d: unknown button '%s'", number, bad);
+        } else if (count == cap && grow_events(events, &cap) != 0) {
+            snprintf(error, error_size, "out of memory reading input script");
+        } else {
+            (*events)[count].frame = value;
+            (*events)[count].buttons = held;
+            count++;
+            ok = true;
+        }
+    }
+    fclose(f);
+    if (ok) return count;
+    free(*events);
+    *events = NULL;
+    return -1;
+}
+
+static void run_task(void* ctx, size_t index, int worker)
+{
+    (void)worker;
+    Batch* batch = ctx;
+    BatchTask* task = &batch->tasks[index];
+
+    InputEvent* events = NULL;
+    int event_count = 0;
+    if (task->inputs) {
+        event_count = load_inputs(task->inputs, &events, task->input_error, sizeof(task->input_error));
+        if (event_count < 0) {
+            task->bad_inputs = true;
+            return;
+        }
+    }
+
+    GameBoy* gb = gb_create(task->rom, &task->error);
+    if (!gb) {
+        free(events);
+        return;
+    }
+
+    gb->ppu->render_mode = batch->render_mode;
+    gb_set_idle(gb, batch->idle_mode);
+    if (batch->idle_overrides) gb_idle_overrides(gb, batch->idle_overrides);
+    if (cpu_set_mode(gb->cpu, batch->cpu_mode) != 0) {
+        task->error = GB_ERR_NOMEM;
+        gb_destroy(gb);
+        free(events);
+        return;
+    }
+
+    int next = 0;
+    while (gb->frame_count < batch->max_frames && gb_cycles(gb) < batch->max_cycles) {
+        while (next < event_count && events[next].frame <= gb->frame_count) {
+            gb_set_buttons(gb, events[next++].buttons);
+        }
+
+        uint64_t frame_end = (uint64_t)(gb->frame_count + 1) * GB_CYCLES_PER_FRAME;
+        if (frame_end > batch->max_cycles) {
+            gb_run_cycles(gb, batch->max_cycles - gb_cycles(gb));
+            break;
+        }
+        gb_run_frame(gb);
+    }
+
+    CPU* cpu = gb->cpu;
+    task->frames = gb->frame_count;
+    task->cycles = gb_cycles(gb);
+    task->af = (cpu->a << 8) | cpu_get_f(cpu);
+    task->bc = cpu_get_bc(cpu);
+    task->de = cpu_get_de(cpu);
+    task->hl = cpu_get_hl(cpu);
+    task->sp = cpu->sp;
+    task->pc = cpu->pc;
+    task->ime = cpu->ime;
+    task->halted = cpu->halted;
+    task->fb_hash = hash64(gb_framebuffer(gb), PPU_WIDTH * PPU_HEIGHT * sizeof(uint32_t), 0);
+
+    // Keep the serial output; the instance goes away
+    Serial* serial = gb->serial;
+    task->serial = serial->out;
+    task->serial_len = serial->out_len;
+    serial->out = NULL;
+
+    gb_destroy(gb);
+    free(events);
+}
+
+static void write_json_string(FILE* out, const uint8_t* s, size_t len)
+{
+    fputc('"', out);
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = s[i];
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c == '\n') fputs("\\n", out);
+        else if (c < 0x20 || c >= 0x7F) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void write_summary(FILE* out, Batch* batch)
+{
+    for (size_t i = 0; i < batch->count; i++) {
+        BatchTask* task = &batch->tasks[i];
+
+        fputs("{\"rom\":", out);
+        write_json_string(out, (const uint8_t*)task->rom, strlen(task->rom));
+        if (task->inputs) {
+            fputs(",\"inputs\":", out);
+            write_json_string(out, (const uint8_t*)task->inputs, strlen(task->inputs));
+        }
+        if (task->bad_inputs) {
+            fputs(",\"status\":\"error\",\"error\":", out);
+            write_json_string(out, (const uint8_t*)task->input_error, strlen(task->input_error));
+            fputs("}\n", out);
+            continue;
+        }
+        if (task->error != GB_OK) {
+            fprintf(out, ",\"status\":\"error\",\"error\":\"%s\"}\n", gb_error_string(task->error));
+            continue;
+        }
+        fprintf(out, ",\"status\":\"ok\",\"frames\":%" PRIu32 ",\"cycles\":%" PRIu64, task->frames, task->cycles);
+        fprintf(out, ",\"af\":\"%04X\",\"bc\":\"%04X\",\"de\":\"%04X\",\"hl\":\"%04X\",\"sp\":\"%04X\",\"pc\":\"%04X\"",
+                task->af, task->bc, task->de, task->hl, task->sp, task->pc);
+        fprintf(out, ",\"ime\":%d,\"halted\":%d", task->ime, task->halted);
+        fprintf(out, ",\"fb_hash\":\"%016" PRIx64 "\"", task->fb_hash);
+        fputs(",\"serial\":", out);
+        write_json_string(out, task->serial, task->serial_len);
+        fputs("}\n", out);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Batch batch = { .max_frames = 600, .max_cycles = UINT64_MAX, .idle_mode = CPU_IDLE_FULL };
+    const char* manifest = NULL;
+    const char* rom = NULL;
+    const char* output = NULL;
+    int threads = 0;
+    int first_input = 0, input_count = 0;
+    bool frames_set = false, cycles_set = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            batch.max_frames = strtoul(argv[++i], NULL, 10);
+            frames_set = true;
+        } else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            batch.max_cycles = strtoull(argv[++i], NULL, 10);
+            cycles_set = true;
+        } else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "cached") == 0) batch.cpu_mode = CPU_MODE_CACHED;
+            else if (strcmp(argv[i], "interp") == 0) batch.cpu_mode = CPU_MODE_INTERPRETER;
+            else {
+                usage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--ppu") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "fifo") == 0) batch.render_mode = PPU_RENDER_FIFO;
+            else if (strcmp(argv[i], "scanline") == 0) batch.render_mode = PPU_RENDER_SCANLINE;
+            else {
+                usage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--idle") == 0 && i + 1 < argc) {
+            int idle = idle_mode_parse(argv[++i]);
+            if (idle < 0) {
+                usage();
+                return 1;
+            }
+            batch.idle_mode = idle;
+        } else if (strcmp(argv[i], "--idle-overrides") == 0 && i + 1 < argc) {
+            batch.idle_overrides = argv[++i];
+            FILE* f = fopen(batch.idle_overrides, "r");
+            if (!f) {
+                printf("%s: could not read overrides\n", batch.idle_overrides);
+                return 1;
+            }
+            fclose(f);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--manifest") == 0 && i + 1 < argc) {
+            manifest = argv[++i];
+        } else if (strcmp(argv[i], "--rom") == 0 && i + 1 < argc) {
+            rom = argv[++i];
+        } else if (strcmp(argv[i], "--inputs") == 0) {
+            // Every following non-option argument is an input script
+            first_input = i + 1;
+            while (i + 1 < argc && argv[i + 1][0] != '-') {
+                i++;
+                input_count++;
+            }
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    // The default frame limit only applies without a cycle limit; given
+    // both, a run stops at whichever comes first
+    if (cycles_set && !frames_set) batch.max_frames = UINT32_MAX;
+
+    if (manifest) {
+        if (load_manifest(&batch, manifest) != 0) {
+            printf("%s: could not read manifest\n", manifest);
+            return 1;
+        }
+    } else if (rom) {
+        // One ROM x N input scripts (or a single plain run)
+        if (input_count == 0) batch_add(&batch, rom, NULL);
+        for (int i = 0; i < input_count; i++) {
+            batch_add(&batch, rom, argv[first_input + i]);
+        }
+    } else {
+        usage();
+        return 1;
+    }
+
+    FILE* out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        printf("%s: could not open summary file\n", output);
+        return 1;
+    }
+
+    if (workpool_run(batch.count, threads, run_task, &batch) != 0) {
+        printf("could not start worker pool\n");
+        return 1;
+    }
+    write_summary(out, &batch);
+    if (out != stdout) fclose(out);
+
+    for (size_t i = 0; i < batch.count; i++) {
+        free(batch.tasks[i].rom);
+        free(batch.tasks[i].inputs);
+        free(batch.tasks[i].serial);
+    }
+    free(batch.tasks);
+    return 0;
+}
@@ -0,0 +1,321 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "rom_index.h"
+#include "workpool.h"
+
+// Walks directory trees for ROMs and writes a RomIndex. Files are stat'ed,
+// mapped, checksummed and hashed on a worker pool; a ROM whose size and
+// modification time match the previous index is taken from it unread.
+
+#define INDEX_DEFAULT       "roms.gbi"
+#define THREADS_PER_CPU     4       // Mostly waiting on the file system
+
+typedef enum {
+    SCAN_NEW,           // Read and hashed
+    SCAN_REUSED,        // Unchanged since the previous index
+    SCAN_SKIPPED,       // Too small for a header
+    SCAN_ERROR,         // Could not be read
+} ScanStatus;
+
+typedef struct {
+    char* path;
+    RomIndexEntry entry;
+    ScanStatus status;
+} ScanTask;
+
+typedef struct {
+    ScanTask* tasks;
+    size_t count;
+    size_t cap;
+    const RomIndex* old;    // Previous index, may be NULL
+} Scan;
+
+static void usage(void)
+{
+    printf("Usage: gameboy-index [options] <dir|rom>...\n"
+           "  -o <file>          index file (default: " INDEX_DEFAULT ")\n"
+           "  -j <n>             worker threads (default: %d per CPU)\n"
+           "  --full             rehash every ROM, even if unchanged\n"
+           "       gameboy-index --list [index]\n"
+           "ROMs are files ending in .gb, .gbc or .sgb\n", THREADS_PER_CPU);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool is_rom(const char* name)
+{
+    const char* dot = strrchr(name, '.');
+    return dot && (strcasecmp(dot, ".gb") == 0 || strcasecmp(dot, ".gbc") == 0 ||
+                   strcasecmp(dot, ".sgb") == 0);
+}
+
+static int scan_add(Scan* scan, const char* path)
+{
+    if (scan->count == scan->cap) {
+        size_t cap = scan->cap ? scan->cap * 2 : 256;
+        ScanTask* tasks = realloc(scan->tasks, cap * sizeof(ScanTask));
+        if (!tasks) return -1;
+        scan->tasks = tasks;
+        scan->cap = cap;
+    }
+    ScanTask* task = &scan->tasks[scan->count];
+    memset(task, 0, sizeof(ScanTask));
+    task->path = strdup(path);
+    if (!task->path) return -1;
+    scan->count++;
+    return 0;
+}
+
+// Directory entries only; files are stat'ed later on the pool
+static int walk(Scan* scan, const char* dir)
+{
+    DIR* d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "%s: could not open directory\n", dir);
+        return 0;
+    }
+
+    int result = 0;
+    struct dirent* ent;
+    while (result == 0 && (ent = readdir(d))) {
+        if (ent->d_name[0] == '.') continue;    // ., .. and hidden files
+
+        size_t length = strlen(dir) + strlen(ent->d_name) + 2;
+        char* path = malloc(length);
+        if (!path) {
+            result = -1;
+            break;
+        }
+        snprintf(path, length, "%s/%s", dir, ent->d_name);
+
+        unsigned char type = ent->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            type = lstat(path, &st) != 0 ? DT_UNKNOWN :
+                   S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        if (type == DT_DIR) result = walk(scan, path);
+        else if (type == DT_REG && is_rom(ent->d_name)) result = scan_add(scan, path);
+        free(path);
+    }
+    closedir(d);
+    return result;
+}
+
+static int compare_tasks(const void* a, const void* b)
+{
+    return strcmp(((const ScanTask*)a)->path, ((const ScanTask*)b)->path);
+}
+
+static void scan_task(void* ctx, size_t index, int worker)
+{
+    (void)worker;
+    Scan* scan = ctx;
+    ScanTask* task = &scan->tasks[index];
+
+    struct stat st;
+    int fd = open(task->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        task->status = SCAN_ERROR;
+        return;
+    }
+    int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
+    const RomIndexEntry* old = scan->old ? rom_index_find(scan->old, task->path) : NULL;
+    if (old && old->size == (uint64_t)st.st_size && old->mtime == mtime) {
+        close(fd);
+        task->entry = *old;
+        task->status = SCAN_REUSED;
+        return;
+    }
+    if (st.st_size < 0x150) {
+        close(fd);
+        task->status = SCAN_SKIPPED;
+        return;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        task->status = SCAN_ERROR;
+        return;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    rom_index_fill(&task->entry, data, st.st_size);
+    munmap(data, st.st_size);
+    task->entry.mtime = mtime;
+    task->status = SCAN_NEW;
+}
+
+// Entries and the path table, in path order
+static int write_index(const char* path, Scan* scan, uint32_t* written)
+{
+    size_t paths_size = 0;
+    for (size_t i = 0; i < scan->count; i++) {
+        ScanTask* task = &scan->tasks[i];
+        if (task->status == SCAN_NEW || task->status == SCAN_REUSED) paths_size += strlen(task->path) + 1;
+    }
+
+    RomIndexEntry* entries = malloc((scan->count ? scan->count : 1) * sizeof(RomIndexEntry));
+    char* paths = malloc(paths_size ? paths_size : 1);
+    if (!entries || !paths) {
+        free(entries);
+        free(paths);
+        return -1;
+    }
+
+    uint32_t count = 0;
+    size_t offset = 0;
+    for (size_t i = 0; i < scan->count; i++) {
+        ScanTask* task = &scan->tasks[i];
+        if (task->status != SCAN_NEW && task->status != SCAN_REUSED) continue;
+        size_t length = strlen(task->path) + 1;
+        entries[count] = task->entry;
+        entries[count].path = (uint32_t)offset;
+        memcpy(paths + offset, task->path, length);
+        offset += length;
+        count++;
+    }
+
+    int result = rom_index_write(path, entries, count, paths, paths_size);
+    free(entries);
+    free(paths);
+    *written = count;
+    return result;
+}
+
+static int list_index(const char* path)
+{
+    RomIndex* index = rom_index_open(path);
+    if (!index) {
+        printf("%s: could not read index\n", path);
+        return 1;
+    }
+    printf("%-16s type   size logo header global hash             path\n", "title");
+    for (uint32_t i = 0; i < index->count; i++) {
+        const RomIndexEntry* e = &index->entries[i];
+        char title[17];
+        rom_index_title(e, title);
+        printf("%-16s  $%02X %5" PRIu64 "K %-4s %-6s %-6s %016" PRIx64 " %s\n",
+               title, e->cartridge_type, e->size / 1024,
+               e->flags & ROM_INDEX_LOGO_OK ? "ok" : "bad",
+               e->flags & ROM_INDEX_HEADER_OK ? "ok" : "bad",
+               e->flags & ROM_INDEX_GLOBAL_OK ? "ok" : "bad",
+               e->hash, rom_index_path(index, e));
+    }
+    printf("%" PRIu32 " ROMs\n", index->count);
+    rom_index_close(index);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    const char* output = INDEX_DEFAULT;
+    int threads = workpool_cpu_count() * THREADS_PER_CPU;
+    bool full = false;
+    Scan scan = { 0 };
+    int roots = 0;
+
+    if (argc >= 2 && strcmp(argv[1], "--list") == 0) {
+        if (argc > 3) {
+            usage();
+            return 1;
+        }
+        return list_index(argc == 3 ? argv[2] : INDEX_DEFAULT);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--full") == 0) {
+            full = true;
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        } else {
+            roots++;
+        }
+    }
+    if (roots == 0) {
+        usage();
+        return 1;
+    }
+
+    double start = now();
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "-j") == 0) {
+            i++;
+            continue;
+        }
+        if (argv[i][0] == '-') continue;
+
+        struct stat st;
+        int result = 0;
+        if (stat(argv[i], &st) != 0) fprintf(stderr, "%s: not found\n", argv[i]);
+        else if (S_ISDIR(st.st_mode)) result = walk(&scan, argv[i]);
+        else result = scan_add(&scan, argv[i]);
+        if (result != 0) {
+            printf("out of memory\n");
+            return 1;
+        }
+    }
+
+    // Sorted for the index; a file named twice is scanned once
+    qsort(scan.tasks, scan.count, sizeof(ScanTask), compare_tasks);
+    size_t unique = 0;
+    for (size_t i = 0; i < scan.count; i++) {
+        if (unique && strcmp(scan.tasks[unique - 1].path, scan.tasks[i].path) == 0) {
+            free(scan.tasks[i].path);
+            continue;
+        }
+        scan.tasks[unique++] = scan.tasks[i];
+    }
+    scan.count = unique;
+
+    RomIndex* old = full ? NULL : rom_index_open(output);
+    scan.old = old;
+    if (workpool_run(scan.count, threads, scan_task, &scan) != 0) {
+        printf("could not start worker pool\n");
+        return 1;
+    }
+
+    size_t counts[4] = { 0 };
+    for (size_t i = 0; i < scan.count; i++) {
+        ScanTask* task = &scan.tasks[i];
+        counts[task->status]++;
+        if (task->status == SCAN_ERROR) fprintf(stderr, "%s: could not read\n", task->path);
+        if (task->status == SCAN_SKIPPED) fprintf(stderr, "%s: no cartridge header\n", task->path);
+    }
+
+    uint32_t written = 0;
+    int result = write_index(output, &scan, &written);
+    rom_index_close(old);
+    if (result != 0) {
+        printf("%s: could not write index\n", output);
+    } else {
+        printf("%s: %" PRIu32 " ROMs (%zu hashed, %zu unchanged, %zu skipped) in %.2f s\n",
+               output, written, counts[SCAN_NEW], counts[SCAN_REUSED],
+               counts[SCAN_SKIPPED] + counts[SCAN_ERROR], now() - start);
+    }
+
+    for (size_t i = 0; i < scan.count; i++) free(scan.tasks[i].path);
+    free(scan.tasks);
+    return result == 0 ? 0 : 1;
+}
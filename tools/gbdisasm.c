@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cartridge.h"
+#include "disassemble.h"
+
+// Whole-ROM disassembler: discovers code by recursive descent and writes a
+// symbol-annotated listing of every bank.
+
+static void usage(void)
+{
+    printf("Usage: gbdisasm <rom> [-o <file>] [--stats]\n"
+           "  -o <file>   listing file (default: stdout)\n"
+           "  --stats     print discovery statistics only\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char* rom = NULL;
+    const char* output = NULL;
+    bool stats = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = true;
+        } else if (argv[i][0] != '-' && !rom) {
+            rom = argv[i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (!rom) {
+        usage();
+        return 1;
+    }
+
+    Cartridge* cart;
+    if (load_rom(rom, &cart) != CART_OK) {
+        printf("%s: could not load ROM\n", rom);
+        return 1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    DAsmRom* dasm = d_asm_rom_create(cart->data, cart->size);
+    if (!dasm || d_asm_rom_analyze(dasm) != 0) {
+        printf("out of memory\n");
+        d_asm_rom_free(dasm);
+        cartridge_free(cart);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (stats) {
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("%s: %u banks, %zu instructions, %zu code bytes (%.1f%%)\n", rom, dasm->banks,
+               dasm->instructions, dasm->code_bytes, 100.0 * dasm->code_bytes / dasm->size);
+        printf("  %zu labels, %zu jump tables, %zu unresolved bank targets, %.3fs\n",
+               dasm->labels, dasm->tables, dasm->unresolved, seconds);
+    } else {
+        FILE* out = output ? fopen(output, "w") : stdout;
+        if (!out) {
+            printf("%s: could not open listing file\n", output);
+        } else {
+            static char buffer[1 << 16];
+            setvbuf(out, buffer, _IOFBF, sizeof(buffer));
+            d_asm_rom_list(dasm, out);
+            if (out != stdout) fclose(out);
+        }
+    }
+
+    d_asm_rom_free(dasm);
+    cartridge_free(cart);
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "gameboy.h"
+#include "hash.h"
+#include "idle.h"
+
+// Runs two ROMs headless with a link cable between them, each on its own
+// thread, and prints what each side shifted out and its state hash. Linked
+// runs are deterministic, so the hashes are the same on every run.
+
+#define SHOWN_BYTES 32      // Serial output printed per side
+
+typedef struct {
+    GameBoy* gb;
+    long frames;
+} Side;
+
+static void usage(void)
+{
+    printf("Usage: gblink [options] <rom> <rom>\n"
+           "  --frames <n>       frames to run each side (default 600)\n"
+           "  --cpu <mode>       interp (default) or cached\n"
+           "  --idle <mode>      off, halt or full (default)\n");
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void* run_side(void* arg)
+{
+    Side* side = arg;
+    for (long i = 0; i < side->frames; i++) gb_run_frame(side->gb);
+    // Unplugged as soon as it is done, so the other side doesn't wait on it
+    link_unplug(side->gb->link);
+    return NULL;
+}
+
+static void report(const char* rom, GameBoy* gb)
+{
+    Serial* serial = gb->serial;
+    printf("%s: %" PRIu64 " cycles, hash %016" PRIx64 ", %zu bytes out",
+           rom, gb_cycles(gb), gb_state_hash(gb), serial->out_len);
+    for (size_t i = 0; i < serial->out_len && i < SHOWN_BYTES; i++) {
+        printf("%s%02X", i ? " " : ": ", serial->out[i]);
+    }
+    printf("%s\n", serial->out_len > SHOWN_BYTES ? " ..." : "");
+}
+
+int main(int argc, char** argv)
+{
+    long frames = 600;
+    CPU_Mode cpu_mode = CPU_MODE_INTERPRETER;
+    int idle = CPU_IDLE_FULL;
+    const char* roms[2];
+    int count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "cached") == 0) cpu_mode = CPU_MODE_CACHED;
+            else if (strcmp(mode, "interp") != 0) {
+                usage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--idle") == 0 && i + 1 < argc) {
+            idle = idle_mode_parse(argv[++i]);
+            if (idle < 0) {
+                usage();
+                return 1;
+            }
+        } else if (argv[i][0] != '-' && count < 2) {
+            roms[count++] = argv[i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (count != 2) {
+        usage();
+        return 1;
+    }
+
+    // A name of our own, so several runs can't share a link
+    char name[32];
+    snprintf(name, sizeof(name), "gblink-%d", (int)getpid());
+
+    Side sides[2] = { 0 };
+    int result = 0;
+    for (int i = 0; i < 2 && result == 0; i++) {
+        int error;
+        GameBoy* gb = gb_create(roms[i], &error);
+        if (!gb) {
+            printf("%s: %s\n", roms[i], gb_error_string(error));
+            result = 1;
+            break;
+        }
+        sides[i] = (Side){ gb, frames };
+        gb_set_idle(gb, idle);
+        if (cpu_set_mode(gb->cpu, cpu_mode) != 0 || gb_link_open(gb, name) != 0) {
+            printf("%s: could not set up\n", roms[i]);
+            result = 1;
+        }
+    }
+
+    if (result == 0) {
+        double start = now();
+        pthread_t threads[2];
+        int started = 0;
+        for (; started < 2; started++) {
+            if (pthread_create(&threads[started], NULL, run_side, &sides[started]) != 0) break;
+        }
+        if (started < 2) {
+            printf("could not start threads\n");
+            for (int i = 0; i < 2; i++) link_unplug(sides[i].gb->link);
+            result = 1;
+        }
+        for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+        double seconds = now() - start;
+
+        if (result == 0) {
+            for (int i = 0; i < 2; i++) report(roms[i], sides[i].gb);
+            printf("%ld frames in %.3f s, %.1fx real-time\n", frames, seconds,
+                   frames * (double)GB_CYCLES_PER_FRAME / GB_CLOCK_HZ / seconds);
+        }
+    }
+
+    for (int i = 0; i < 2; i++) gb_destroy(sides[i].gb);
+    return result;
+}
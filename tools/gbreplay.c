@@ -0,0 +1,161 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gameboy.h"
+#include "idle.h"
+#include "movie.h"
+
+// Replays an input movie headless at full speed and writes one state hash
+// per frame; compares two such hash logs to find the first frame where
+// they diverge.
+
+static void usage(void)
+{
+    printf("Usage: gbreplay [options] <rom> <movie>\n"
+           "  --cpu <mode>       interp (default) or cached\n"
+           "  --ppu <mode>       scanline (default) or fifo\n"
+           "  --idle <mode>      off, halt or full (default)\n"
+           "  -o <file>          hash log (default: stdout)\n"
+           "       gbreplay --diff <log-a> <log-b>\n"
+           "Hash log lines:      <frame> <hash>, the state after that frame\n");
+}
+
+static int replay(const char* rom, const char* path, CPU_Mode cpu_mode, PPU_RenderMode render_mode,
+                  CPU_IdleMode idle_mode, FILE* out)
+{
+    Movie* movie;
+    int result = movie_read(path, &movie);
+    if (result != MOVIE_OK) {
+        printf("%s: %s\n", path, movie_error_string(result));
+        return 1;
+    }
+
+    int error;
+    GameBoy* gb = gb_create(rom, &error);
+    if (!gb) {
+        printf("%s: %s\n", rom, gb_error_string(error));
+        movie_free(movie);
+        return 1;
+    }
+    result = movie_start(movie, gb);
+    if (result != MOVIE_OK) {
+        printf("%s: %s\n", path, movie_error_string(result));
+        gb_destroy(gb);
+        movie_free(movie);
+        return 1;
+    }
+
+    gb->ppu->render_mode = render_mode;
+    gb_set_idle(gb, idle_mode);
+    if (cpu_set_mode(gb->cpu, cpu_mode) != 0) printf("cached mode unavailable, interpreting\n");
+
+    for (uint32_t frame = 0; frame < movie->frames; frame++) {
+        gb_set_buttons(gb, movie->buttons[frame]);
+        gb_run_frame(gb);
+        fprintf(out, "%u %016" PRIx64 "\n", frame, gb_state_hash(gb));
+    }
+
+    gb_destroy(gb);
+    movie_free(movie);
+    return 0;
+}
+
+static int diff(const char* path_a, const char* path_b)
+{
+    FILE* a = fopen(path_a, "r");
+    FILE* b = fopen(path_b, "r");
+    if (!a || !b) {
+        printf("%s: could not open\n", a ? path_b : path_a);
+        if (a) fclose(a);
+        if (b) fclose(b);
+        return 2;
+    }
+
+    int result = 0;
+    uint32_t frames = 0;
+    for (;;) {
+        unsigned frame_a, frame_b;
+        uint64_t hash_a, hash_b;
+        int got_a = fscanf(a, "%u %" SCNx64, &frame_a, &hash_a);
+        int got_b = fscanf(b, "%u %" SCNx64, &frame_b, &hash_b);
+        if (got_a != 2 || got_b != 2) {
+            if (got_a == 2 || got_b == 2) {
+                printf("%s ends at frame %u\n", got_a == 2 ? path_b : path_a, frames);
+                result = 1;
+            }
+            break;
+        }
+        if (frame_a != frame_b || hash_a != hash_b) {
+            printf("first difference at frame %u: %016" PRIx64 " vs %016" PRIx64 "\n",
+                   frame_a, hash_a, hash_b);
+            result = 1;
+            break;
+        }
+        frames++;
+    }
+    if (result == 0) printf("identical, %u frames\n", frames);
+
+    fclose(a);
+    fclose(b);
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    CPU_Mode cpu_mode = CPU_MODE_INTERPRETER;
+    PPU_RenderMode render_mode = PPU_RENDER_SCANLINE;
+    CPU_IdleMode idle_mode = CPU_IDLE_FULL;
+    const char* output = NULL;
+    const char* files[2];
+    int file_count = 0;
+
+    if (argc == 4 && strcmp(argv[1], "--diff") == 0) return diff(argv[2], argv[3]);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "cached") == 0) cpu_mode = CPU_MODE_CACHED;
+            else if (strcmp(argv[i], "interp") == 0) cpu_mode = CPU_MODE_INTERPRETER;
+            else {
+                usage();
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--ppu") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "fifo") == 0) render_mode = PPU_RENDER_FIFO;
+            else if (strcmp(argv[i], "scanline") == 0) render_mode = PPU_RENDER_SCANLINE;
+            else {
+                usage();
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--idle") == 0 && i + 1 < argc) {
+            int idle = idle_mode_parse(argv[++i]);
+            if (idle < 0) {
+                usage();
+                return 2;
+            }
+            idle_mode = idle;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (argv[i][0] != '-' && file_count < 2) {
+            files[file_count++] = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (file_count != 2) {
+        usage();
+        return 2;
+    }
+
+    FILE* out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        printf("%s: could not open\n", output);
+        return 1;
+    }
+    int result = replay(files[0], files[1], cpu_mode, render_mode, idle_mode, out);
+    if (output) fclose(out);
+    return result;
+}
@@ -0,0 +1,157 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "disassemble.h"
+#include "trace.h"
+
+// Decodes binary traces written by gb_trace_start, and finds the first
+// point where two traces diverge.
+
+#define CONTEXT 8   // Records shown before a divergence
+
+static void usage(void)
+{
+    printf("Usage: gbtrace <trace> [--from <cycle>] [--pc <hex>] [-n <count>]\n"
+           "       gbtrace --diff <trace-a> <trace-b>\n");
+}
+
+static FILE* open_trace(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        printf("%s: could not open\n", path);
+        return NULL;
+    }
+
+    TraceHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.record_size != sizeof(TraceRecord)) {
+        printf("%s: not a trace file\n", path);
+        fclose(f);
+        return NULL;
+    }
+    return f;
+}
+
+static void print_record(const TraceRecord* r)
+{
+    char text[D_ASM_TEXT_SIZE];
+    if (r->flags & TRACE_INTERRUPT) {
+        // Dispatch: pc is the address pushed, operand the vector
+        printf("%12" PRIu64 "  $%04X  --      ", r->cycles, r->pc);
+        snprintf(text, sizeof(text), "INT $%04X", r->operand);
+    } else {
+        printf("%12" PRIu64 "  $%04X  %02X", r->cycles, r->pc, r->opcode);
+        if (r->length == 2) printf(" %02X   ", r->operand & 0xFF);
+        else if (r->length == 3) printf(" %02X %02X", r->operand & 0xFF, r->operand >> 8);
+        else printf("      ");
+
+        uint8_t code[3] = { r->opcode, r->operand & 0xFF, r->operand >> 8 };
+        d_asm_format(code, r->length, r->pc, text, sizeof(text), NULL, NULL);
+    }
+
+    printf("  AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X %s%s  %s\n",
+           r->af, r->bc, r->de, r->hl, r->sp,
+           (r->flags & TRACE_IME) ? "I" : "-",
+           (r->flags & TRACE_HALT_BUG) ? "H" : "-", text);
+}
+
+static int dump(const char* path, uint64_t from, long pc, uint64_t count)
+{
+    FILE* f = open_trace(path);
+    if (!f) return 1;
+
+    TraceRecord records[4096];
+    size_t n;
+    uint64_t shown = 0;
+    while (shown < count && (n = fread(records, sizeof(TraceRecord), 4096, f)) > 0) {
+        for (size_t i = 0; i < n && shown < count; i++) {
+            if (records[i].cycles < from) continue;
+            if (pc >= 0 && records[i].pc != pc) continue;
+            print_record(&records[i]);
+            shown++;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static int diff(const char* path_a, const char* path_b)
+{
+    FILE* a = open_trace(path_a);
+    FILE* b = open_trace(path_b);
+    if (!a || !b) {
+        if (a) fclose(a);
+        if (b) fclose(b);
+        return 2;
+    }
+
+    TraceRecord history[CONTEXT];
+    TraceRecord ra, rb;
+    uint64_t index = 0;
+    int result = 0;
+
+    for (;;) {
+        size_t got_a = fread(&ra, sizeof(ra), 1, a);
+        size_t got_b = fread(&rb, sizeof(rb), 1, b);
+        if (!got_a && !got_b) {
+            printf("traces match: %" PRIu64 " records\n", index);
+            break;
+        }
+        if (!got_a || !got_b) {
+            printf("%s ends first after %" PRIu64 " records\n", got_a ? path_b : path_a, index);
+            result = 1;
+            break;
+        }
+        if (memcmp(&ra, &rb, sizeof(ra)) != 0) {
+            printf("diverged at record %" PRIu64 ":\n", index);
+            uint64_t first = index > CONTEXT ? index - CONTEXT : 0;
+            for (uint64_t i = first; i < index; i++) {
+                printf("   ");
+                print_record(&history[i % CONTEXT]);
+            }
+            printf("a: ");
+            print_record(&ra);
+            printf("b: ");
+            print_record(&rb);
+            result = 1;
+            break;
+        }
+        history[index % CONTEXT] = ra;
+        index++;
+    }
+
+    fclose(a);
+    fclose(b);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 4 && strcmp(argv[1], "--diff") == 0) {
+        return diff(argv[2], argv[3]);
+    }
+    if (argc < 2 || argv[1][0] == '-') {
+        usage();
+        return 1;
+    }
+
+    uint64_t from = 0;
+    uint64_t count = UINT64_MAX;
+    long pc = -1;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            from = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--pc") == 0 && i + 1 < argc) {
+            pc = strtol(argv[++i], NULL, 16);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = strtoull(argv[++i], NULL, 10);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    return dump(argv[1], from, pc, count);
+}